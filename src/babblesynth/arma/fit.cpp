@@ -33,23 +33,6 @@ inline std::vector<double> map(const VectorXd& vec) {
     return std::vector<double>(vec.begin(), vec.end());
 }
 
-inline VectorXd sumBetaArg(const VectorXd& beta, const MatrixXd& arg) {
-    // arg -> (N, terms)
-    // beta -> (terms, 1)
-
-    // std::cout << "arg = " << arg.rows() << "x" << arg.cols() << std::endl;
-    // std::cout << "beta = " << beta.rows() << "x" << beta.cols() << std::endl;
-
-    // beta.T -> (1, terms)
-
-    // (N, terms)
-
-    return (arg.array().rowwise() * beta.transpose().array())
-        .rowwise()
-        .sum()
-        .matrix();
-}
-
 arma::model arma::fit(const std::vector<double>& vx, const int arTerms,
                       const int maTerms, const double epsLimit,
                       const int maxSteps) {
@@ -66,24 +49,19 @@ arma::model arma::fit(const std::vector<double>& vx, const int arTerms,
         auto x = map(vx);
         const int N = x.size();
 
-        MatrixXd arg, arg2;
-        MatrixXd argAll(N, arTerms + maTerms);
-        VectorXd initialBeta;
         VectorXd beta;
-        VectorXd eps;
+        VectorXd eps(N);
+        VectorXd nextEps(N);
         double q0, q1;
 
-        arg = shiftAndStack(x, arTerms);
-        initialBeta = ols(arg, x);
-        eps = x - sumBetaArg(initialBeta, arg);
+        beta = laggedOls(x, arTerms, x, 0, x);
+        laggedResidual(x, arTerms, x, 0, beta, x, eps);
         q0 = msqe(eps);
 
         for (int i = 0; i < maxSteps; ++i) {
-            arg = shiftAndStack(x, arTerms);
-            arg2 = shiftAndStack(eps, maTerms);
-            argAll << arg, arg2;
-            beta = ols(argAll, x);
-            eps = x - sumBetaArg(beta, argAll);
+            beta = laggedOls(x, arTerms, eps, maTerms, x);
+            laggedResidual(x, arTerms, eps, maTerms, beta, x, nextEps);
+            eps.swap(nextEps);
             q1 = msqe(eps);
             if (epsLimit > std::abs(q1 - q0)) {
                 break;
@@ -114,19 +92,19 @@ std::vector<double> arma::fitMaOnly(const std::vector<double>& vx,
                                     const int maTerms, const double epsLimit,
                                     const int maxSteps) {
     auto x = map(vx);
+    const int N = x.size();
 
-    MatrixXd arg;
     VectorXd beta;
-    VectorXd eps;
+    VectorXd eps = x;
+    VectorXd nextEps(N);
     double q0, q1;
 
-    eps = x;
     q0 = msqe(eps);
 
     for (int i = 0; i < maxSteps; ++i) {
-        arg = shiftAndStack(eps, maTerms);
-        beta = ols(arg, x);
-        eps = x - sumBetaArg(beta, arg);
+        beta = laggedOls(eps, maTerms, eps, 0, x);
+        laggedResidual(eps, maTerms, eps, 0, beta, x, nextEps);
+        eps.swap(nextEps);
         q1 = msqe(eps);
         if (epsLimit > std::abs(q1 - q0)) {
             break;
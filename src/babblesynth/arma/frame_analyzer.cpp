@@ -0,0 +1,254 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "frame_analyzer.h"
+
+#include <arima/Fitting/BurgYule.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+
+#include "fit.h"
+
+using namespace babblesynth::arma;
+
+static std::vector<double> blackmanNuttall(const int N) {
+    constexpr double a0 = 0.3635819;
+    constexpr double a1 = 0.4891775;
+    constexpr double a2 = 0.1365995;
+    constexpr double a3 = 0.0106411;
+
+    std::vector<double> window(N);
+
+    for (int n = 0; n < N; ++n) {
+        window[n] = a0 - a1 * cos(2 * M_PI * n / (N - 1)) +
+                    a2 * cos(4 * M_PI * n / (N - 1)) -
+                    a3 * cos(6 * M_PI * n / (N - 1));
+    }
+
+    return window;
+}
+
+frame_analyzer::frame_analyzer(const double sampleRate, const int numThreads)
+    : m_sampleRate(sampleRate),
+      m_frameSamples((int)std::round(frameDuration * sampleRate)),
+      m_hopSamples((int)std::round(hopDuration * sampleRate)),
+      m_window(blackmanNuttall(m_frameSamples)),
+      m_numThreads(numThreads),
+      m_stages(preEmphasisStages),
+      m_decay(std::exp(-1 / (preEmphasisDuration * sampleRate))),
+      m_streamFrame(m_frameSamples) {
+    begin();
+}
+
+std::vector<frame_analysis> frame_analyzer::analyze(
+    std::vector<double>& audio) {
+    const int length = audio.size();
+
+    // Optimal pre-emphasis, repeated until the first order predictor is
+    // almost zero.
+    std::vector<double> alpha;
+    do {
+        alpha = fitArOnly(audio, 1);
+        if (std::abs(alpha[0]) < 0.001) break;
+        for (int i = length - 1; i > 0; --i) {
+            audio[i] += alpha[0] * audio[i - 1];
+        }
+    } while (std::abs(alpha[0]) >= 0.001);
+
+    int numFrames = 0;
+    while (numFrames * m_hopSamples + m_frameSamples < length) {
+        ++numFrames;
+    }
+
+    std::vector<frame_analysis> results(numFrames);
+
+    const int numRuns = (numFrames + framesPerRun - 1) / framesPerRun;
+
+    if (!m_pool) {
+        m_pool = std::make_unique<thread_pool>(m_numThreads);
+        m_frames.assign(m_pool->size(), std::vector<double>(m_frameSamples));
+    }
+
+    m_pool->run(numRuns, [&](const int run, const int worker) {
+        auto& frame = m_frames[worker];
+        filter::root_tracker arRoots, maRoots;
+
+        const int end = std::min(numFrames, (run + 1) * framesPerRun);
+
+        for (int index = run * framesPerRun; index < end; ++index) {
+            results[index] =
+                analyzeSamples(audio.data() + index * m_hopSamples, frame,
+                               arRoots, maRoots);
+        }
+    });
+
+    return results;
+}
+
+void frame_analyzer::begin() {
+    std::fill(m_stages.begin(), m_stages.end(), whitening_stage{0, 0, 0});
+    m_pending.clear();
+    m_pendingStart = 0;
+    m_nextFrame = 0;
+    m_arRoots.reset();
+    m_maRoots.reset();
+}
+
+void frame_analyzer::feed(const double* audio, const int count,
+                          std::vector<frame_analysis>& frames) {
+    const int offset = m_pending.size();
+    m_pending.resize(offset + count);
+
+    // Each stage removes the first order correlation left by the previous
+    // ones, like the repeated passes of analyze() do, with Burg's estimate
+    // of the predictor over the recent audio.
+    for (int i = 0; i < count; ++i) {
+        double x = audio[i];
+        for (auto& stage : m_stages) {
+            stage.cross = m_decay * stage.cross + x * stage.previous;
+            stage.energy = m_decay * stage.energy + x * x +
+                           stage.previous * stage.previous;
+
+            const double alpha =
+                stage.energy > 0 ? 2 * stage.cross / stage.energy : 0;
+
+            const double y = x - alpha * stage.previous;
+            stage.previous = x;
+            x = y;
+        }
+        m_pending[offset + i] = x;
+    }
+
+    // Same frames as analyze(), which needs one sample past the end of each.
+    const int received = m_pendingStart + m_pending.size();
+
+    while (m_nextFrame * m_hopSamples + m_frameSamples < received) {
+        if (m_nextFrame % framesPerRun == 0) {
+            m_arRoots.reset();
+            m_maRoots.reset();
+        }
+
+        const int start = m_nextFrame * m_hopSamples - m_pendingStart;
+        frames.push_back(analyzeSamples(m_pending.data() + start,
+                                        m_streamFrame, m_arRoots, m_maRoots));
+        ++m_nextFrame;
+    }
+
+    // Only keep what the next frames need.
+    const int keepFrom =
+        std::min(received, m_nextFrame * m_hopSamples) - m_pendingStart;
+    m_pending.erase(m_pending.begin(), m_pending.begin() + keepFrom);
+    m_pendingStart += keepFrom;
+}
+
+frame_analysis frame_analyzer::analyzeSamples(
+    const double* first, std::vector<double>& frame,
+    filter::root_tracker& arRoots, filter::root_tracker& maRoots) const {
+    std::copy(first, first + m_frameSamples, frame.begin());
+
+    double min = std::numeric_limits<double>::max();
+    double max = std::numeric_limits<double>::lowest();
+    double mean = 0;
+
+    for (int i = 0; i < m_frameSamples; ++i) {
+        min = std::min(min, frame[i]);
+        max = std::max(max, frame[i]);
+        mean += frame[i];
+    }
+    mean /= m_frameSamples;
+
+    for (int i = 0; i < m_frameSamples; ++i) {
+        frame[i] *= m_window[i];
+    }
+
+    frame_analysis result = analyzeFrame(frame, arRoots, maRoots);
+    result.intensity = std::max(std::abs(min - mean), std::abs(max - mean));
+    return result;
+}
+
+frame_analysis frame_analyzer::analyzeFrame(
+    const std::vector<double>& frame, filter::root_tracker& arRoots,
+    filter::root_tracker& maRoots) const {
+    const auto model = suanshu::FitBurgYule(frame, arTerms, maTerms);
+
+    std::vector<double> arPoly(arTerms + 1);
+    std::vector<double> maPoly(maTerms + 1);
+    arPoly[0] = 1;
+    maPoly[0] = 1;
+    for (int i = 0; i < arTerms; ++i) {
+        arPoly[i + 1] = model.AR(i + 1);
+    }
+    for (int i = 0; i < maTerms; ++i) {
+        maPoly[i + 1] = model.MA(i + 1);
+    }
+
+    frame_analysis result;
+    result.poles = findResonances(arRoots.solve(arPoly), maxPoles);
+    result.zeros = findResonances(maRoots.solve(maPoly), maxZeros);
+    result.intensity = 0;
+    result.rootIterations = arRoots.iterations() + maRoots.iterations();
+    return result;
+}
+
+// Keeps the stable roots in the upper half plane which aren't too close to 0
+// or to the Nyquist frequency. The roots are visited by frequency through an
+// index, so that each resonance can remember its place in the tracker order.
+std::vector<resonance> frame_analyzer::findResonances(
+    const std::vector<std::complex<double>>& roots, const int maxCount) const {
+    std::vector<int> order(roots.size());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int x, int y) {
+        return std::abs(std::arg(roots[x])) < std::abs(std::arg(roots[y]));
+    });
+
+    std::vector<resonance> resonances;
+
+    for (const int track : order) {
+        if (resonances.size() == maxCount) {
+            break;
+        }
+
+        const auto& z = roots[track];
+
+        if (z.imag() < 0) {
+            continue;
+        }
+
+        const double r = std::abs(z);
+        if (r >= 1.0) {
+            continue;
+        }
+
+        const double frequency =
+            std::abs(std::arg(z)) * m_sampleRate / (2 * M_PI);
+        if (frequency <= 50 || frequency >= m_sampleRate / 2 - 50) {
+            continue;
+        }
+
+        const double bandwidth = -std::log(r) * m_sampleRate / M_PI;
+
+        resonances.push_back({frequency, bandwidth, track});
+    }
+
+    return resonances;
+}
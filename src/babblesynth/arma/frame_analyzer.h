@@ -0,0 +1,150 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BABBLESYNTH_ARMA_FRAME_ANALYZER_H
+#define BABBLESYNTH_ARMA_FRAME_ANALYZER_H
+
+#include <memory>
+#include <vector>
+
+#include "../filter/filters.h"
+#include "../thread_pool.h"
+
+namespace babblesynth {
+namespace arma {
+
+// A resonance of the vocal tract, in Hz.
+struct resonance {
+    double frequency;
+    double bandwidth;
+
+    // Index of the root in the order of its root_tracker. Resonances with the
+    // same track in consecutive frames come from the same tracked root.
+    int track;
+};
+
+struct frame_analysis {
+    // Formants from the AR part and antiformants from the MA part, by
+    // increasing frequency. Follow the tracks to match them across frames.
+    std::vector<resonance> poles;
+    std::vector<resonance> zeros;
+
+    // Largest deviation from the mean of the frame, before windowing.
+    double intensity;
+
+    // Iterations taken to find the roots of both polynomials.
+    int rootIterations;
+};
+
+// Estimates formants and antiformants over a recording.
+//
+// The recording is pre-emphasized, then cut into overlapping windowed frames.
+// An ARMA model is fitted to every frame, and the resonances are taken from
+// the roots of its polynomials.
+//
+// Frames are analyzed in parallel on a thread pool, in runs of consecutive
+// frames. Within a run, the roots of each frame are tracked from the ones of
+// the frame before, see filter::root_tracker. Runs always have the same
+// length and start from scratch, so the results don't depend on the number
+// of threads.
+//
+// A recording can also be analyzed while it is still being made, by feeding
+// it block by block. Frames are then analyzed on the calling thread as soon
+// as their samples have arrived. The thread pool is only started by the first
+// call to analyze(), so a streaming analyzer runs no threads of its own.
+class frame_analyzer {
+   public:
+    // A thread count of 0 uses one worker per hardware thread.
+    explicit frame_analyzer(double sampleRate, int numThreads = 0);
+
+    static constexpr double frameDuration = 0.020;
+    static constexpr double hopDuration = 0.050;
+
+    static constexpr int arTerms = 10;
+    static constexpr int maTerms = 4;
+
+    static constexpr int maxPoles = 5;
+    static constexpr int maxZeros = 2;
+
+    static constexpr int framesPerRun = 16;
+
+    // The streaming pre-emphasis is a cascade of first order predictors,
+    // each one fitted over about this much of the latest audio.
+    static constexpr int preEmphasisStages = 3;
+    static constexpr double preEmphasisDuration = 0.25;
+
+    // One result per frame, in order. The audio is modified by the
+    // pre-emphasis.
+    std::vector<frame_analysis> analyze(std::vector<double>& audio);
+
+    // Streaming interface: begin() forgets the previous recording, then each
+    // call to feed() takes the next `count` samples and appends the frames
+    // they complete to `frames`. The frames are the ones analyze() finds on
+    // the whole recording, except that the pre-emphasis adapts to the audio
+    // received so far instead of being fitted to all of it.
+    void begin();
+    void feed(const double* audio, int count,
+              std::vector<frame_analysis>& frames);
+
+    // Analyzes a single frame, which is already windowed, tracking the roots
+    // from the previous frame analyzed with the same trackers.
+    frame_analysis analyzeFrame(const std::vector<double>& frame,
+                                filter::root_tracker& arRoots,
+                                filter::root_tracker& maRoots) const;
+
+   private:
+    // Windows the frame starting at `first` into `frame` and analyzes it.
+    frame_analysis analyzeSamples(const double* first,
+                                  std::vector<double>& frame,
+                                  filter::root_tracker& arRoots,
+                                  filter::root_tracker& maRoots) const;
+
+    std::vector<resonance> findResonances(
+        const std::vector<std::complex<double>>& roots, int maxCount) const;
+
+    double m_sampleRate;
+    int m_frameSamples;
+    int m_hopSamples;
+    std::vector<double> m_window;
+
+    int m_numThreads;
+    std::unique_ptr<thread_pool> m_pool;
+    std::vector<std::vector<double>> m_frames;  // one per worker
+
+    // Streaming state.
+    struct whitening_stage {
+        double previous;
+        double cross;   // decaying sum of x[n] * x[n-1]
+        double energy;  // decaying sum of x[n]^2 + x[n-1]^2
+    };
+    std::vector<whitening_stage> m_stages;
+    double m_decay;
+
+    // Pre-emphasized samples from the absolute index m_pendingStart on.
+    std::vector<double> m_pending;
+    int m_pendingStart;
+    int m_nextFrame;
+    filter::root_tracker m_arRoots;
+    filter::root_tracker m_maRoots;
+    std::vector<double> m_streamFrame;
+};
+
+}  // namespace arma
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_ARMA_FRAME_ANALYZER_H
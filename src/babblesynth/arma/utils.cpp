@@ -18,6 +18,8 @@
 
 #include "utils.h"
 
+#include <algorithm>
+
 using namespace babblesynth;
 using namespace babblesynth::arma;
 
@@ -60,6 +62,85 @@ MatrixXd arma::shiftAndStack(const Ref<const VectorXd>& x, const int numLags) {
     return result;
 }
 
+// Dot product of shift(a, lagA) and shift(b, lagB).
+static double laggedDot(const Ref<const VectorXd>& a, const int lagA,
+                        const Ref<const VectorXd>& b, const int lagB) {
+    const int start = std::max(lagA, lagB);
+    const int length = a.size() - start;
+    if (length <= 0) {
+        return 0;
+    }
+    return a.segment(start - lagA, length).dot(b.segment(start - lagB, length));
+}
+
+// G(i, j) is the dot product of shift(s, i + 1) and shift(t, j + 1). Only the
+// first row and column need a full dot product: shifting both signals by one
+// more sample only drops the last term of the sum.
+static void laggedGram(const Ref<const VectorXd>& s, const int p,
+                       const Ref<const VectorXd>& t, const int q,
+                       Ref<MatrixXd> G) {
+    const int N = s.size();
+
+    if (p == 0 || q == 0) {
+        return;
+    }
+
+    for (int j = 0; j < q; ++j) {
+        G(0, j) = laggedDot(s, 1, t, j + 1);
+    }
+    for (int i = 1; i < p; ++i) {
+        G(i, 0) = laggedDot(s, i + 1, t, 1);
+    }
+    for (int i = 1; i < p; ++i) {
+        for (int j = 1; j < q; ++j) {
+            const int a = N - 1 - i;
+            const int b = N - 1 - j;
+            G(i, j) = G(i - 1, j - 1) - (a >= 0 && b >= 0 ? s(a) * t(b) : 0);
+        }
+    }
+}
+
+VectorXd arma::laggedOls(const Ref<const VectorXd>& u, const int p,
+                         const Ref<const VectorXd>& v, const int q,
+                         const Ref<const VectorXd>& y) {
+    MatrixXd G(p + q, p + q);
+    VectorXd r(p + q);
+
+    // Only the lower triangle is read by the decomposition.
+    laggedGram(u, p, u, p, G.topLeftCorner(p, p));
+    if (q > 0) {
+        laggedGram(v, q, u, p, G.bottomLeftCorner(q, p));
+        laggedGram(v, q, v, q, G.bottomRightCorner(q, q));
+    }
+
+    for (int i = 0; i < p; ++i) {
+        r(i) = laggedDot(u, i + 1, y, 0);
+    }
+    for (int j = 0; j < q; ++j) {
+        r(p + j) = laggedDot(v, j + 1, y, 0);
+    }
+
+    return G.ldlt().solve(r);
+}
+
+void arma::laggedResidual(const Ref<const VectorXd>& u, const int p,
+                          const Ref<const VectorXd>& v, const int q,
+                          const Ref<const VectorXd>& b,
+                          const Ref<const VectorXd>& y, Ref<VectorXd> eps) {
+    const int N = y.size();
+
+    for (int n = 0; n < N; ++n) {
+        double sum = y(n);
+        for (int i = 0; i < std::min(p, n); ++i) {
+            sum -= b(i) * u(n - i - 1);
+        }
+        for (int j = 0; j < std::min(q, n); ++j) {
+            sum -= b(p + j) * v(n - j - 1);
+        }
+        eps(n) = sum;
+    }
+}
+
 VectorXd arma::autoCorr(const Ref<const VectorXd>& x, const int m) {
     const int n = x.size();
 
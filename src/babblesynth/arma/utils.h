@@ -36,6 +36,21 @@ VectorXd shift(const Ref<const VectorXd> &array, int lags, double fill = 0.0);
 
 MatrixXd shiftAndStack(const Ref<const VectorXd> &x, int numLags);
 
+// Least squares solution of [shiftAndStack(u, p), shiftAndStack(v, q)] b = y
+// for signals of the same length. The normal equations are accumulated from
+// lagged dot products instead of forming the lag matrices, and solved with
+// LDLT. Directions with no energy get a zero coefficient.
+VectorXd laggedOls(const Ref<const VectorXd> &u, int p,
+                   const Ref<const VectorXd> &v, int q,
+                   const Ref<const VectorXd> &y);
+
+// Writes y - [shiftAndStack(u, p), shiftAndStack(v, q)] b to eps, which must
+// not alias u or v.
+void laggedResidual(const Ref<const VectorXd> &u, int p,
+                    const Ref<const VectorXd> &v, int q,
+                    const Ref<const VectorXd> &b,
+                    const Ref<const VectorXd> &y, Ref<VectorXd> eps);
+
 VectorXd autoCorr(const Ref<const VectorXd> &x, const int m);
 
 VectorXd burg(const Ref<const VectorXd> &x, const int m);
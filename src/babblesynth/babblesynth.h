@@ -50,10 +50,29 @@
 // Defines a formant filter.
 #include "filter/formant_filter.h"
 
+// Defines a streaming renderer for a source generator and formant filter.
+#include "renderer.h"
+
+// Defines a single-pass peak normalizer for streamed output.
+#include "normalizer.h"
+
+// Defines a thread pool and a renderer for many utterances in parallel.
+#include "thread_pool.h"
+#include "batch_renderer.h"
+
+// Defines opt-in timers and counters for the stages of a render.
+#include "profiler.h"
+
 // Defines general filtering functions.
 #include "filter/filters.h"
 
 // Defines an AR-MA model fit function.
 #include "arma/fit.h"
 
+// Defines a parallel formant analyzer for recordings.
+#include "arma/frame_analyzer.h"
+
+// Defines the memory-mapped compiled phoneme dictionary format.
+#include "dictionary/compiled_dictionary.h"
+
 #endif  // BABBLESYNTH_BABBLESYNTH_H
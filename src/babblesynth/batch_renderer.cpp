@@ -0,0 +1,215 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "batch_renderer.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "renderer.h"
+
+using namespace babblesynth;
+
+namespace {
+
+bool isNumeric(const parameter& param) {
+    const std::string type = param.type();
+    return type == "int" || type == "double" || type == "bool";
+}
+
+double numericValue(const parameter& param) {
+    if (std::string(param.type()) == "bool") {
+        return param.value<bool>() ? 1 : 0;
+    }
+    return param.value<double>();
+}
+
+// Sets a numeric parameter while keeping its original value type.
+void setNumericValue(parameter& param, const double value) {
+    const std::string type = param.type();
+
+    bool accepted;
+    if (type == "int") {
+        accepted = !param.setValue(int(std::lround(value)));
+    } else if (type == "bool") {
+        accepted = !param.setValue(value != 0);
+    } else if (type == "double") {
+        accepted = !param.setValue(value);
+    } else {
+        throw std::invalid_argument("parameter \"" + param.name() +
+                                    "\" is not numeric");
+    }
+
+    if (!accepted) {
+        throw std::invalid_argument("invalid value for parameter \"" +
+                                    param.name() + "\"");
+    }
+}
+
+std::vector<std::pair<std::string, double>> numericDefaults(
+    const parameter_holder& holder) {
+    std::vector<std::pair<std::string, double>> defaults;
+    for (const auto& name : holder.getParameterNames()) {
+        const auto& param = holder.getParameter(name);
+        if (isNumeric(param)) {
+            defaults.emplace_back(name, numericValue(param));
+        }
+    }
+    return defaults;
+}
+
+// Applies the job's value for every parameter in `defaults`, falling back to
+// the default one, and skips the parameters which already hold that value.
+void applyNumeric(parameter_holder& holder,
+                  const std::vector<std::pair<std::string, double>>& defaults,
+                  const std::map<std::string, double>& values) {
+    for (const auto& [name, value] : values) {
+        // Throws for unknown parameter names.
+        if (!isNumeric(holder.getParameter(name))) {
+            throw std::invalid_argument("parameter \"" + name +
+                                        "\" is not numeric");
+        }
+    }
+
+    for (const auto& [name, defaultValue] : defaults) {
+        const auto it = values.find(name);
+        const double value = it != values.end() ? it->second : defaultValue;
+
+        auto& param = holder.getParameter(name);
+        if (numericValue(param) != value) {
+            setNumericValue(param, value);
+        }
+    }
+}
+
+}  // namespace
+
+render_voice::render_voice(const int sampleRate)
+    : m_source(sampleRate), m_filter(sampleRate), m_normalizer(sampleRate) {
+    for (const auto& name : m_filter.getParameterNames()) {
+        const auto& param = m_filter.getParameter(name);
+        if (std::string(param.type()) == "var_plan") {
+            m_filterPlans.emplace_back(name, param.value<variable_plan>());
+        }
+    }
+
+    m_generatorParameters = numericDefaults(m_source);
+    m_sourceParameters = numericDefaults(*m_source.getSource());
+}
+
+std::vector<double> render_voice::render(const render_job& job) {
+    configure(job);
+
+    std::vector<std::pair<int, int>> periods;
+    double Oq;
+
+    const auto glottal = m_source.generate(periods, &Oq);
+    return m_filter.generateFrom(glottal, periods, Oq);
+}
+
+void render_voice::stream(const render_job& job, const int blockSize,
+                          const block_sink& sink) {
+    configure(job);
+
+    renderer stream(m_source, m_filter, blockSize);
+    stream.begin();
+    m_normalizer.begin(job.amplitudePlan);
+
+    m_rendered.resize(blockSize);
+    m_block.resize(blockSize);
+
+    while (!m_normalizer.finished()) {
+        while (m_normalizer.available() < blockSize && !stream.finished()) {
+            const int count = stream.process(m_rendered.data(), blockSize);
+            m_normalizer.write(m_rendered.data(), count);
+        }
+        if (stream.finished()) {
+            m_normalizer.finish();
+        }
+
+        const int count = m_normalizer.read(m_block.data(), blockSize);
+        if (count > 0) {
+            sink(m_block.data(), count);
+        }
+    }
+}
+
+void render_voice::configure(const render_job& job) {
+    m_source.getParameter("Pitch plan").setValue(job.pitchPlan);
+    m_source.getParameter("Amplitude plan").setValue(job.amplitudePlan);
+
+    for (const auto& [name, plan] : job.filterPlans) {
+        // Throws for unknown parameter names.
+        m_filter.getParameter(name);
+    }
+
+    for (const auto& [name, defaultPlan] : m_filterPlans) {
+        const auto it = job.filterPlans.find(name);
+        m_filter.getParameter(name).setValue(
+            it != job.filterPlans.end() ? it->second : defaultPlan);
+    }
+
+    applyNumeric(m_source, m_generatorParameters, job.generatorParameters);
+    applyNumeric(*m_source.getSource(), m_sourceParameters,
+                 job.sourceParameters);
+}
+
+batch_renderer::batch_renderer(int sampleRate, int numThreads)
+    : m_sampleRate(sampleRate), m_pool(numThreads) {
+    m_voices.resize(m_pool.size());
+}
+
+batch_renderer::~batch_renderer() = default;
+
+int batch_renderer::sampleRate() const { return m_sampleRate; }
+
+int batch_renderer::numThreads() const { return m_pool.size(); }
+
+std::vector<std::vector<double>> batch_renderer::render(
+    const std::vector<render_job>& jobs) {
+    std::vector<std::vector<double>> outputs(jobs.size());
+
+    m_pool.run(jobs.size(), [&](const int index, const int worker) {
+        outputs[index] = voiceFor(worker).render(jobs[index]);
+    });
+
+    return outputs;
+}
+
+void batch_renderer::render(const std::vector<render_job>& jobs,
+                            const block_sink& sink, const int blockSize) {
+    m_pool.run(jobs.size(), [&](const int index, const int worker) {
+        voiceFor(worker).stream(
+            jobs[index], blockSize,
+            [&](const double* samples, const int count) {
+                sink(index, samples, count);
+            });
+        sink(index, nullptr, 0);
+    });
+}
+
+render_voice& batch_renderer::voiceFor(const int worker) {
+    // Only ever called from the worker itself, so no locking is needed. The
+    // voice is created on its own thread on first use.
+    auto& voice = m_voices[worker];
+    if (!voice) {
+        voice = std::make_unique<render_voice>(m_sampleRate);
+    }
+    return *voice;
+}
@@ -0,0 +1,132 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BABBLESYNTH_BATCH_RENDERER_H
+#define BABBLESYNTH_BATCH_RENDERER_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "filter/formant_filter.h"
+#include "generator/source_generator.h"
+#include "normalizer.h"
+#include "thread_pool.h"
+
+namespace babblesynth {
+
+// One independent utterance to render.
+//
+// Anything that isn't specified keeps the default value of a freshly
+// constructed source generator and formant filter, regardless of the jobs
+// rendered before it.
+struct render_job {
+    variable_plan pitchPlan =
+        variable_plan(false, 220).stepToValueAtTime(220, 1.0);
+    variable_plan amplitudePlan =
+        variable_plan(false, 1).stepToValueAtTime(1, 1.0);
+
+    // Formant filter plans by parameter name, e.g. "F1 plan" or "AB2 plan".
+    std::map<std::string, variable_plan> filterPlans;
+
+    // Numeric parameters of the source generator ("Jitter", "Aspiration",
+    // ...) and of its glottal source ("Oq", "am", ...), by name.
+    std::map<std::string, double> generatorParameters;
+    std::map<std::string, double> sourceParameters;
+};
+
+// A source generator and a formant filter which render jobs one after the
+// other. They are reset to the defaults and then configured from the job
+// before each render, so a job never depends on the ones before it. Not
+// thread-safe, every thread needs its own voice.
+class render_voice {
+   public:
+    explicit render_voice(int sampleRate);
+
+    // Normalized like formant_filter::generateFrom does.
+    std::vector<double> render(const render_job& job);
+
+    // Streams the output to `sink` in blocks of at most `blockSize` samples,
+    // as it is rendered. It is normalized in the same pass by a
+    // stream_normalizer, so its peak can be a little under 1. An exception
+    // thrown by the sink stops the render.
+    using block_sink = std::function<void(const double* samples, int count)>;
+    void stream(const render_job& job, int blockSize, const block_sink& sink);
+
+   private:
+    void configure(const render_job& job);
+
+    generator::source_generator m_source;
+    filter::formant_filter m_filter;
+
+    // Default values, captured right after construction.
+    std::vector<std::pair<std::string, variable_plan>> m_filterPlans;
+    std::vector<std::pair<std::string, double>> m_generatorParameters;
+    std::vector<std::pair<std::string, double>> m_sourceParameters;
+
+    stream_normalizer m_normalizer;
+    std::vector<double> m_rendered;
+    std::vector<double> m_block;
+};
+
+// Renders many independent utterances in parallel.
+//
+// Every worker thread of the pool owns its own render_voice, so jobs never
+// share any mutable state.
+class batch_renderer {
+   public:
+    // A thread count of 0 uses one worker per hardware thread.
+    explicit batch_renderer(int sampleRate, int numThreads = 0);
+    ~batch_renderer();
+
+    int sampleRate() const;
+    int numThreads() const;
+
+    // Renders every job and returns the outputs in the same order, each one
+    // normalized like formant_filter::generateFrom does.
+    std::vector<std::vector<double>> render(
+        const std::vector<render_job>& jobs);
+
+    // Receives consecutive blocks of the output of job number `job`, then a
+    // last call with a count of 0 once that job is complete. The blocks of a
+    // job all come from the same thread, in order, but the blocks of
+    // different jobs come from several threads at the same time.
+    using block_sink =
+        std::function<void(int job, const double* samples, int count)>;
+
+    // Same as above, but streams every output to `sink` in blocks of at most
+    // `blockSize` samples instead of returning them, so the memory use
+    // doesn't grow with the length of the utterances. See
+    // render_voice::stream() for how they are normalized.
+    void render(const std::vector<render_job>& jobs, const block_sink& sink,
+                int blockSize = 4096);
+
+   private:
+    render_voice& voiceFor(int worker);
+
+    int m_sampleRate;
+    thread_pool m_pool;
+    std::vector<std::unique_ptr<render_voice>> m_voices;
+};
+
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_BATCH_RENDERER_H
@@ -0,0 +1,535 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "compiled_dictionary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace babblesynth::dictionary;
+
+namespace {
+
+enum {
+    StringsSection,
+    PoleZerosSection,
+    PhonemesSection,
+    EntriesSection,
+    MappingsSection,
+    NodesSection,
+    EdgesSection,
+    NumSections,
+};
+
+struct section_ref {
+    uint32_t offset;  // in bytes from the start of the file
+    uint32_t count;   // in records
+};
+
+struct file_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t numSections;
+    uint64_t sourceHash;
+    section_ref sections[NumSections];
+};
+
+constexpr char fileMagic[4] = {'B', 'S', 'P', 'D'};
+constexpr uint32_t fileByteOrder = 0x01020304;
+
+}  // namespace
+
+// The records are read in place, their layout must not depend on the
+// compiler.
+static_assert(sizeof(pole_zero) == 24);
+static_assert(sizeof(mapping_entry) == 24);
+static_assert(sizeof(phoneme_record) == 24);
+static_assert(sizeof(mapping_record) == 16);
+static_assert(sizeof(trie_node) == 12);
+static_assert(sizeof(trie_edge) == 8);
+static_assert(sizeof(file_header) == 80);
+
+char16_t babblesynth::dictionary::foldCase(const char16_t c) {
+    if (c < 0x80) {
+        return (c >= u'A' && c <= u'Z') ? c + 0x20 : c;
+    }
+    // Latin-1, except the multiplication sign.
+    if (c >= 0xC0 && c <= 0xDE && c != 0xD7) {
+        return c + 0x20;
+    }
+    // Latin Extended-A, where upper and lower case alternate. The dotted I
+    // has no lower case of its own.
+    if ((c >= 0x100 && c <= 0x137 && c != 0x130) ||
+        (c >= 0x14A && c <= 0x177)) {
+        return c | 1;
+    }
+    if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) {
+        return (c & 1) ? c + 1 : c;
+    }
+    // Greek and Cyrillic.
+    if (c >= 0x391 && c <= 0x3AB && c != 0x3A2) {
+        return c + 0x20;
+    }
+    if (c >= 0x400 && c <= 0x40F) {
+        return c + 0x50;
+    }
+    if (c >= 0x410 && c <= 0x42F) {
+        return c + 0x20;
+    }
+    return c;
+}
+
+compiled_dictionary::compiled_dictionary(const std::string& filename)
+    : m_data(nullptr), m_size(0), m_mapping(nullptr) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("can't open " + filename);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        throw std::runtime_error(filename + " is not a phoneme dictionary");
+    }
+
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        throw std::runtime_error("can't map " + filename);
+    }
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        throw std::runtime_error("can't map " + filename);
+    }
+
+    m_data = static_cast<const char*>(data);
+    m_size = size.QuadPart;
+    m_mapping = mapping;
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("can't open " + filename);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw std::runtime_error(filename + " is not a phoneme dictionary");
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("can't map " + filename);
+    }
+
+    m_data = static_cast<const char*>(data);
+    m_size = info.st_size;
+#endif
+
+    try {
+        validate();
+    } catch (...) {
+        unmap();
+        throw;
+    }
+}
+
+compiled_dictionary::~compiled_dictionary() { unmap(); }
+
+void compiled_dictionary::unmap() {
+    if (m_data == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+#else
+    munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+}
+
+template <typename T>
+array_view<T> compiled_dictionary::section(const int index) const {
+    const auto& header = *reinterpret_cast<const file_header*>(m_data);
+    const section_ref& ref = header.sections[index];
+
+    if (ref.offset % alignof(T) != 0 ||
+        ref.offset + uint64_t(ref.count) * sizeof(T) > m_size) {
+        throw std::runtime_error("phoneme dictionary section out of bounds");
+    }
+
+    return {reinterpret_cast<const T*>(m_data + ref.offset), ref.count};
+}
+
+// Every index stored in the file is checked here, so that the accessors can
+// trust them.
+void compiled_dictionary::validate() {
+    if (m_size < sizeof(file_header)) {
+        throw std::runtime_error("not a phoneme dictionary");
+    }
+
+    const auto& header = *reinterpret_cast<const file_header*>(m_data);
+
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0) {
+        throw std::runtime_error("not a phoneme dictionary");
+    }
+    if (header.byteOrder != fileByteOrder) {
+        throw std::runtime_error(
+            "phoneme dictionary was compiled with another byte order");
+    }
+    if (header.version != version || header.numSections != NumSections) {
+        throw std::runtime_error("unsupported phoneme dictionary version");
+    }
+
+    m_strings = section<char16_t>(StringsSection);
+    m_poleZeros = section<pole_zero>(PoleZerosSection);
+    m_phonemes = section<phoneme_record>(PhonemesSection);
+    m_entries = section<mapping_entry>(EntriesSection);
+    m_mappings = section<mapping_record>(MappingsSection);
+    m_nodes = section<trie_node>(NodesSection);
+    m_edges = section<trie_edge>(EdgesSection);
+
+    const auto checkString = [this](const string_ref& ref) {
+        if (uint64_t(ref.offset) + ref.length >= m_strings.size() ||
+            m_strings[ref.offset + ref.length] != 0) {
+            throw std::runtime_error("invalid phoneme dictionary string");
+        }
+    };
+
+    const auto checkRange = [](uint32_t first, uint32_t count, size_t size) {
+        if (uint64_t(first) + count > size) {
+            throw std::runtime_error("invalid phoneme dictionary range");
+        }
+    };
+
+    for (const auto& phoneme : m_phonemes) {
+        checkString(phoneme.name);
+        checkRange(phoneme.firstPole, phoneme.numPoles, m_poleZeros.size());
+        checkRange(phoneme.firstZero, phoneme.numZeros, m_poleZeros.size());
+    }
+
+    for (const auto& entry : m_entries) {
+        if (entry.phoneme >= m_phonemes.size()) {
+            throw std::runtime_error("invalid phoneme dictionary entry");
+        }
+    }
+
+    for (const auto& mapping : m_mappings) {
+        checkString(mapping.name);
+        checkRange(mapping.firstEntry, mapping.numEntries, m_entries.size());
+    }
+
+    if (m_nodes.empty()) {
+        throw std::runtime_error("phoneme dictionary has no prefix tree");
+    }
+
+    for (const auto& node : m_nodes) {
+        checkRange(node.firstEdge, node.numEdges, m_edges.size());
+        if (node.mapping < -1 || node.mapping >= int64_t(m_mappings.size())) {
+            throw std::runtime_error("invalid phoneme dictionary mapping");
+        }
+    }
+
+    for (const auto& edge : m_edges) {
+        if (edge.child >= m_nodes.size()) {
+            throw std::runtime_error("invalid phoneme dictionary tree");
+        }
+    }
+}
+
+uint64_t compiled_dictionary::sourceHash() const {
+    return reinterpret_cast<const file_header*>(m_data)->sourceHash;
+}
+
+uint64_t compiled_dictionary::hashSource(const char* data, const size_t size) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= uint8_t(data[i]);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+std::u16string_view compiled_dictionary::string(const string_ref& ref) const {
+    return {m_strings.begin() + ref.offset, ref.length};
+}
+
+size_t compiled_dictionary::phonemeCount() const { return m_phonemes.size(); }
+
+std::u16string_view compiled_dictionary::phonemeName(
+    const size_t phoneme) const {
+    return string(m_phonemes[phoneme].name);
+}
+
+array_view<pole_zero> compiled_dictionary::poles(const size_t phoneme) const {
+    const auto& record = m_phonemes[phoneme];
+    return {m_poleZeros.begin() + record.firstPole, record.numPoles};
+}
+
+array_view<pole_zero> compiled_dictionary::zeros(const size_t phoneme) const {
+    const auto& record = m_phonemes[phoneme];
+    return {m_poleZeros.begin() + record.firstZero, record.numZeros};
+}
+
+size_t compiled_dictionary::mappingCount() const { return m_mappings.size(); }
+
+std::u16string_view compiled_dictionary::mappingName(
+    const size_t mapping) const {
+    return string(m_mappings[mapping].name);
+}
+
+array_view<mapping_entry> compiled_dictionary::entries(
+    const size_t mapping) const {
+    const auto& record = m_mappings[mapping];
+    return {m_entries.begin() + record.firstEntry, record.numEntries};
+}
+
+int compiled_dictionary::child(const uint32_t node,
+                               const char16_t character) const {
+    const trie_node& record = m_nodes[node];
+    const auto first = m_edges.begin() + record.firstEdge;
+    const auto last = first + record.numEdges;
+
+    const char16_t folded = foldCase(character);
+    const auto it = std::lower_bound(
+        first, last, folded,
+        [](const trie_edge& edge, char16_t ch) { return edge.character < ch; });
+
+    if (it == last || it->character != folded) {
+        return -1;
+    }
+    return it->child;
+}
+
+int compiled_dictionary::findMapping(const std::u16string_view name) const {
+    int node = 0;
+    for (const char16_t character : name) {
+        node = child(node, character);
+        if (node < 0) {
+            return -1;
+        }
+    }
+    return m_nodes[node].mapping;
+}
+
+std::vector<compiled_dictionary::match> compiled_dictionary::matchMappings(
+    const std::u16string_view text) const {
+    const int textLength = text.size();
+
+    std::vector<match> matches;
+
+    int chIndex = 0;
+
+    while (chIndex < textLength) {
+        match found{chIndex, 0, -1};
+
+        int node = 0;
+        for (int i = chIndex; i < textLength; ++i) {
+            node = child(node, text[i]);
+            if (node < 0) {
+                break;
+            }
+            if (m_nodes[node].mapping >= 0) {
+                found.length = i + 1 - chIndex;
+                found.mapping = m_nodes[node].mapping;
+            }
+        }
+
+        if (found.length > 0) {
+            chIndex += found.length;
+            matches.push_back(found);
+        } else {
+            chIndex++;
+        }
+    }
+
+    return matches;
+}
+
+dictionary_builder::dictionary_builder() : m_sourceHash(0) {}
+
+uint32_t dictionary_builder::addString(const std::u16string_view string) {
+    const uint32_t offset = m_strings.size();
+    m_strings.insert(m_strings.end(), string.begin(), string.end());
+    m_strings.push_back(0);
+    return offset;
+}
+
+uint32_t dictionary_builder::addPhoneme(const std::u16string_view name,
+                                        const std::vector<pole_zero>& poles,
+                                        const std::vector<pole_zero>& zeros) {
+    phoneme_record record;
+    record.name = {addString(name), uint32_t(name.size())};
+
+    record.firstPole = m_poleZeros.size();
+    record.numPoles = poles.size();
+    m_poleZeros.insert(m_poleZeros.end(), poles.begin(), poles.end());
+
+    record.firstZero = m_poleZeros.size();
+    record.numZeros = zeros.size();
+    m_poleZeros.insert(m_poleZeros.end(), zeros.begin(), zeros.end());
+
+    m_phonemes.push_back(record);
+    return m_phonemes.size() - 1;
+}
+
+void dictionary_builder::addMapping(const std::u16string_view name,
+                                    const std::vector<mapping_entry>& entries) {
+    for (const auto& entry : entries) {
+        if (entry.phoneme >= m_phonemes.size()) {
+            throw std::invalid_argument("mapping refers to an unknown phoneme");
+        }
+    }
+
+    mapping_record record;
+    record.name = {addString(name), uint32_t(name.size())};
+    record.firstEntry = m_entries.size();
+    record.numEntries = entries.size();
+    m_entries.insert(m_entries.end(), entries.begin(), entries.end());
+
+    m_mappings.push_back(record);
+}
+
+void dictionary_builder::setSourceHash(const uint64_t hash) {
+    m_sourceHash = hash;
+}
+
+std::vector<char> dictionary_builder::serialize() const {
+    // Build the prefix tree with sorted children, then lay out the edges of
+    // each node next to each other.
+    struct node {
+        std::vector<std::pair<char16_t, uint32_t>> children;
+        int32_t mapping = -1;
+    };
+    std::vector<node> tree(1);
+
+    for (size_t m = 0; m < m_mappings.size(); ++m) {
+        const auto& name = m_mappings[m].name;
+        uint32_t current = 0;
+
+        for (uint32_t i = 0; i < name.length; ++i) {
+            const char16_t character = foldCase(m_strings[name.offset + i]);
+            auto& children = tree[current].children;
+            const auto it = std::lower_bound(
+                children.begin(), children.end(), character,
+                [](const auto& edge, char16_t ch) { return edge.first < ch; });
+
+            if (it != children.end() && it->first == character) {
+                current = it->second;
+            } else {
+                const uint32_t next = tree.size();
+                // The edge goes first, adding the node may move `children`.
+                children.emplace(it, character, next);
+                tree.emplace_back();
+                current = next;
+            }
+        }
+
+        if (current == 0) {
+            continue;  // an empty name never matches
+        }
+        if (tree[current].mapping >= 0) {
+            const auto& first = m_mappings[tree[current].mapping].name;
+            if (std::equal(m_strings.begin() + first.offset,
+                           m_strings.begin() + first.offset + first.length,
+                           m_strings.begin() + name.offset,
+                           m_strings.begin() + name.offset + name.length)) {
+                throw std::invalid_argument("duplicate mapping name");
+            }
+            continue;
+        }
+        tree[current].mapping = m;
+    }
+
+    std::vector<trie_node> nodes;
+    std::vector<trie_edge> edges;
+    nodes.reserve(tree.size());
+
+    for (const auto& n : tree) {
+        nodes.push_back({uint32_t(edges.size()), uint32_t(n.children.size()),
+                         n.mapping});
+        for (const auto& [character, next] : n.children) {
+            edges.push_back({character, 0, next});
+        }
+    }
+
+    // Lay out the file.
+    file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = compiled_dictionary::version;
+    header.byteOrder = fileByteOrder;
+    header.numSections = NumSections;
+    header.sourceHash = m_sourceHash;
+
+    std::vector<char> file(sizeof(header));
+
+    const auto append = [&file, &header](int index, const auto& records) {
+        file.resize((file.size() + 7) / 8 * 8, 0);
+        header.sections[index] = {uint32_t(file.size()),
+                                  uint32_t(records.size())};
+        const auto bytes = reinterpret_cast<const char*>(records.data());
+        file.insert(file.end(), bytes,
+                    bytes + records.size() * sizeof(records[0]));
+    };
+
+    append(StringsSection, m_strings);
+    append(PoleZerosSection, m_poleZeros);
+    append(PhonemesSection, m_phonemes);
+    append(EntriesSection, m_entries);
+    append(MappingsSection, m_mappings);
+    append(NodesSection, nodes);
+    append(EdgesSection, edges);
+
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    return file;
+}
+
+void dictionary_builder::write(const std::string& filename) const {
+    const std::vector<char> file = serialize();
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(file.data(), file.size());
+    out.close();
+
+    if (!out) {
+        throw std::runtime_error("can't write " + filename);
+    }
+}
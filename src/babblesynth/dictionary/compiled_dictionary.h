@@ -0,0 +1,219 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BABBLESYNTH_DICTIONARY_COMPILED_DICTIONARY_H
+#define BABBLESYNTH_DICTIONARY_COMPILED_DICTIONARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace babblesynth {
+namespace dictionary {
+
+// Phoneme dictionaries in a flat binary format, which is used in place once
+// the file is memory-mapped.
+//
+// The file starts with a header followed by sections of fixed-size records,
+// each aligned to 8 bytes, in the byte order of the machine that wrote it:
+//
+//  - strings: the UTF-16 names, each one followed by a 0,
+//  - pole_zero: the poles and zeros of every phoneme, phoneme by phoneme,
+//  - phoneme_record: name, and range of poles and of zeros,
+//  - mapping_entry: the phonemes of every mapping, mapping by mapping,
+//  - mapping_record: name, and range of entries,
+//  - trie_node and trie_edge: a prefix tree of the mapping names, the root is
+//    the first node and the edges of each node are sorted by character. The
+//    characters are case-folded, see foldCase().
+
+struct pole_zero {
+    double frequency;
+    double bandwidth;
+    int32_t index;  // formant number, or -1 for the next one
+    int32_t padding;
+};
+
+struct mapping_entry {
+    double duration;
+    double intensity;
+    uint32_t phoneme;
+    uint32_t padding;
+};
+
+struct string_ref {
+    uint32_t offset;  // in UTF-16 code units
+    uint32_t length;
+};
+
+struct phoneme_record {
+    string_ref name;
+    uint32_t firstPole;
+    uint32_t numPoles;
+    uint32_t firstZero;
+    uint32_t numZeros;
+};
+
+struct mapping_record {
+    string_ref name;
+    uint32_t firstEntry;
+    uint32_t numEntries;
+};
+
+struct trie_node {
+    uint32_t firstEdge;
+    uint32_t numEdges;
+    int32_t mapping;  // -1 if no name ends here
+};
+
+struct trie_edge {
+    char16_t character;
+    uint16_t padding;
+    uint32_t child;
+};
+
+// Lower case of a UTF-16 code unit, for the Latin, Greek and Cyrillic
+// letters. Mapping names are matched without regard to case, like the XML
+// dictionaries always were.
+char16_t foldCase(char16_t character);
+
+template <typename T>
+class array_view {
+   public:
+    array_view() : m_data(nullptr), m_size(0) {}
+    array_view(const T* data, size_t size) : m_data(data), m_size(size) {}
+
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const T& operator[](size_t i) const { return m_data[i]; }
+
+   private:
+    const T* m_data;
+    size_t m_size;
+};
+
+// Read-only view of a compiled dictionary file.
+//
+// The file is memory-mapped and checked once when opened, then every
+// accessor returns pointers into it, so opening a dictionary costs about the
+// same whatever its size. Throws std::runtime_error if the file can't be
+// read or isn't a valid dictionary.
+class compiled_dictionary {
+   public:
+    explicit compiled_dictionary(const std::string& filename);
+    ~compiled_dictionary();
+
+    compiled_dictionary(const compiled_dictionary&) = delete;
+    compiled_dictionary& operator=(const compiled_dictionary&) = delete;
+
+    static constexpr uint32_t version = 2;
+
+    // Identifies the file the dictionary was compiled from, see hashSource().
+    uint64_t sourceHash() const;
+
+    // 64-bit FNV-1a hash of a source file.
+    static uint64_t hashSource(const char* data, size_t size);
+
+    size_t phonemeCount() const;
+    std::u16string_view phonemeName(size_t phoneme) const;
+    array_view<pole_zero> poles(size_t phoneme) const;
+    array_view<pole_zero> zeros(size_t phoneme) const;
+
+    size_t mappingCount() const;
+    std::u16string_view mappingName(size_t mapping) const;
+    array_view<mapping_entry> entries(size_t mapping) const;
+
+    // The mapping with this name, ignoring case, or -1.
+    int findMapping(std::u16string_view name) const;
+
+    struct match {
+        int start;
+        int length;
+        int mapping;
+    };
+
+    // Splits the text into the longest mappings that match from left to
+    // right, ignoring case, and skipping the characters which no mapping
+    // starts with.
+    std::vector<match> matchMappings(std::u16string_view text) const;
+
+   private:
+    void validate();
+    void unmap();
+
+    // Child of `node` along the folded case of `character`, or -1.
+    int child(uint32_t node, char16_t character) const;
+
+    template <typename T>
+    array_view<T> section(int index) const;
+
+    std::u16string_view string(const string_ref& ref) const;
+
+    const char* m_data;
+    size_t m_size;
+    void* m_mapping;  // platform handle of the mapping
+
+    array_view<char16_t> m_strings;
+    array_view<pole_zero> m_poleZeros;
+    array_view<phoneme_record> m_phonemes;
+    array_view<mapping_entry> m_entries;
+    array_view<mapping_record> m_mappings;
+    array_view<trie_node> m_nodes;
+    array_view<trie_edge> m_edges;
+};
+
+// Collects phonemes and mappings, then writes them as a compiled dictionary.
+class dictionary_builder {
+   public:
+    dictionary_builder();
+
+    // Returns the index of the phoneme for mapping_entry::phoneme.
+    uint32_t addPhoneme(std::u16string_view name,
+                        const std::vector<pole_zero>& poles,
+                        const std::vector<pole_zero>& zeros);
+
+    // Mapping names must be unique, an empty name never matches. Of names
+    // which only differ by case, the first one added is the one matched.
+    void addMapping(std::u16string_view name,
+                    const std::vector<mapping_entry>& entries);
+
+    void setSourceHash(uint64_t hash);
+
+    std::vector<char> serialize() const;
+
+    // Throws std::runtime_error if the file can't be written.
+    void write(const std::string& filename) const;
+
+   private:
+    uint32_t addString(std::u16string_view string);
+
+    std::vector<char16_t> m_strings;
+    std::vector<pole_zero> m_poleZeros;
+    std::vector<phoneme_record> m_phonemes;
+    std::vector<mapping_entry> m_entries;
+    std::vector<mapping_record> m_mappings;
+    uint64_t m_sourceHash;
+};
+
+}  // namespace dictionary
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_DICTIONARY_COMPILED_DICTIONARY_H
@@ -26,8 +26,43 @@
 namespace babblesynth {
 namespace filter {
 
+// Roots of P[0] x^n + P[1] x^(n-1) + ... + P[n], by Aberth's method. The
+// starting points only depend on P, so the result is reproducible.
 std::vector<std::complex<double>> solveRoots(const std::vector<double>& P);
 
+// Finds the roots of successive polynomials whose roots move little from one
+// to the next, such as the models fitted to consecutive frames of a
+// recording.
+//
+// Each call starts from the roots found by the previous one, which takes far
+// fewer iterations than starting over, and root i keeps following the same
+// root from one call to the next. The first call, a change of degree, or a
+// warm start which doesn't converge fall back to the starting points of
+// solveRoots(). Instances share no state and can run on different threads.
+class root_tracker {
+   public:
+    root_tracker();
+
+    const std::vector<std::complex<double>>& solve(
+        const std::vector<double>& P);
+
+    // Number of iterations taken by the last call to solve().
+    int iterations() const;
+
+    // Forgets the previous roots.
+    void reset();
+
+   private:
+    std::vector<std::complex<double>> m_roots;
+    int m_iterations;
+};
+
+// Solves every polynomial in order with a single root_tracker. The number of
+// iterations for each one is stored in `iterations` unless it is null.
+std::vector<std::vector<std::complex<double>>> solveRootsTracked(
+    const std::vector<std::vector<double>>& polys,
+    std::vector<int>* iterations = nullptr);
+
 double tf2zpk(const std::vector<double>& b, const std::vector<double>& a,
               std::vector<std::complex<double>>& z,
               std::vector<std::complex<double>>& p);
@@ -40,10 +75,52 @@ void lfilter(const std::vector<double>& b, const std::vector<double>& a,
              const std::vector<double>& x, std::vector<double>& y, int start,
              int end, std::vector<double>& z);
 
+// The pointer overloads are instantiated for float and double samples.
+template <typename T>
+void lfilter(const std::vector<T>& b, const std::vector<T>& a, const T* x,
+             T* y, int length, std::vector<T>& z);
+
 void sosfilt(const std::vector<std::array<double, 6>>& sos,
              const std::vector<double>& x, std::vector<double>& y, int start,
              int end, std::vector<std::array<double, 2>>& zi);
 
+template <typename T>
+void sosfilt(const std::vector<std::array<T, 6>>& sos, const T* x, T* y,
+             int length, std::vector<std::array<T, 2>>& zi);
+
+// Fixed-size cascade, for coefficient banks that are updated in place.
+template <typename T, size_t N>
+void sosfilt(const std::array<std::array<T, 6>, N>& sos, const T* x, T* y,
+             int length, std::array<std::array<T, 2>, N>& zi) {
+    for (int k = 0; k < length; ++k) {
+        T x_cur = x[k];
+        T x_new;
+        for (int s = 0; s < N; ++s) {
+            x_new = sos[s][0] * x_cur + zi[s][0];
+            zi[s][0] = sos[s][1] * x_cur - sos[s][4] * x_new + zi[s][1];
+            zi[s][1] = sos[s][2] * x_cur - sos[s][5] * x_new;
+            x_cur = x_new;
+        }
+        y[k] = x_cur;
+    }
+}
+
+// Runs the same cascade topology over several independent voices at once.
+// Everything is stored as structure-of-arrays, with the voice index varying
+// fastest:
+//   sos[(s * 6 + c) * voices + v]  coefficient c of section s for voice v
+//   zi[(s * 2 + j) * voices + v]   state j of section s for voice v
+//   x[k * voices + v], y[k * voices + v]  sample k for voice v
+// The best kernel available on the running CPU is picked on the first call.
+// Results are bit-identical to running sosfilt on each voice separately.
+void sosfilt_batch(const double* sos, const double* x, double* y,
+                   int sections, int voices, int length, double* zi);
+void sosfilt_batch(const float* sos, const float* x, float* y, int sections,
+                   int voices, int length, float* zi);
+
+// Name of the kernel used by sosfilt_batch ("avx512", "avx2" or "scalar").
+const char* sosfilt_batch_kernel();
+
 }  // namespace filter
 }  // namespace babblesynth
 
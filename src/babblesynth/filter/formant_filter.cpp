@@ -18,11 +18,13 @@
 
 #include "formant_filter.h"
 
+#include <algorithm>
 #include <cmath>
 #include <complex>
 #include <numeric>
 
 #include "../generator/noise.h"
+#include "../profiler.h"
 #include "filters.h"
 
 using namespace babblesynth::filter;
@@ -43,6 +45,12 @@ formant_filter::formant_filter(int sampleRate)
       m_Z2(true),
       m_A1(true),
       m_A2(true),
+      m_Oq(0),
+      m_position(0),
+      m_segmentEnd(-1),
+      m_isOpenPhase(false),
+      m_gci(0),
+      m_nextPeriod(0),
       m_sampleRate(sampleRate) {
     addParameter("F1 plan", variable_plan(true, 1000));
     addParameter("F2 plan", variable_plan(true, 1300));
@@ -68,21 +76,140 @@ std::vector<double> formant_filter::generateFrom(
     const std::vector<std::pair<int, int>>& periods, double Oq) {
     const int samples = input.size();
 
-    std::vector<double> output(samples, 0);
+    std::vector<double> outputFilt(samples, 0);
 
-    m_filterState.clear();
+    begin(Oq);
 
+    for (const auto& [startIndex, endIndex] : periods) {
+        addPeriod(startIndex, endIndex);
+    }
+
+    process(input.data(), outputFilt.data(), samples);
+
+    profiler::scoped_timer timer(profiler::StageNormalization, samples);
+
+    double maxAmplitude = 1e-10;
+
+    for (int i = 0; i < samples; ++i) {
+        const double xa = std::abs(outputFilt[i]);
+        if (xa > maxAmplitude) {
+            maxAmplitude = xa;
+        }
+    }
+
+    for (int i = 0; i < samples; ++i) {
+        outputFilt[i] /= maxAmplitude;
+    }
+
+    return outputFilt;
+}
+
+void formant_filter::begin(const double Oq) {
+    m_Oq = Oq;
+    m_position = 0;
+    m_segmentEnd = -1;
+    m_isOpenPhase = false;
+    m_periods.clear();
+    m_nextPeriod = 0;
+
+    std::get<cascade<float>>(m_cascades).reset();
+    std::get<cascade<double>>(m_cascades).reset();
+}
+
+formant_filter::checkpoint formant_filter::save() const {
+    return {m_cascades,
+            m_Oq,
+            m_position,
+            m_segmentEnd,
+            m_isOpenPhase,
+            m_gci,
+            {m_periods.begin() + m_nextPeriod, m_periods.end()}};
+}
+
+void formant_filter::restore(const checkpoint& cp) {
+    m_cascades = cp.cascades;
+    m_Oq = cp.Oq;
+    m_position = cp.position;
+    m_segmentEnd = cp.segmentEnd;
+    m_isOpenPhase = cp.isOpenPhase;
+    m_gci = cp.gci;
+    m_periods = cp.periods;
+    m_nextPeriod = 0;
+}
+
+void formant_filter::addPeriod(const int startIndex, const int endIndex) {
+    m_periods.emplace_back(startIndex, endIndex);
+}
+
+void formant_filter::process(const double* input, double* output,
+                             const int frames) {
+    processCascade(input, output, frames);
+}
+
+void formant_filter::process(const float* input, float* output,
+                             const int frames) {
+    processCascade(input, output, frames);
+}
+
+template <typename T>
+void formant_filter::processCascade(const T* input, T* output,
+                                    const int frames) {
+    auto& c = std::get<cascade<T>>(m_cascades);
+
+    int done = 0;
+
+    while (done < frames) {
+        bool hasSegment = true;
+        while (m_position > m_segmentEnd) {
+            profiler::scoped_timer timer(profiler::StageFilterDesign);
+            if (!nextSegment()) {
+                hasSegment = false;
+                break;
+            }
+            for (int s = 0; s < numSections; ++s) {
+                std::copy(m_filter[s].begin(), m_filter[s].end(),
+                          c.sos[s].begin());
+            }
+        }
+
+        if (hasSegment) {
+            const int count =
+                std::min(frames - done, m_segmentEnd - m_position + 1);
+            profiler::scoped_timer timer(profiler::StageSosfilt, count);
+            sosfilt(c.sos, input + done, output + done, count, c.zi);
+            done += count;
+            m_position += count;
+        } else {
+            // Samples which aren't covered by any period are left silent.
+            output[done] = 0;
+            done++;
+            m_position++;
+        }
+    }
+
+    profiler::scoped_timer timer(profiler::StageIntegrator, frames);
+    lfilter(c.integratorB, c.integratorA, output, output, frames,
+            c.integratorState);
+}
+
+bool formant_filter::nextSegment() {
     constexpr double fffAmp = 0.065;
     constexpr double fbfAmp = 0.03;
 
     constexpr double affAmp = 0.02;
     constexpr double abfAmp = 0.01;
 
-    for (const auto& [startIndex, endIndex] : periods) {
-        const double gci = startIndex + Oq * (endIndex - startIndex);
+    if (!m_isOpenPhase) {
+        if (m_nextPeriod >= m_periods.size()) {
+            return false;
+        }
+
+        const auto [startIndex, endIndex] = m_periods[m_nextPeriod];
 
-        const double openTime = ((startIndex + gci) / 2) / double(m_sampleRate);
-        const double closedTime = ((gci + endIndex) / 2) / double(m_sampleRate);
+        m_gci = startIndex + m_Oq * (endIndex - startIndex);
+
+        const double openTime =
+            ((startIndex + m_gci) / 2) / double(m_sampleRate);
 
         const double openFlutter =
             (sin(24.1 * M_PI * openTime) + sin(12.7 * M_PI * openTime) +
@@ -117,9 +244,20 @@ std::vector<double> formant_filter::generateFrom(
         designFilter({F1o, F2o, F3o, F4o, F5o}, {B1o, B2o, B3o, B4o, B5o},
                      {Z1o, Z2o}, {A1o, A2o});
 
-        sosfilt(m_filter, input, output, startIndex, gci - 1, m_filterState);
+        m_isOpenPhase = true;
+        m_segmentEnd = int(m_gci - 1);
+    } else {
+        const auto [startIndex, endIndex] = m_periods[m_nextPeriod];
+
+        if (++m_nextPeriod == m_periods.size()) {
+            m_periods.clear();
+            m_nextPeriod = 0;
+        }
+
+        const double closedTime =
+            ((m_gci + endIndex) / 2) / double(m_sampleRate);
 
-        const double gciTime = gci / m_sampleRate;
+        const double gciTime = m_gci / m_sampleRate;
         const double gciFlutter =
             (sin(24.1 * M_PI * gciTime) + sin(12.7 * M_PI * gciTime) +
              sin(7.1 * M_PI * gciTime) + sin(4.7 * M_PI * gciTime)) /
@@ -160,55 +298,38 @@ std::vector<double> formant_filter::generateFrom(
         designFilter({F1c, F2c, F3c, F4c, F5c}, {B1c, B2c, B3c, B4c, B5c},
                      {Z1c, Z2c}, {A1c, A2c});
 
-        sosfilt(m_filter, input, output, gci, endIndex, m_filterState);
-    }
-
-    std::vector<double> outputFilt(output);
-    std::vector<double> intZ(1, 0);
-
-    lfilter({1, 0}, {1, 0.99}, output, outputFilt, 0, samples - 1, intZ);
-
-    double maxAmplitude = 1e-10;
-
-    for (int i = 0; i < samples; ++i) {
-        const double xa = std::abs(outputFilt[i]);
-        if (xa > maxAmplitude) {
-            maxAmplitude = xa;
-        }
+        m_isOpenPhase = false;
+        m_segmentEnd = endIndex;
     }
 
-    for (int i = 0; i < samples; ++i) {
-        outputFilt[i] /= maxAmplitude;
-    }
-
-    return outputFilt;
+    return true;
 }
 
-void formant_filter::designFilter(const std::vector<double>& resF,
-                                  const std::vector<double>& resB,
-                                  const std::vector<double>& antiF,
-                                  const std::vector<double>& antiB) {
-    std::vector<std::array<double, 6>> sos;
-    std::vector<double> b, a;
-
-    for (int i = 0; i < resF.size(); ++i) {
-        designResonance(resF[i], resB[i], b, a);
-        sos.push_back({b[0], b[1], b[2], a[0], a[1], a[2]});
+void formant_filter::designFilter(
+    const std::array<double, numFormants>& resF,
+    const std::array<double, numFormants>& resB,
+    const std::array<double, numAntiformants>& antiF,
+    const std::array<double, numAntiformants>& antiB) {
+    // Sections are laid out in reverse order: the auto-filled formants come
+    // first, then the antiformants, then the formants from F5 down to F1.
+    int section = numSections - 1;
+
+    for (int i = 0; i < numFormants; ++i) {
+        designResonance(resF[i], resB[i], m_filter[section--]);
     }
 
-    for (int i = 0; i < antiF.size(); ++i) {
-        designAntiresonance(antiF[i], antiB[i], b, a);
-        sos.push_back({b[0], b[1], b[2], a[0], a[1], a[2]});
+    for (int i = 0; i < numAntiformants; ++i) {
+        designAntiresonance(antiF[i], antiB[i], m_filter[section--]);
     }
 
     // Take the normalized average of 3rd formant and above.
     double avg;
-    if (resF.size() > 2) {
+    if (numFormants > 2) {
         double sum = 0;
-        for (int i = 2; i < resF.size(); ++i) {
+        for (int i = 2; i < numFormants; ++i) {
             sum += resF[i] / (i + 1);
         }
-        avg = sum / (resF.size() - 2);
+        avg = sum / (numFormants - 2);
     } else {
         avg = (resF[0] + resF[1]) / 2;
     }
@@ -217,38 +338,29 @@ void formant_filter::designFilter(const std::vector<double>& resF,
     // Auto-fill up to ten total formants.
     double freq = resF.back() + avg;
 
-    while (sos.size() < 10) {
+    while (section >= 0) {
         const double bandwidth = 0.3 * freq;
 
-        designResonance(freq, bandwidth, b, a);
-        sos.push_back({b[0], b[1], b[2], a[0], a[1], a[2]});
+        designResonance(freq, bandwidth, m_filter[section--]);
 
         freq += avg;
     }
-
-    std::reverse(sos.begin(), sos.end());
-
-    m_filter = sos;
-    m_filterState.resize(sos.size(), {0.0, 0.0});
 }
 
 double formant_filter::designResonance(double f, double bw,
-                                       std::vector<double>& b,
-                                       std::vector<double>& a) {
+                                       std::array<double, 6>& sos) {
     const double R = exp(-M_PI * bw / m_sampleRate);
     const double theta = 2 * M_PI * f / m_sampleRate;
 
     const double b0 = (1 - R) * sqrt(1 - 2 * R * cos(2 * theta) + (R * R));
 
-    b = {b0, b0, 0};
-    a = {1, -2 * R * cos(theta), R * R};
+    sos = {b0, b0, 0, 1, -2 * R * cos(theta), R * R};
 
     return R;
 }
 
 double formant_filter::designAntiresonance(double f, double bw,
-                                           std::vector<double>& b,
-                                           std::vector<double>& a) {
+                                           std::array<double, 6>& sos) {
     const double R = exp(-M_PI * bw / m_sampleRate);
     const double theta = 2 * M_PI * f / m_sampleRate;
 
@@ -256,8 +368,7 @@ double formant_filter::designAntiresonance(double f, double bw,
 
     // b = {b0, b0, 0};
 
-    b = {1, 0, theta * theta};
-    a = {1, theta / (f / bw), theta * theta};
+    sos = {1, 0, theta * theta, 1, theta / (f / bw), theta * theta};
 
     return R;
 }
@@ -19,6 +19,9 @@
 #ifndef BABBLESYNTH_FORMANT_FILTER_H
 #define BABBLESYNTH_FORMANT_FILTER_H
 
+#include <array>
+#include <tuple>
+
 #include "../parameter_holder.h"
 #include "../variable.h"
 
@@ -34,17 +37,79 @@ class formant_filter : public parameter_holder {
         const std::vector<double>& input,
         const std::vector<std::pair<int, int>>& periods, double Oq);
 
+    // Streaming interface: begin() resets the filter state, addPeriod()
+    // queues the next pitch period (in absolute sample indices, contiguous
+    // from sample 0, as reported by source_generator::process), and process()
+    // filters the next `frames` samples. Every sample passed to process() must
+    // belong to a period that was queued beforehand. Unlike generateFrom(),
+    // the streamed output is not peak-normalized.
+    //
+    // Filters are always designed in double precision, process() runs the
+    // cascade in the precision of its arguments.
+    void begin(double Oq);
+    void addPeriod(int startIndex, int endIndex);
+    void process(const double* input, double* output, int frames);
+    void process(const float* input, float* output, int frames);
+
+    // Number of second-order sections in the vocal tract filter.
+    static constexpr int numSections = 10;
+    static constexpr int numFormants = 5;
+    static constexpr int numAntiformants = 2;
+
+   private:
+    using sos_bank = std::array<std::array<double, 6>, numSections>;
+
+    // Coefficients and state of the vocal tract and glottal integrator
+    // filters, in the sample type they run in.
+    template <typename T>
+    struct cascade {
+        std::array<std::array<T, 6>, numSections> sos;
+        std::array<std::array<T, 2>, numSections> zi;
+        std::vector<T> integratorB{1, 0};
+        std::vector<T> integratorA{1, T(0.99)};
+        std::vector<T> integratorState{0};
+
+        void reset() {
+            zi = {};
+            integratorState.assign(1, 0);
+        }
+    };
+
+   public:
+    // Everything process() carries over from one call to the next, including
+    // the periods which were queued but not filtered yet.
+    struct checkpoint {
+        std::tuple<cascade<float>, cascade<double>> cascades;
+        double Oq;
+        int position;
+        int segmentEnd;
+        bool isOpenPhase;
+        double gci;
+        std::vector<std::pair<int, int>> periods;
+    };
+
+    // Filter designs only depend on the plans up to the end of the last
+    // period which was filtered, see source_generator::checkpoint.
+    checkpoint save() const;
+    void restore(const checkpoint& cp);
+
    private:
-    void designFilter(const std::vector<double>& resF,
-                      const std::vector<double>& resB,
-                      const std::vector<double>& antiF,
-                      const std::vector<double>& antiB);
 
-    double designResonance(double f, double bw, std::vector<double>& b,
-                           std::vector<double>& a);
+    template <typename T>
+    void processCascade(const T* input, T* output, int frames);
 
-    double designAntiresonance(double f, double bw, std::vector<double>& b,
-                               std::vector<double>& a);
+    bool nextSegment();
+
+    // Updates m_filter in place, without allocating.
+    void designFilter(const std::array<double, numFormants>& resF,
+                      const std::array<double, numFormants>& resB,
+                      const std::array<double, numAntiformants>& antiF,
+                      const std::array<double, numAntiformants>& antiB);
+
+    double designResonance(double f, double bw, std::array<double, 6>& sos);
+
+    double designAntiresonance(double f, double bw,
+                               std::array<double, 6>& sos);
 
     bool onParameterChange(const parameter& param) override;
 
@@ -66,8 +131,20 @@ class formant_filter : public parameter_holder {
     variable m_A1;
     variable m_A2;
 
-    std::vector<std::array<double, 6>> m_filter;
-    std::vector<std::array<double, 2>> m_filterState;
+    sos_bank m_filter;
+    std::tuple<cascade<float>, cascade<double>> m_cascades;
+
+    // Streaming state.
+    double m_Oq;
+    int m_position;
+    int m_segmentEnd;
+    bool m_isOpenPhase;
+    double m_gci;
+
+    // Queued periods, consumed from m_nextPeriod onwards. The vector is only
+    // cleared (keeping its capacity) once every queued period was consumed.
+    std::vector<std::pair<int, int>> m_periods;
+    int m_nextPeriod;
 
     int m_sampleRate;
 };
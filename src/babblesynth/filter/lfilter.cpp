@@ -23,6 +23,12 @@ using namespace babblesynth;
 void filter::lfilter(const std::vector<double>& b, const std::vector<double>& a,
                      const std::vector<double>& x, std::vector<double>& y,
                      int start, int end, std::vector<double>& z) {
+    lfilter(b, a, x.data() + start, y.data() + start, end - start + 1, z);
+}
+
+template <typename T>
+void filter::lfilter(const std::vector<T>& b, const std::vector<T>& a,
+                     const T* x, T* y, int length, std::vector<T>& z) {
     const int len_b = b.size();
     // const int len_a = a.size();
 
@@ -35,7 +41,7 @@ void filter::lfilter(const std::vector<double>& b, const std::vector<double>& a,
 
     // Assume the filter is already normalized.
 
-    for (k = start; k <= end; ++k) {
+    for (k = 0; k < length; ++k) {
         j = 0;
 
         if (len_b > 1) {
@@ -56,3 +62,10 @@ void filter::lfilter(const std::vector<double>& b, const std::vector<double>& a,
         }
     }
 }
+
+template void filter::lfilter(const std::vector<float>&,
+                              const std::vector<float>&, const float*, float*,
+                              int, std::vector<float>&);
+template void filter::lfilter(const std::vector<double>&,
+                              const std::vector<double>&, const double*,
+                              double*, int, std::vector<double>&);
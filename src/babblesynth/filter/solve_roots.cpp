@@ -17,13 +17,9 @@
  */
 
 #include <iostream>
-#include <random>
 
 #include "filters.h"
 
-static std::random_device rd;
-static std::mt19937 gen(rd());
-
 using namespace babblesynth;
 
 static std::pair<double, double> upperLowerBounds(
@@ -44,17 +40,19 @@ static std::pair<double, double> upperLowerBounds(
     return std::make_pair(upper, lower);
 }
 
+// Spreads the starting points over the annulus which contains every root.
+// The angles are offset so that no point lies on the real axis, from where
+// Aberth's method could never reach a complex root of a real polynomial.
 static std::vector<std::complex<double>> initRoots(
     const std::vector<double>& P) {
     const int degree = (int)P.size() - 1;
     const auto [upper, lower] = upperLowerBounds(P);
 
-    static std::uniform_real_distribution<> radius(lower, upper);
-    static std::uniform_real_distribution<> angle(0, 2 * M_PI);
-
     std::vector<std::complex<double>> roots;
     for (int i = 0; i < degree; ++i) {
-        roots.push_back(std::polar(radius(gen), angle(gen)));
+        const double radius = lower + (upper - lower) * (i + 0.5) / degree;
+        const double angle = 2 * M_PI * (i + 0.25) / degree + 0.4;
+        roots.push_back(std::polar(radius, angle));
     }
 
     return roots;
@@ -86,11 +84,14 @@ static std::vector<std::complex<double>> evaluatePolyDer(
     return derivatives;
 }
 
-static void aberthIterate(const std::vector<double>& P,
-                          std::vector<std::complex<double>>& roots) {
-    int iteration = 0;
+// Returns whether every root converged within `maxIterations` sweeps, and
+// the number of sweeps done in `iterations`.
+static bool aberthIterate(const std::vector<double>& P,
+                          std::vector<std::complex<double>>& roots,
+                          const int maxIterations, int& iterations) {
+    iterations = 0;
 
-    while (true) {
+    while (iterations < maxIterations) {
         int valid = 0;
         for (int k = 0; k < (int)roots.size(); ++k) {
             auto y = evaluatePolyDer(P, roots[k], 1);
@@ -110,15 +111,29 @@ static void aberthIterate(const std::vector<double>& P,
             }
             roots[k] -= offset;
         }
+        iterations++;
         if (valid == (int)roots.size()) {
-            break;
-        }
-        if (iteration > 50) {
-            std::cout << "aberth: didn't converge fast enough" << std::endl;
-            break;
+            return true;
         }
-        iteration++;
     }
+
+    return false;
+}
+
+static constexpr int maxColdIterations = 52;
+static constexpr int maxWarmIterations = 20;
+
+// Solves from the starting points of initRoots(), returns the number of
+// sweeps.
+static int solveCold(const std::vector<double>& P,
+                     std::vector<std::complex<double>>& roots) {
+    roots = initRoots(P);
+
+    int iterations;
+    if (!aberthIterate(P, roots, maxColdIterations, iterations)) {
+        std::cout << "aberth: didn't converge fast enough" << std::endl;
+    }
+    return iterations;
 }
 
 std::vector<std::complex<double>> filter::solveRoots(
@@ -127,9 +142,68 @@ std::vector<std::complex<double>> filter::solveRoots(
         return {};
     }
 
-    auto roots = initRoots(P);
+    std::vector<std::complex<double>> roots;
+    solveCold(P, roots);
+    return roots;
+}
+
+filter::root_tracker::root_tracker() : m_iterations(0) {}
+
+const std::vector<std::complex<double>>& filter::root_tracker::solve(
+    const std::vector<double>& P) {
+    const int degree = (int)P.size() - 1;
+
+    if (degree < 1) {
+        m_roots.clear();
+        m_iterations = 0;
+        return m_roots;
+    }
+
+    int warmIterations = 0;
+
+    if (m_roots.size() == degree) {
+        // A slight rotation moves real roots off the real axis, so that they
+        // can still turn into a complex pair.
+        const auto nudge = std::polar(1.0, 1e-3);
+        for (auto& root : m_roots) {
+            root *= nudge;
+        }
+
+        if (aberthIterate(P, m_roots, maxWarmIterations, warmIterations)) {
+            m_iterations = warmIterations;
+            return m_roots;
+        }
+    }
+
+    m_iterations = warmIterations + solveCold(P, m_roots);
+    return m_roots;
+}
+
+int filter::root_tracker::iterations() const { return m_iterations; }
 
-    aberthIterate(P, roots);
+void filter::root_tracker::reset() {
+    m_roots.clear();
+    m_iterations = 0;
+}
+
+std::vector<std::vector<std::complex<double>>> filter::solveRootsTracked(
+    const std::vector<std::vector<double>>& polys,
+    std::vector<int>* iterations) {
+    root_tracker tracker;
+
+    std::vector<std::vector<std::complex<double>>> roots;
+    roots.reserve(polys.size());
+
+    if (iterations != nullptr) {
+        iterations->clear();
+    }
+
+    for (const auto& P : polys) {
+        roots.push_back(tracker.solve(P));
+        if (iterations != nullptr) {
+            iterations->push_back(tracker.iterations());
+        }
+    }
 
     return roots;
-}
\ No newline at end of file
+}
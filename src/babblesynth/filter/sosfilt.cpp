@@ -24,9 +24,15 @@ void filter::sosfilt(const std::vector<std::array<double, 6>>& sos,
                      const std::vector<double>& x, std::vector<double>& y,
                      int start, int end,
                      std::vector<std::array<double, 2>>& zi) {
-    for (int k = start; k <= end; ++k) {
-        double x_cur = x[k];
-        double x_new;
+    sosfilt(sos, x.data() + start, y.data() + start, end - start + 1, zi);
+}
+
+template <typename T>
+void filter::sosfilt(const std::vector<std::array<T, 6>>& sos, const T* x,
+                     T* y, int length, std::vector<std::array<T, 2>>& zi) {
+    for (int k = 0; k < length; ++k) {
+        T x_cur = x[k];
+        T x_new;
         for (int s = 0; s < sos.size(); ++s) {
             x_new = sos[s][0] * x_cur + zi[s][0];
             zi[s][0] = sos[s][1] * x_cur - sos[s][4] * x_new + zi[s][1];
@@ -36,3 +42,10 @@ void filter::sosfilt(const std::vector<std::array<double, 6>>& sos,
         y[k] = x_cur;
     }
 }
+
+template void filter::sosfilt(const std::vector<std::array<float, 6>>&,
+                              const float*, float*, int,
+                              std::vector<std::array<float, 2>>&);
+template void filter::sosfilt(const std::vector<std::array<double, 6>>&,
+                              const double*, double*, int,
+                              std::vector<std::array<double, 2>>&);
@@ -0,0 +1,292 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "filters.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define BABBLESYNTH_SOSFILT_X86
+#include <immintrin.h>
+#endif
+
+using namespace babblesynth;
+
+namespace {
+
+// Filters voices [first, last) one at a time, reading the interleaved layout.
+template <typename T>
+void sosfilt_batch_scalar(const T* sos, const T* x, T* y, int sections,
+                          int voices, int length, T* zi, int first, int last) {
+    for (int v = first; v < last; ++v) {
+        for (int k = 0; k < length; ++k) {
+            T x_cur = x[k * voices + v];
+            T x_new;
+            for (int s = 0; s < sections; ++s) {
+                const T* c = sos + s * 6 * voices + v;
+                T* z = zi + s * 2 * voices + v;
+
+                x_new = c[0] * x_cur + z[0];
+                z[0] = c[voices] * x_cur - c[4 * voices] * x_new + z[voices];
+                z[voices] = c[2 * voices] * x_cur - c[5 * voices] * x_new;
+                x_cur = x_new;
+            }
+            y[k * voices + v] = x_cur;
+        }
+    }
+}
+
+#ifdef BABBLESYNTH_SOSFILT_X86
+
+// The vector kernels use separate multiplies and adds on purpose, so that the
+// results match the scalar cascade exactly. AVX-512 implies FMA support, so
+// contraction has to be turned off explicitly.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#define BABBLESYNTH_NO_CONTRACT
+#else
+#define BABBLESYNTH_NO_CONTRACT optimize("fp-contract=off"),
+#endif
+
+__attribute__((BABBLESYNTH_NO_CONTRACT target("avx2")))
+int sosfilt_batch_avx2(const double* sos, const double* x, double* y,
+                       int sections, int voices, int length, double* zi,
+                       int first) {
+    constexpr int width = 4;
+    int v = first;
+
+    for (; v + width <= voices; v += width) {
+        for (int k = 0; k < length; ++k) {
+            __m256d x_cur = _mm256_loadu_pd(x + k * voices + v);
+            for (int s = 0; s < sections; ++s) {
+                const double* c = sos + s * 6 * voices + v;
+                double* z = zi + s * 2 * voices + v;
+
+                const __m256d b0 = _mm256_loadu_pd(c);
+                const __m256d b1 = _mm256_loadu_pd(c + voices);
+                const __m256d b2 = _mm256_loadu_pd(c + 2 * voices);
+                const __m256d a1 = _mm256_loadu_pd(c + 4 * voices);
+                const __m256d a2 = _mm256_loadu_pd(c + 5 * voices);
+                const __m256d z0 = _mm256_loadu_pd(z);
+                const __m256d z1 = _mm256_loadu_pd(z + voices);
+
+                const __m256d x_new =
+                    _mm256_add_pd(_mm256_mul_pd(b0, x_cur), z0);
+                _mm256_storeu_pd(
+                    z, _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(b1, x_cur),
+                                                   _mm256_mul_pd(a1, x_new)),
+                                     z1));
+                _mm256_storeu_pd(z + voices,
+                                 _mm256_sub_pd(_mm256_mul_pd(b2, x_cur),
+                                               _mm256_mul_pd(a2, x_new)));
+                x_cur = x_new;
+            }
+            _mm256_storeu_pd(y + k * voices + v, x_cur);
+        }
+    }
+
+    return v;
+}
+
+__attribute__((BABBLESYNTH_NO_CONTRACT target("avx512f")))
+int sosfilt_batch_avx512(const double* sos, const double* x, double* y,
+                         int sections, int voices, int length, double* zi,
+                         int first) {
+    constexpr int width = 8;
+    int v = first;
+
+    for (; v + width <= voices; v += width) {
+        for (int k = 0; k < length; ++k) {
+            __m512d x_cur = _mm512_loadu_pd(x + k * voices + v);
+            for (int s = 0; s < sections; ++s) {
+                const double* c = sos + s * 6 * voices + v;
+                double* z = zi + s * 2 * voices + v;
+
+                const __m512d b0 = _mm512_loadu_pd(c);
+                const __m512d b1 = _mm512_loadu_pd(c + voices);
+                const __m512d b2 = _mm512_loadu_pd(c + 2 * voices);
+                const __m512d a1 = _mm512_loadu_pd(c + 4 * voices);
+                const __m512d a2 = _mm512_loadu_pd(c + 5 * voices);
+                const __m512d z0 = _mm512_loadu_pd(z);
+                const __m512d z1 = _mm512_loadu_pd(z + voices);
+
+                const __m512d x_new =
+                    _mm512_add_pd(_mm512_mul_pd(b0, x_cur), z0);
+                _mm512_storeu_pd(
+                    z, _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(b1, x_cur),
+                                                   _mm512_mul_pd(a1, x_new)),
+                                     z1));
+                _mm512_storeu_pd(z + voices,
+                                 _mm512_sub_pd(_mm512_mul_pd(b2, x_cur),
+                                               _mm512_mul_pd(a2, x_new)));
+                x_cur = x_new;
+            }
+            _mm512_storeu_pd(y + k * voices + v, x_cur);
+        }
+    }
+
+    return v;
+}
+
+// Single precision kernels, twice as many voices per register.
+
+__attribute__((BABBLESYNTH_NO_CONTRACT target("avx2")))
+int sosfilt_batch_avx2_f(const float* sos, const float* x, float* y,
+                         int sections, int voices, int length, float* zi,
+                         int first) {
+    constexpr int width = 8;
+    int v = first;
+
+    for (; v + width <= voices; v += width) {
+        for (int k = 0; k < length; ++k) {
+            __m256 x_cur = _mm256_loadu_ps(x + k * voices + v);
+            for (int s = 0; s < sections; ++s) {
+                const float* c = sos + s * 6 * voices + v;
+                float* z = zi + s * 2 * voices + v;
+
+                const __m256 b0 = _mm256_loadu_ps(c);
+                const __m256 b1 = _mm256_loadu_ps(c + voices);
+                const __m256 b2 = _mm256_loadu_ps(c + 2 * voices);
+                const __m256 a1 = _mm256_loadu_ps(c + 4 * voices);
+                const __m256 a2 = _mm256_loadu_ps(c + 5 * voices);
+                const __m256 z0 = _mm256_loadu_ps(z);
+                const __m256 z1 = _mm256_loadu_ps(z + voices);
+
+                const __m256 x_new =
+                    _mm256_add_ps(_mm256_mul_ps(b0, x_cur), z0);
+                _mm256_storeu_ps(
+                    z, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, x_cur),
+                                                   _mm256_mul_ps(a1, x_new)),
+                                     z1));
+                _mm256_storeu_ps(z + voices,
+                                 _mm256_sub_ps(_mm256_mul_ps(b2, x_cur),
+                                               _mm256_mul_ps(a2, x_new)));
+                x_cur = x_new;
+            }
+            _mm256_storeu_ps(y + k * voices + v, x_cur);
+        }
+    }
+
+    return v;
+}
+
+__attribute__((BABBLESYNTH_NO_CONTRACT target("avx512f")))
+int sosfilt_batch_avx512_f(const float* sos, const float* x, float* y,
+                           int sections, int voices, int length, float* zi,
+                           int first) {
+    constexpr int width = 16;
+    int v = first;
+
+    for (; v + width <= voices; v += width) {
+        for (int k = 0; k < length; ++k) {
+            __m512 x_cur = _mm512_loadu_ps(x + k * voices + v);
+            for (int s = 0; s < sections; ++s) {
+                const float* c = sos + s * 6 * voices + v;
+                float* z = zi + s * 2 * voices + v;
+
+                const __m512 b0 = _mm512_loadu_ps(c);
+                const __m512 b1 = _mm512_loadu_ps(c + voices);
+                const __m512 b2 = _mm512_loadu_ps(c + 2 * voices);
+                const __m512 a1 = _mm512_loadu_ps(c + 4 * voices);
+                const __m512 a2 = _mm512_loadu_ps(c + 5 * voices);
+                const __m512 z0 = _mm512_loadu_ps(z);
+                const __m512 z1 = _mm512_loadu_ps(z + voices);
+
+                const __m512 x_new =
+                    _mm512_add_ps(_mm512_mul_ps(b0, x_cur), z0);
+                _mm512_storeu_ps(
+                    z, _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(b1, x_cur),
+                                                   _mm512_mul_ps(a1, x_new)),
+                                     z1));
+                _mm512_storeu_ps(z + voices,
+                                 _mm512_sub_ps(_mm512_mul_ps(b2, x_cur),
+                                               _mm512_mul_ps(a2, x_new)));
+                x_cur = x_new;
+            }
+            _mm512_storeu_ps(y + k * voices + v, x_cur);
+        }
+    }
+
+    return v;
+}
+
+#endif  // BABBLESYNTH_SOSFILT_X86
+
+// Filters whole vectors of voices starting at voice first and returns the
+// index of the first voice left over.
+template <typename T>
+using batch_kernel = int (*)(const T*, const T*, T*, int, int, int, T*, int);
+
+// Kernels are listed widest first, so that the voices left over by one vector
+// width fall through to the next narrower one and then to the scalar loop.
+struct kernel_choice {
+    static constexpr int maxKernels = 2;
+
+    batch_kernel<double> kernels[maxKernels];
+    batch_kernel<float> kernelsFloat[maxKernels];
+    const char* name;
+};
+
+kernel_choice chooseKernel() {
+#ifdef BABBLESYNTH_SOSFILT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return {{sosfilt_batch_avx512, sosfilt_batch_avx2},
+                {sosfilt_batch_avx512_f, sosfilt_batch_avx2_f},
+                "avx512"};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return {{sosfilt_batch_avx2}, {sosfilt_batch_avx2_f}, "avx2"};
+    }
+#endif
+    return {{}, {}, "scalar"};
+}
+
+const kernel_choice& selectedKernel() {
+    static const kernel_choice choice = chooseKernel();
+    return choice;
+}
+
+template <typename T>
+void sosfilt_batch_dispatch(const batch_kernel<T>* kernels, const T* sos,
+                            const T* x, T* y, int sections, int voices,
+                            int length, T* zi) {
+    int first = 0;
+    for (int i = 0; i < kernel_choice::maxKernels && kernels[i] != nullptr;
+         ++i) {
+        first = kernels[i](sos, x, y, sections, voices, length, zi, first);
+    }
+
+    sosfilt_batch_scalar(sos, x, y, sections, voices, length, zi, first,
+                         voices);
+}
+
+}  // namespace
+
+void filter::sosfilt_batch(const double* sos, const double* x, double* y,
+                           int sections, int voices, int length, double* zi) {
+    sosfilt_batch_dispatch(selectedKernel().kernels, sos, x, y, sections,
+                           voices, length, zi);
+}
+
+void filter::sosfilt_batch(const float* sos, const float* x, float* y,
+                           int sections, int voices, int length, float* zi) {
+    sosfilt_batch_dispatch(selectedKernel().kernelsFloat, sos, x, y, sections,
+                           voices, length, zi);
+}
+
+const char* filter::sosfilt_batch_kernel() { return selectedKernel().name; }
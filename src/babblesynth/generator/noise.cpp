@@ -19,12 +19,13 @@
 #include "noise.h"
 
 #include <array>
+#include <cmath>
 
 using namespace babblesynth::generator;
 
-std::random_device noise::rd;
-std::mt19937 noise::gen(rd());
-std::uniform_real_distribution<> noise::dis(-1.0, 1.0);
+thread_local std::random_device noise::rd;
+thread_local std::mt19937 noise::gen(rd());
+thread_local std::uniform_real_distribution<> noise::dis(-1.0, 1.0);
 
 std::vector<double> noise::white(int length) {
     std::vector<double> out(length);
@@ -52,4 +53,128 @@ std::vector<double> noise::colored(int length, double alpha) {
         out[i] = filtered[filter.size() + i];
     }
     return out;
-}
\ No newline at end of file
+}
+
+noise::colored_stream::colored_stream(double alpha)
+    : m_degree(-1), m_position(0), m_dis(-1.0, 1.0) {
+    m_filter[0] = 1.0;
+    for (int k = 1; k < order; ++k) {
+        m_filter[k] = (k - 1.0 - alpha / 2.0) * m_filter[k - 1] / double(k);
+    }
+
+    m_length = order;
+    while (m_length > 1 && m_filter[m_length - 1] == 0.0) {
+        --m_length;
+    }
+
+    // The taps are then C(k + a - 1, a - 1) = prod (k + i) / i for i < a.
+    const double a = -alpha / 2.0;
+    if (a == std::round(a) && a >= 1 && a <= maxMoments) {
+        m_degree = int(a) - 1;
+
+        m_polynomial.fill(0.0);
+        m_polynomial[0] = 1.0;
+        for (int i = 1; i <= m_degree; ++i) {
+            for (int j = i; j >= 0; --j) {
+                m_polynomial[j] = (i * m_polynomial[j] +
+                                   (j > 0 ? m_polynomial[j - 1] : 0.0)) /
+                                  i;
+            }
+        }
+
+        for (int j = 0; j < maxMoments; ++j) {
+            m_binomial[j][0] = 1.0;
+            for (int i = 1; i <= j; ++i) {
+                m_binomial[j][i] = m_binomial[j][i - 1] * (j - i + 1) / i;
+            }
+            m_lastPowers[j] = std::pow(order - 1.0, j);
+        }
+    }
+
+    seed(std::random_device()());
+}
+
+void noise::colored_stream::seed(unsigned seed) {
+    m_gen.seed(seed);
+    m_dis.reset();
+
+    // Oldest samples first, like colored() does.
+    for (int i = order - 1; i >= 0; --i) {
+        m_history[i] = m_history[i + order] = m_dis(m_gen);
+    }
+    m_position = 0;
+
+    resetMoments();
+}
+
+void noise::colored_stream::resetMoments() {
+    if (m_degree < 0) {
+        return;
+    }
+
+    const double* history = m_history.data() + m_position;
+
+    m_moments.fill(0.0);
+    for (int k = 0; k < order; ++k) {
+        double power = 1.0;
+        for (int i = 0; i <= m_degree; ++i) {
+            m_moments[i] += power * history[k];
+            power *= k;
+        }
+    }
+}
+
+double noise::colored_stream::next() {
+    m_position = (m_position == 0) ? order - 1 : m_position - 1;
+
+    // The slot being overwritten holds the sample leaving the filter.
+    const double oldest = m_history[m_position];
+    const double white = m_dis(m_gen);
+    m_history[m_position] = m_history[m_position + order] = white;
+
+    if (m_degree >= 0) {
+        if (m_position == 0) {
+            resetMoments();
+        } else {
+            // Every sample moves one step further back, k^j becomes
+            // (k + 1)^j, and the oldest one leaves the window.
+            for (int j = m_degree; j >= 0; --j) {
+                double moment = (j == 0) ? white : 0.0;
+                for (int i = 0; i <= j; ++i) {
+                    moment += m_binomial[j][i] *
+                              (m_moments[i] - m_lastPowers[i] * oldest);
+                }
+                m_moments[j] = moment;
+            }
+        }
+
+        double out = 0.0;
+        for (int j = 0; j <= m_degree; ++j) {
+            out += m_polynomial[j] * m_moments[j];
+        }
+        return out;
+    }
+
+    const double* history = m_history.data() + m_position;
+
+    double out = 0.0;
+    for (int j = 0; j < m_length; ++j) {
+        out += m_filter[j] * history[j];
+    }
+    return out;
+}
+
+void noise::colored_stream::process(double* out, const int frames) {
+    for (int i = 0; i < frames; ++i) {
+        out[i] = next();
+    }
+}
+
+double noise::colored_stream::rms() const {
+    // White noise uniform in [-1, 1] has a variance of 1/3.
+    double energy = 0.0;
+    for (int j = 0; j < order; ++j) {
+        energy += m_filter[j] * m_filter[j];
+    }
+    return std::sqrt(energy / 3.0);
+}
@@ -19,6 +19,7 @@
 #ifndef BABBLESYNTH_NOISE_H
 #define BABBLESYNTH_NOISE_H
 
+#include <array>
 #include <random>
 #include <vector>
 
@@ -31,9 +32,65 @@ std::vector<double> colored(int length, double alpha = 2);
 
 inline std::vector<double> brown(int length) { return colored(length, 2); }
 
-extern std::random_device rd;
-extern std::mt19937 gen;
-extern std::uniform_real_distribution<> dis;
+// Per-thread, so that several generators can run on different threads.
+extern thread_local std::random_device rd;
+extern thread_local std::mt19937 gen;
+extern thread_local std::uniform_real_distribution<> dis;
+
+// Streaming version of colored(), with its own random engine.
+//
+// Produces the same 64-tap filtered noise one sample at a time, so nothing
+// needs to be allocated for the whole output. Instances share no state and
+// can run on different threads; two instances seeded alike produce the same
+// stream.
+//
+// When -alpha/2 is a small positive integer, the taps are a polynomial in the
+// tap index and the filter runs recursively from the running moments of the
+// last 64 white samples, which costs a few operations per sample instead of
+// 64. When alpha/2 is a non-negative integer, the taps end after alpha/2 + 1
+// and only those are convolved. Other exponents use the full convolution.
+class colored_stream {
+   public:
+    explicit colored_stream(double alpha = 2);
+
+    // Restarts the stream. The filter history is filled before returning, so
+    // the first sample is already in steady state.
+    void seed(unsigned seed);
+
+    double next();
+    void process(double* out, int frames);
+
+    // Steady-state RMS value of the output, known from the filter alone.
+    double rms() const;
+
+   private:
+    static constexpr int order = 64;
+    static constexpr int maxMoments = 4;
+
+    // Recomputes the moments from the history, so that rounding errors in the
+    // recursion don't build up.
+    void resetMoments();
+
+    std::array<double, order> m_filter;
+    int m_length;  // taps past this one are all zero
+
+    // Polynomial form of the taps, used when m_degree >= 0.
+    int m_degree;
+    std::array<double, maxMoments> m_polynomial;
+    std::array<std::array<double, maxMoments>, maxMoments> m_binomial;
+    std::array<double, maxMoments> m_lastPowers;  // (order - 1)^i
+
+    // Sum of k^i times the white sample k steps ago, over the history.
+    std::array<double, maxMoments> m_moments;
+
+    // Past white noise samples, newest first, stored twice in a row so that
+    // the filter always reads `order` contiguous values from m_position.
+    std::array<double, 2 * order> m_history;
+    int m_position;
+
+    std::mt19937 m_gen;
+    std::uniform_real_distribution<> m_dis;
+};
 }  // namespace noise
 
 }  // namespace generator
@@ -19,10 +19,12 @@
 #include "source_generator.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 
 #include "../filter/butterworth.h"
 #include "../filter/filters.h"
+#include "../profiler.h"
 #include "../source/abstract_source.h"
 #include "../source/lf.h"
 #include "noise.h"
@@ -33,9 +35,17 @@ source_generator::source_generator(int sampleRate)
     : parameter_holder(),
       m_pitch(true),
       m_amplitude(false),
+      m_isBandLimited(false),
+      m_noiseSeed(0),
+      m_noise(-4),
+      m_noiseAmplitude(4 * m_noise.rms()),
       m_sampleRate(sampleRate),
       m_antialiasFilter(filter::butterworth::lowPass(
-          8, double(sampleRate) / 2 - 2000, sampleRate)) {
+          8, double(sampleRate) / 2 - 2000, sampleRate)),
+      m_antialiasFilterF(m_antialiasFilter.size()),
+      m_samples(0),
+      m_index(0),
+      m_periodStart(0) {
     addParameter("Source type", source::sources.valueOf("LF"));
     addParameter("Pitch plan",
                  variable_plan(false, 220).stepToValueAtTime(220, 1.0));
@@ -44,6 +54,13 @@ source_generator::source_generator(int sampleRate)
     addParameter("Jitter", 0.03).setMin(0).setMax(1);
     addParameter("Aspiration", 0.10).setMin(0).setMax(1);
     addParameter("Flutter", 0.005).setMin(0).setMax(0.9);
+    addParameter("Band-limited", false);
+    addParameter("Noise seed", 0).setMin(0);
+
+    for (int s = 0; s < m_antialiasFilter.size(); ++s) {
+        std::copy(m_antialiasFilter[s].begin(), m_antialiasFilter[s].end(),
+                  m_antialiasFilterF[s].begin());
+    }
 }
 
 bool source_generator::onParameterChange(const parameter& param) {
@@ -64,6 +81,10 @@ bool source_generator::onParameterChange(const parameter& param) {
         m_jitterPercentage = param.value<double>();
     } else if (param.name() == "Flutter") {
         m_flutterAmplitude = param.value<double>();
+    } else if (param.name() == "Band-limited") {
+        m_isBandLimited = param.value<bool>();
+    } else if (param.name() == "Noise seed") {
+        m_noiseSeed = param.value<int>();
     }
 
     return true;
@@ -75,82 +96,217 @@ babblesynth::source::abstract_source* source_generator::getSource() {
 
 std::vector<double> source_generator::generate(
     std::vector<std::pair<int, int>>& periods, double* Oq) {
-    const double duration = m_pitch.maxTime();
-    const int samples = std::ceil(duration * m_sampleRate);
+    begin();
 
-    std::vector<double> output(samples, 0);
-    std::vector<double> noise = noise::colored(samples, -4);
+    std::vector<double> output(m_samples);
+    process(output.data(), m_samples, periods);
 
-    double noiseAmplitude =
-        std::max(-*std::min_element(noise.begin(), noise.end()),
-                 +*std::max_element(noise.begin(), noise.end()));
+    *Oq = m_Oq;
 
-    *Oq = m_source->getParameter("Oq").value<double>();
+    // Remove the last partial period.
+    output.resize(m_periodStart);
 
-    double phase = 0;
-    double c = 0;  // running compensation for lost low-order bits
+    return output;
+}
 
-    double lastNoise = noise[0] / noiseAmplitude;
+void source_generator::begin() {
+    m_samples = totalSamples();
 
-    int periodStart = 0;
+    m_noise.seed(m_noiseSeed != 0 ? m_noiseSeed : std::random_device()());
 
-    double maxAmplitude = 1e-10;
+    m_source->beginPeriod(0);
+    m_Oq = m_source->openQuotient();
+    m_periodOq = m_Oq;
 
-    auto aafiltz = std::vector<std::array<double, 2>>(m_antialiasFilter.size(),
-                                                      {0.0, 0.0});
+    m_index = 0;
+    m_periodStart = 0;
 
-    for (int index = 0; index < samples; ++index) {
-        const double time = index / double(m_sampleRate);
+    m_phase = 0;
+    m_phaseCompensation = 0;
 
-        const double f0 = m_pitch.evaluateAtTime(time);
+    m_nextNoise = m_noise.next() / m_noiseAmplitude;
+    m_lastNoise = m_nextNoise;
+    m_blampCarry = 0;
 
-        const double jitterHz = f0 * m_jitterPercentage * lastNoise / 2;
+    if (m_isBandLimited) {
+        m_discontinuities = m_source->slopeDiscontinuities();
+    } else {
+        m_discontinuities.clear();
+    }
 
-        const double flutter =
-            (sin(24.1 * M_PI * time) + sin(12.7 * M_PI * time) +
-             sin(7.1 * M_PI * time) + sin(4.7 * M_PI * time)) /
-            4;
+    m_antialiasState.assign(m_antialiasFilter.size(), {0.0, 0.0});
+    m_antialiasStateF.assign(m_antialiasFilter.size(), {0.0f, 0.0f});
+}
 
-        const double phaseDelta =
-            2 * M_PI * (f0 * (1 + m_flutterAmplitude * flutter) + jitterHz) /
-            m_sampleRate;
+int source_generator::process(double* out, const int frames,
+                              std::vector<std::pair<int, int>>& periods) {
+    const int count = processBlock(out, frames, periods);
 
-        m_amplitude.update(time);
+    if (!m_isBandLimited) {
+        profiler::scoped_timer timer(profiler::StageAntialias, count);
+        filter::sosfilt(m_antialiasFilter, out, out, count, m_antialiasState);
+    }
 
-        output[index] = m_source->evaluateAtPhase(phase);
+    return count;
+}
 
-        // Only add aspiration noise during the open phase.
-        if (phase / 2 * M_PI < *Oq) {
-            output[index] +=
-                m_aspirationPercentage * noise[index] / noiseAmplitude;
-        }
+int source_generator::process(float* out, const int frames,
+                              std::vector<std::pair<int, int>>& periods) {
+    const int count = processBlock(out, frames, periods);
 
-        output[index] *= m_amplitude.evaluateAtTime(time);
+    if (!m_isBandLimited) {
+        profiler::scoped_timer timer(profiler::StageAntialias, count);
+        filter::sosfilt(m_antialiasFilterF, out, out, count,
+                        m_antialiasStateF);
+    }
 
-        if (std::abs(output[index]) > maxAmplitude) {
-            maxAmplitude = std::abs(output[index]);
+    return count;
+}
+
+// The waveform is always evaluated in double precision, it is only rounded to
+// the output sample type when stored.
+template <typename T>
+int source_generator::processBlock(T* out, const int frames,
+                                   std::vector<std::pair<int, int>>& periods) {
+    // Past the end after restoring a checkpoint of a longer utterance.
+    const int count = std::max(0, std::min(frames, m_samples - m_index));
+
+    // The noise stream doesn't depend on anything else, so it is drawn a
+    // chunk at a time ahead of the waveform.
+    constexpr int chunkSize = 256;
+    std::array<double, chunkSize> noise;
+
+    for (int start = 0; start < count; start += chunkSize) {
+        const int chunk = std::min(chunkSize, count - start);
+
+        {
+            profiler::scoped_timer timer(profiler::StageNoise, chunk);
+            m_noise.process(noise.data(), chunk);
         }
 
-        // Kahan summation algorithm for the phase variable.
-        const double y = phaseDelta - c;
-        const double t = phase + y;
-        c = (t - phase) - y;
-        phase = t;
-
-        // modulo 2*pi
-        if (phase > 2 * M_PI) {
-            phase -= 2 * M_PI;
-            lastNoise = noise[index] / noiseAmplitude;
-            periods.emplace_back(periodStart, index);
-            periodStart = index + 1;
+        profiler::scoped_timer timer(profiler::StageSource, chunk);
+
+        for (int k = start; k < start + chunk; ++k, ++m_index) {
+            const int index = m_index;
+            const double time = index / double(m_sampleRate);
+
+            const double currentNoise = m_nextNoise;
+            m_nextNoise = noise[k - start] / m_noiseAmplitude;
+
+            const double f0 = m_pitch.evaluateAtTime(time);
+
+            const double jitterHz = f0 * m_jitterPercentage * m_lastNoise / 2;
+
+            const double flutter =
+                (sin(24.1 * M_PI * time) + sin(12.7 * M_PI * time) +
+                 sin(7.1 * M_PI * time) + sin(4.7 * M_PI * time)) /
+                4;
+
+            const double phaseDelta =
+                2 * M_PI *
+                (f0 * (1 + m_flutterAmplitude * flutter) + jitterHz) /
+                m_sampleRate;
+
+            m_amplitude.update(time);
+
+            double sample = m_source->evaluateAtPhase(m_phase) + m_blampCarry;
+            m_blampCarry = 0;
+
+            // Only add aspiration noise during the open phase.
+            if (m_phase / 2 * M_PI < m_periodOq) {
+                sample += m_aspirationPercentage * currentNoise;
+            }
+
+            const double amplitude = m_amplitude.evaluateAtTime(time);
+
+            sample *= amplitude;
+
+            // Kahan summation algorithm for the phase variable.
+            const double y = phaseDelta - m_phaseCompensation;
+            const double t = m_phase + y;
+            m_phaseCompensation = (t - m_phase) - y;
+
+            // Two-sample polyBLAMP residual for every corner of the waveform
+            // crossed during this step, split between this sample and the next.
+            for (const auto& [phase, jump] : m_discontinuities) {
+                const double cornerPhase = 2 * M_PI * phase;
+                if (m_phase < cornerPhase && cornerPhase <= t) {
+                    const double a = (cornerPhase - m_phase) / (t - m_phase);
+                    const double b = 1 - a;
+                    const double slopeJump = jump * (t - m_phase) / (2 * M_PI);
+
+                    sample += amplitude * slopeJump * b * b * b / 6;
+                    m_blampCarry += slopeJump * a * a * a / 6;
+                }
+            }
+
+            out[k] = sample;
+
+            m_phase = t;
+
+            // modulo 2*pi
+            if (m_phase > 2 * M_PI) {
+                m_phase -= 2 * M_PI;
+                m_lastNoise = currentNoise;
+                periods.emplace_back(m_periodStart, index);
+                m_periodStart = index + 1;
+
+                if (m_source->beginPeriod(m_periodStart /
+                                          double(m_sampleRate))) {
+                    m_periodOq = m_source->openQuotient();
+                    if (m_isBandLimited) {
+                        m_discontinuities = m_source->slopeDiscontinuities();
+                    }
+                }
+            }
         }
     }
 
-    // Remove the last partial period.
-    output.resize(periodStart);
+    return count;
+}
+
+source_generator::checkpoint source_generator::save() const {
+    return {m_index,
+            m_periodStart,
+            m_Oq,
+            m_periodOq,
+            m_phase,
+            m_phaseCompensation,
+            m_lastNoise,
+            m_nextNoise,
+            m_blampCarry,
+            m_discontinuities,
+            m_antialiasState,
+            m_antialiasStateF,
+            m_noise,
+            m_source->saveState(),
+            m_index / double(m_sampleRate)};
+}
 
-    auto antialiasedOutput = output;
-    filter::sosfilt(m_antialiasFilter, output, antialiasedOutput, 0,
-                    output.size() - 1, aafiltz);
-    return antialiasedOutput;
+void source_generator::restore(const checkpoint& cp) {
+    // The plans may have changed since the checkpoint was saved.
+    m_samples = totalSamples();
+
+    m_index = cp.index;
+    m_periodStart = cp.periodStart;
+    m_Oq = cp.Oq;
+    m_periodOq = cp.periodOq;
+    m_phase = cp.phase;
+    m_phaseCompensation = cp.phaseCompensation;
+    m_lastNoise = cp.lastNoise;
+    m_nextNoise = cp.nextNoise;
+    m_blampCarry = cp.blampCarry;
+    m_discontinuities = cp.discontinuities;
+    m_antialiasState = cp.antialiasState;
+    m_antialiasStateF = cp.antialiasStateF;
+    m_noise = cp.noise;
+    m_source->restoreState(cp.sourceState);
 }
+
+double source_generator::openQuotient() const { return m_Oq; }
+
+int source_generator::totalSamples() const {
+    return std::ceil(m_pitch.maxTime() * m_sampleRate);
+}
+
+int source_generator::sampleRate() const { return m_sampleRate; }
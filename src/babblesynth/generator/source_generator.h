@@ -20,6 +20,7 @@
 #define BABBLESYNTH_SOURCE_GENERATOR_H
 
 #include "../source/abstract_source.h"
+#include "noise.h"
 
 namespace babblesynth {
 namespace generator {
@@ -32,11 +33,62 @@ class source_generator : public parameter_holder {
     std::vector<double> generate(std::vector<std::pair<int, int>>& periods,
                                  double* Oq);
 
+    // Streaming interface: begin() resets the generator state to t = 0, then
+    // each call to process() renders the next `frames` samples into `out` and
+    // appends the pitch periods completed during that block to `periods`.
+    // Returns the number of samples rendered, which is less than `frames` once
+    // the end of the pitch plan is reached.
+    void begin();
+    int process(double* out, int frames,
+                std::vector<std::pair<int, int>>& periods);
+    int process(float* out, int frames,
+                std::vector<std::pair<int, int>>& periods);
+
+    // Everything process() carries over from one block to the next.
+    struct checkpoint {
+        int index;
+        int periodStart;
+        double Oq;
+        double periodOq;
+        double phase;
+        double phaseCompensation;
+        double lastNoise;
+        double nextNoise;
+        double blampCarry;
+        std::vector<source::abstract_source::slope_discontinuity>
+            discontinuities;
+        std::vector<std::array<double, 2>> antialiasState;
+        std::vector<std::array<float, 2>> antialiasStateF;
+        noise::colored_stream noise;
+        std::vector<double> sourceState;
+
+        // The plans were only read up to this time, in seconds.
+        double time;
+    };
+
+    // Resuming from a checkpoint with plans which agree with the ones it was
+    // saved with up to its time() renders the same samples as before, even
+    // when the plans differ after that.
+    checkpoint save() const;
+    void restore(const checkpoint& cp);
+
+    // Open quotient of the source at the time begin() was called.
+    double openQuotient() const;
+
+    // Total number of samples rendered by process() for the current plans.
+    int totalSamples() const;
+
+    int sampleRate() const;
+
     source::abstract_source* getSource();
 
    private:
     bool onParameterChange(const parameter& param) override;
 
+    template <typename T>
+    int processBlock(T* out, int frames,
+                     std::vector<std::pair<int, int>>& periods);
+
     std::unique_ptr<source::abstract_source> m_source;
 
     variable m_pitch;
@@ -45,9 +97,36 @@ class source_generator : public parameter_holder {
     double m_aspirationPercentage;
     double m_flutterAmplitude;
 
+    // When set, the corners of the glottal pulse are band-limited with
+    // polyBLAMP corrections instead of low-pass filtering the output. The
+    // aspiration noise is then mixed in unfiltered. Off by default.
+    bool m_isBandLimited;
+    std::vector<source::abstract_source::slope_discontinuity>
+        m_discontinuities;
+
+    // Seed of the noise stream for each render, 0 picks a random one.
+    int m_noiseSeed;
+    noise::colored_stream m_noise;
+    double m_noiseAmplitude;  // about the peak of one second of noise
+
     int m_sampleRate;
 
     std::vector<std::array<double, 6>> m_antialiasFilter;
+    std::vector<std::array<float, 6>> m_antialiasFilterF;
+
+    // Streaming state.
+    int m_samples;
+    int m_index;
+    int m_periodStart;
+    double m_Oq;
+    double m_periodOq;  // differs from m_Oq with voice quality plans
+    double m_phase;
+    double m_phaseCompensation;
+    double m_lastNoise;
+    double m_nextNoise;
+    double m_blampCarry;
+    std::vector<std::array<double, 2>> m_antialiasState;
+    std::vector<std::array<float, 2>> m_antialiasStateF;
 };
 
 }  // namespace generator
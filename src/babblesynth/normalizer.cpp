@@ -0,0 +1,169 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "normalizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.h"
+
+using namespace babblesynth;
+
+namespace {
+
+// The peak of each chunk is compared with the largest amplitude over the
+// chunk and this long before it, as the formants keep ringing for a while
+// after the amplitude drops.
+constexpr double ringTime = 0.05;
+
+// Chunks where the amplitude is below this fraction of its largest value
+// don't say much about the final peak.
+constexpr double amplitudeFloor = 0.01;
+
+constexpr int chunkSize = 256;
+
+}  // namespace
+
+template <typename T>
+basic_stream_normalizer<T>::basic_stream_normalizer(const int sampleRate,
+                                                    const int lookahead)
+    : m_sampleRate(sampleRate),
+      m_lookahead(lookahead),
+      m_maxAmplitude(1),
+      m_position(0),
+      m_finished(true),
+      m_peak(0),
+      m_ratio(0),
+      m_gain(1),
+      m_targetGain(1),
+      m_gainStep(0),
+      m_started(false) {}
+
+template <typename T>
+void basic_stream_normalizer<T>::begin(const variable_plan& amplitude) {
+    m_amplitude = amplitude;
+    m_maxAmplitude = amplitude.maxValueBetween(0, amplitude.duration());
+
+    m_buffer.clear();
+    m_position = 0;
+    m_finished = false;
+
+    // Not zero, so that silence keeps a finite gain.
+    m_peak = 1e-10;
+    m_ratio = 0;
+
+    m_gain = 1 / m_peak;
+    m_targetGain = m_gain;
+    m_gainStep = 0;
+    m_started = false;
+}
+
+template <typename T>
+void basic_stream_normalizer<T>::write(const T* in, const int count) {
+    profiler::scoped_timer timer(profiler::StageNormalization, count);
+
+    for (int start = 0; start < count; start += chunkSize) {
+        analyze(in + start, std::min(chunkSize, count - start));
+    }
+
+    m_buffer.insert(m_buffer.end(), in, in + count);
+}
+
+template <typename T>
+void basic_stream_normalizer<T>::analyze(const T* in, const int count) {
+    T peak = 0;
+    for (int i = 0; i < count; ++i) {
+        peak = std::max(peak, std::abs(in[i]));
+    }
+
+    const double start = m_position / double(m_sampleRate);
+    const double end = (m_position + count) / double(m_sampleRate);
+    const double amplitude =
+        std::max(m_amplitude.maxValueBetween(start - ringTime, end),
+                 amplitudeFloor * m_maxAmplitude);
+
+    m_position += count;
+
+    m_peak = std::max(m_peak, peak);
+    m_ratio = std::max(m_ratio, T(peak / amplitude));
+
+    const T targetGain =
+        1 / std::max(m_peak, T(m_ratio * m_maxAmplitude));
+
+    if (targetGain < m_targetGain) {
+        // Once reading has started, every sample of this chunk has at least
+        // m_lookahead samples before it in the buffer, so the ramp is over by
+        // the time it is read. It never slows down, not to miss the end of a
+        // ramp which is already going.
+        m_targetGain = targetGain;
+        m_gainStep =
+            std::max(m_gainStep, (m_gain - m_targetGain) / m_lookahead);
+    }
+}
+
+template <typename T>
+void basic_stream_normalizer<T>::finish() {
+    m_finished = true;
+}
+
+template <typename T>
+bool basic_stream_normalizer<T>::finished() const {
+    return m_finished && m_buffer.empty();
+}
+
+template <typename T>
+int basic_stream_normalizer<T>::available() const {
+    if (m_finished) {
+        return m_buffer.size();
+    }
+    return std::max<int>(0, m_buffer.size() - m_lookahead);
+}
+
+template <typename T>
+int basic_stream_normalizer<T>::read(T* out, const int frames) {
+    const int count = std::min(frames, available());
+    if (count == 0) {
+        return 0;
+    }
+
+    if (!m_started) {
+        // The whole look-ahead was seen before the first sample is read.
+        m_gain = m_targetGain;
+        m_gainStep = 0;
+        m_started = true;
+    }
+
+    profiler::scoped_timer timer(profiler::StageNormalization, count);
+
+    for (int i = 0; i < count; ++i) {
+        m_gain = std::max(m_targetGain, m_gain - m_gainStep);
+        out[i] = m_buffer[i] * m_gain;
+    }
+
+    if (m_gain == m_targetGain) {
+        m_gainStep = 0;
+    }
+
+    m_buffer.erase(m_buffer.begin(), m_buffer.begin() + count);
+    return count;
+}
+
+template class babblesynth::basic_stream_normalizer<float>;
+template class babblesynth::basic_stream_normalizer<double>;
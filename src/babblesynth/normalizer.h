@@ -0,0 +1,90 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BABBLESYNTH_NORMALIZER_H
+#define BABBLESYNTH_NORMALIZER_H
+
+#include <vector>
+
+#include "variable_plan.h"
+
+namespace babblesynth {
+
+// Scales a stream of samples to a peak of about 1 in a single pass, without
+// rendering the utterance beforehand to find its peak.
+//
+// Samples are held back by a look-ahead of a few blocks. The gain never
+// increases, and it has ramped down to what a sample needs by the time that
+// sample is read, so the output never exceeds 1. So that a quiet start isn't
+// turned up to full scale, the gain follows an estimate of the final peak:
+// the loudest output so far relative to the amplitude plan at that time,
+// times the largest value of the plan.
+template <typename T>
+class basic_stream_normalizer {
+   public:
+    explicit basic_stream_normalizer(int sampleRate, int lookahead = 4096);
+
+    // Starts a new stream, for an utterance rendered with that amplitude
+    // plan.
+    void begin(const variable_plan& amplitude);
+
+    // Appends the next `count` samples of the stream.
+    void write(const T* in, int count);
+
+    // Marks the end of the stream, after which every sample can be read.
+    void finish();
+    bool finished() const;
+
+    // Number of samples read() can return before more are written.
+    int available() const;
+
+    // Reads up to `frames` scaled samples and returns how many were read.
+    int read(T* out, int frames);
+
+   private:
+    void analyze(const T* in, int count);
+
+    int m_sampleRate;
+    int m_lookahead;
+
+    variable_plan m_amplitude;
+    double m_maxAmplitude;
+
+    // Samples which were written but not read yet.
+    std::vector<T> m_buffer;
+    int m_position;  // number of samples written
+    bool m_finished;
+
+    T m_peak;   // of every sample written
+    T m_ratio;  // largest peak relative to the amplitude plan
+
+    T m_gain;
+    T m_targetGain;
+    T m_gainStep;
+    bool m_started;
+};
+
+extern template class basic_stream_normalizer<float>;
+extern template class basic_stream_normalizer<double>;
+
+using stream_normalizer = basic_stream_normalizer<double>;
+
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_NORMALIZER_H
@@ -19,6 +19,7 @@
 #ifndef BABBLESYNTH_PARAMETER_H
 #define BABBLESYNTH_PARAMETER_H
 
+#include <cmath>
 #include <functional>
 #include <optional>
 #include <string>
@@ -110,6 +111,42 @@ class parameter {
         return *this;
     }
 
+    // Adds the name and value of the parameter to `h`.
+    void addToHash(util::hasher& h) const {
+        h.add(m_name).add(m_value.index());
+        if (const auto* plan = std::get_if<variable_plan>(&m_value)) {
+            plan->addToHash(h);
+        } else if (const auto* e = std::get_if<enumeration_value>(&m_value)) {
+            h.add(e->index());
+        } else if (const auto* str = std::get_if<std::string>(&m_value)) {
+            h.add(*str);
+        } else if (const auto* i = std::get_if<int>(&m_value)) {
+            h.add(*i);
+        } else if (const auto* d = std::get_if<double>(&m_value)) {
+            h.add(*d);
+        } else if (const auto* b = std::get_if<bool>(&m_value)) {
+            h.add(*b);
+        }
+    }
+
+    // Latest time up to which this parameter gives the same output as when
+    // it held `earlier`. Plans are compared with variable_plan::agreesUntil(),
+    // any other change makes the outputs differ from the start.
+    double agreesUntil(const value_type& earlier) const {
+        const auto* plan = std::get_if<variable_plan>(&m_value);
+        const auto* earlierPlan = std::get_if<variable_plan>(&earlier);
+        if (plan != nullptr && earlierPlan != nullptr) {
+            return plan->agreesUntil(*earlierPlan);
+        }
+
+        util::hasher h, earlierH;
+        addToHash(h);
+        parameter(m_name, earlier).addToHash(earlierH);
+        return h.value() == earlierH.value() ? INFINITY : -INFINITY;
+    }
+
+    const value_type& rawValue() const { return m_value; }
+
     template <typename T>
     void addObserver(T observer) {
         m_observers.emplace_back(observer);
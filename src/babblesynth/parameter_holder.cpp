@@ -18,6 +18,8 @@
 
 #include "parameter_holder.h"
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <stdexcept>
 
@@ -59,6 +61,34 @@ const parameter& parameter_holder::getParameter(const std::string& name) const {
     throw std::invalid_argument("No parameter found with that name");
 }
 
+void parameter_holder::addToHash(util::hasher& h) const {
+    for (const auto& parameter : m_parameters) {
+        parameter.addToHash(h);
+    }
+}
+
+parameter_holder::snapshot parameter_holder::takeSnapshot() const {
+    snapshot values;
+    values.reserve(m_parameters.size());
+
+    for (const auto& parameter : m_parameters) {
+        values.push_back(parameter.rawValue());
+    }
+    return values;
+}
+
+double parameter_holder::agreesUntil(const snapshot& earlier) const {
+    if (earlier.size() != m_parameters.size()) {
+        return -INFINITY;
+    }
+
+    double time = INFINITY;
+    for (int i = 0; i < m_parameters.size(); ++i) {
+        time = std::min(time, m_parameters[i].agreesUntil(earlier[i]));
+    }
+    return time;
+}
+
 parameter& parameter_holder::addParameter(const parameter& newParam) {
     // Expect 10 parameters at most.
     if (m_parameters.capacity() < maxNumberOfParameters) {
@@ -39,6 +39,18 @@ class parameter_holder {
     const parameter& getParameter(int index) const;
     const parameter& getParameter(const std::string& name) const;
 
+    // Adds every parameter to `h`, for detecting identical configurations.
+    void addToHash(util::hasher& h) const;
+
+    // Values of every parameter, to find out later on how far the output
+    // stays the same after some of them were changed.
+    using snapshot = std::vector<parameter::value_type>;
+    snapshot takeSnapshot() const;
+
+    // Latest time up to which the output agrees with the one for the
+    // parameters in `earlier`, see parameter::agreesUntil().
+    double agreesUntil(const snapshot& earlier) const;
+
    protected:
     virtual ~parameter_holder() = default;
 
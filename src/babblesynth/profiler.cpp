@@ -0,0 +1,125 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "profiler.h"
+
+#include <iomanip>
+
+using namespace babblesynth;
+
+namespace {
+
+// One cache line per stage, so that threads in different stages don't
+// contend for the same line.
+struct alignas(64) counter_set {
+    std::atomic<std::uint64_t> nanoseconds{0};
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> samples{0};
+};
+
+counter_set counterSets[profiler::numStages];
+
+}  // namespace
+
+std::atomic<bool> profiler::detail::enabled(false);
+
+void profiler::detail::record(const stage s,
+                              const std::chrono::steady_clock::duration elapsed,
+                              const std::int64_t samples) {
+    auto& set = counterSets[s];
+    set.nanoseconds.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+        std::memory_order_relaxed);
+    set.calls.fetch_add(1, std::memory_order_relaxed);
+    set.samples.fetch_add(samples, std::memory_order_relaxed);
+}
+
+const char* profiler::stageName(const stage s) {
+    switch (s) {
+        case StageNoise:
+            return "noise";
+        case StageSource:
+            return "source";
+        case StageAntialias:
+            return "antialias filter";
+        case StageFilterDesign:
+            return "filter design";
+        case StageSosfilt:
+            return "sosfilt";
+        case StageIntegrator:
+            return "integrator";
+        case StageNormalization:
+            return "normalization";
+    }
+    return "";
+}
+
+void profiler::setEnabled(const bool enabled) {
+    detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool profiler::isEnabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+void profiler::reset() {
+    for (auto& set : counterSets) {
+        set.nanoseconds.store(0, std::memory_order_relaxed);
+        set.calls.store(0, std::memory_order_relaxed);
+        set.samples.store(0, std::memory_order_relaxed);
+    }
+}
+
+profiler::stage_counters profiler::counters(const stage s) {
+    const auto& set = counterSets[s];
+    return {set.nanoseconds.load(std::memory_order_relaxed) * 1e-9,
+            set.calls.load(std::memory_order_relaxed),
+            set.samples.load(std::memory_order_relaxed)};
+}
+
+void profiler::print(std::ostream& out) {
+    stage_counters all[numStages];
+    double total = 0;
+    for (int s = 0; s < numStages; ++s) {
+        all[s] = counters(stage(s));
+        total += all[s].seconds;
+    }
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+
+    out << std::left << std::setw(18) << "stage" << std::right
+        << std::setw(12) << "time (ms)" << std::setw(8) << "share"
+        << std::setw(12) << "calls" << std::setw(14) << "samples"
+        << std::setw(12) << "ns/sample" << "\n";
+
+    out << std::fixed;
+    for (int s = 0; s < numStages; ++s) {
+        const auto& c = all[s];
+        out << std::left << std::setw(18) << stageName(stage(s)) << std::right
+            << std::setprecision(2) << std::setw(12) << c.seconds * 1e3
+            << std::setprecision(1) << std::setw(7)
+            << (total > 0 ? 100 * c.seconds / total : 0) << "%"
+            << std::setw(12) << c.calls << std::setw(14) << c.samples
+            << std::setprecision(2) << std::setw(12)
+            << (c.samples > 0 ? c.seconds * 1e9 / c.samples : 0) << "\n";
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,109 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BABBLESYNTH_PROFILER_H
+#define BABBLESYNTH_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace babblesynth {
+namespace profiler {
+
+// Opt-in timing of the stages of a render.
+//
+// Scoped timers around each stage add their wall time, one call and the
+// number of samples they went through to counters which are shared by every
+// thread, so concurrent renders add up. Profiling is off by default: a timer
+// then costs a single relaxed atomic load and never reads the clock.
+
+enum stage {
+    StageNoise,          // aspiration and jitter noise
+    StageSource,         // glottal waveform, e.g. LF, with its corrections
+    StageAntialias,      // low-pass filter of the source if not band-limited
+    StageFilterDesign,   // formant plans and second-order sections
+    StageSosfilt,        // formant filter cascade
+    StageIntegrator,     // leaky integrator after the cascade
+    StageNormalization,  // peak search and scaling of the output
+};
+
+constexpr int numStages = StageNormalization + 1;
+
+const char* stageName(stage s);
+
+void setEnabled(bool enabled);
+bool isEnabled();
+
+// Sets every counter back to 0.
+void reset();
+
+struct stage_counters {
+    double seconds;
+    std::uint64_t calls;
+    std::uint64_t samples;
+};
+
+stage_counters counters(stage s);
+
+// Table of the counters of every stage, with their share of the total time.
+void print(std::ostream& out);
+
+namespace detail {
+extern std::atomic<bool> enabled;
+void record(stage s, std::chrono::steady_clock::duration elapsed,
+            std::int64_t samples);
+}  // namespace detail
+
+class scoped_timer {
+   public:
+    explicit scoped_timer(stage s, std::int64_t samples = 0)
+        : m_stage(s),
+          m_samples(samples),
+          m_active(detail::enabled.load(std::memory_order_relaxed)) {
+        if (m_active) {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~scoped_timer() {
+        if (m_active) {
+            detail::record(m_stage, std::chrono::steady_clock::now() - m_start,
+                           m_samples);
+        }
+    }
+
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+
+    // For the stages which only know how many samples they went through
+    // once they are done.
+    void setSamples(std::int64_t samples) { m_samples = samples; }
+
+   private:
+    stage m_stage;
+    std::int64_t m_samples;
+    bool m_active;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+}  // namespace profiler
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_PROFILER_H
@@ -0,0 +1,163 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "renderer.h"
+
+#include <algorithm>
+
+using namespace babblesynth;
+
+template <typename T>
+basic_renderer<T>::basic_renderer(generator::source_generator& source,
+                                  filter::formant_filter& filter,
+                                  int blockSize)
+    : m_source(source),
+      m_filter(filter),
+      m_blockSize(blockSize),
+      m_pendingStart(0),
+      m_readyPosition(0),
+      m_sourceFinished(true),
+      m_checkpointInterval(0),
+      m_nextCheckpoint(0) {}
+
+template <typename T>
+void basic_renderer<T>::begin() {
+    m_source.begin();
+    m_filter.begin(m_source.openQuotient());
+
+    m_pending.clear();
+    m_pendingStart = 0;
+
+    m_ready.clear();
+    m_readyPosition = 0;
+
+    m_sourceFinished = false;
+
+    m_checkpoints.clear();
+    m_nextCheckpoint = m_checkpointInterval;
+}
+
+template <typename T>
+void basic_renderer<T>::setCheckpointInterval(const int samples) {
+    m_checkpointInterval = samples;
+}
+
+template <typename T>
+auto basic_renderer<T>::checkpoints() const
+    -> const std::vector<checkpoint>& {
+    return m_checkpoints;
+}
+
+template <typename T>
+void basic_renderer<T>::resume(const checkpoint& cp) {
+    m_source.restore(cp.source);
+    m_filter.restore(cp.filter);
+
+    m_pending = cp.pending;
+    m_pendingStart = cp.position;
+
+    m_ready.clear();
+    m_readyPosition = 0;
+
+    m_sourceFinished = false;
+
+    m_checkpoints.clear();
+    m_nextCheckpoint = cp.position + m_checkpointInterval;
+}
+
+template <typename T>
+void basic_renderer<T>::saveCheckpoint() {
+    m_checkpoints.push_back(
+        {m_source.save(), m_filter.save(), m_pending, m_pendingStart});
+}
+
+template <typename T>
+int basic_renderer<T>::process(T* out, const int frames) {
+    int written = 0;
+
+    while (written < frames) {
+        if (m_readyPosition < m_ready.size()) {
+            const int count = std::min<int>(frames - written,
+                                            m_ready.size() - m_readyPosition);
+            std::copy_n(m_ready.begin() + m_readyPosition, count,
+                        out + written);
+            m_readyPosition += count;
+            written += count;
+        } else if (!renderBlock()) {
+            break;
+        }
+    }
+
+    return written;
+}
+
+template <typename T>
+bool basic_renderer<T>::finished() const {
+    return m_sourceFinished && m_readyPosition >= m_ready.size();
+}
+
+template <typename T>
+bool basic_renderer<T>::renderBlock() {
+    if (m_sourceFinished) {
+        return false;
+    }
+
+    m_ready.clear();
+    m_readyPosition = 0;
+
+    const int offset = m_pending.size();
+    m_pending.resize(offset + m_blockSize);
+
+    m_periods.clear();
+    const int count =
+        m_source.process(m_pending.data() + offset, m_blockSize, m_periods);
+    m_pending.resize(offset + count);
+
+    if (count < m_blockSize) {
+        // The trailing partial period is dropped, like in generate().
+        m_sourceFinished = true;
+    }
+
+    if (!m_periods.empty()) {
+        for (const auto& [startIndex, endIndex] : m_periods) {
+            m_filter.addPeriod(startIndex, endIndex);
+        }
+
+        const int filterCount = m_periods.back().second + 1 - m_pendingStart;
+
+        m_ready.resize(filterCount);
+        m_filter.process(m_pending.data(), m_ready.data(), filterCount);
+
+        m_pending.erase(m_pending.begin(), m_pending.begin() + filterCount);
+        m_pendingStart += filterCount;
+    }
+
+    // The last block is usually cut short, checkpoints are only useful for
+    // resuming before it anyway.
+    if (m_checkpointInterval > 0 && !m_sourceFinished &&
+        m_pendingStart >= m_nextCheckpoint) {
+        saveCheckpoint();
+        m_nextCheckpoint = m_pendingStart + m_checkpointInterval;
+    }
+
+    return true;
+}
+
+template class babblesynth::basic_renderer<float>;
+template class babblesynth::basic_renderer<double>;
@@ -0,0 +1,112 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BABBLESYNTH_RENDERER_H
+#define BABBLESYNTH_RENDERER_H
+
+#include <utility>
+#include <vector>
+
+#include "filter/formant_filter.h"
+#include "generator/source_generator.h"
+
+namespace babblesynth {
+
+// Streams the output of a source generator through a formant filter in
+// fixed-size blocks of float or double samples.
+//
+// The formant filter needs the boundaries of a whole pitch period before it
+// can filter it, so the output lags the source by at most one period plus one
+// block. Memory use is bounded by that same amount regardless of the
+// utterance length.
+//
+// Single precision halves the memory of the buffers and doubles the width of
+// the vectorized loops. The glottal waveform and the filter designs are
+// still computed in double precision, only the samples are rounded.
+template <typename T>
+class basic_renderer {
+   public:
+    basic_renderer(generator::source_generator& source,
+                   filter::formant_filter& filter, int blockSize = 256);
+
+    // Resets both stages to t = 0 with their current plans and parameters.
+    // The output is not normalized, see stream_normalizer.
+    void begin();
+
+    // Writes up to `frames` samples into `out` and returns how many were
+    // written. A return value less than `frames` means the end of the
+    // utterance was reached.
+    int process(T* out, int frames);
+
+    bool finished() const;
+
+    // Snapshot of both stages between two blocks, after the last complete
+    // pitch period. Rendering can resume from it once the plans were edited,
+    // as long as they still agree with the old ones up to time().
+    struct checkpoint {
+        generator::source_generator::checkpoint source;
+        filter::formant_filter::checkpoint filter;
+        std::vector<T> pending;
+        int position;  // number of samples output before the checkpoint
+
+        double time() const { return source.time; }
+    };
+
+    // While rendering, a checkpoint is saved every `samples` output samples,
+    // or never if 0 (the default). begin() and resume() clear the list.
+    void setCheckpointInterval(int samples);
+    const std::vector<checkpoint>& checkpoints() const;
+
+    // Continues rendering from `cp` with the current plans. The output
+    // starts at sample cp.position.
+    void resume(const checkpoint& cp);
+
+   private:
+    bool renderBlock();
+    void saveCheckpoint();
+
+    generator::source_generator& m_source;
+    filter::formant_filter& m_filter;
+    int m_blockSize;
+
+    // Source samples which haven't been filtered yet, starting at the
+    // absolute sample index m_pendingStart.
+    std::vector<T> m_pending;
+    int m_pendingStart;
+
+    // Filtered samples which haven't been returned yet.
+    std::vector<T> m_ready;
+    int m_readyPosition;
+
+    std::vector<std::pair<int, int>> m_periods;
+    bool m_sourceFinished;
+
+    int m_checkpointInterval;
+    int m_nextCheckpoint;
+    std::vector<checkpoint> m_checkpoints;
+};
+
+extern template class basic_renderer<float>;
+extern template class basic_renderer<double>;
+
+using renderer = basic_renderer<double>;
+
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_RENDERER_H
\ No newline at end of file
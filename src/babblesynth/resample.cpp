@@ -20,25 +20,118 @@
 
 #include <samplerate.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace babblesynth;
+
+static int converterType(resampler::quality q) {
+    switch (q) {
+        case resampler::QualityBest:
+            return SRC_SINC_BEST_QUALITY;
+        case resampler::QualityMedium:
+            return SRC_SINC_MEDIUM_QUALITY;
+        case resampler::QualityFastest:
+            return SRC_SINC_FASTEST;
+        case resampler::QualityLinear:
+            return SRC_LINEAR;
+    }
+    throw std::invalid_argument("invalid resampler quality");
+}
+
+resampler::resampler(const double fsIn, const double fsOut, const quality q)
+    : m_ratio(fsOut / fsIn) {
+    if (!(m_ratio > 0)) {
+        throw std::invalid_argument("invalid sample rates");
+    }
+
+    int error;
+    m_state = src_new(converterType(q), 1, &error);
+    if (m_state == nullptr) {
+        throw std::runtime_error(std::string("src_new: ") +
+                                 src_strerror(error));
+    }
+}
+
+resampler::~resampler() { src_delete(m_state); }
+
+void resampler::reset() { src_reset(m_state); }
+
+void resampler::process(const float* in, const int frames,
+                        std::vector<float>& out, const bool endOfInput) {
+    SRC_DATA data;
+    memset(&data, 0, sizeof(data));
+    data.data_in = in;
+    data.input_frames = frames;
+    data.end_of_input = endOfInput;
+    data.src_ratio = m_ratio;
+
+    // A little more than the expected output, so that one call is usually
+    // enough.
+    const int room = std::ceil(frames * m_ratio) + 64;
+
+    while (true) {
+        const int offset = out.size();
+        out.resize(offset + room);
+
+        data.data_out = out.data() + offset;
+        data.output_frames = room;
+
+        const int error = src_process(m_state, &data);
+        if (error != 0) {
+            throw std::runtime_error(std::string("src_process: ") +
+                                     src_strerror(error));
+        }
+
+        out.resize(offset + data.output_frames_gen);
+
+        data.data_in += data.input_frames_used;
+        data.input_frames -= data.input_frames_used;
+
+        // When flushing, keep going until the converter runs dry.
+        if (data.input_frames == 0 &&
+            (!endOfInput || data.output_frames_gen == 0)) {
+            break;
+        }
+    }
+}
+
+void resampler::process(const double* in, const int frames,
+                        std::vector<double>& out, const bool endOfInput) {
+    m_input.assign(in, in + frames);
+    m_output.clear();
+
+    process(m_input.data(), frames, m_output, endOfInput);
+
+    out.insert(out.end(), m_output.begin(), m_output.end());
+}
+
+double resampler::ratio() const { return m_ratio; }
+
 std::vector<double> babblesynth::resample(const std::vector<double>& inDbl,
                                           const double fsIn,
                                           const double fsOut) {
-    std::vector<float> in(inDbl.begin(), inDbl.end());
+    const std::vector<float> out =
+        resample(std::vector<float>(inDbl.begin(), inDbl.end()), fsIn, fsOut);
+
+    return std::vector<double>(out.begin(), out.end());
+}
 
+std::vector<float> babblesynth::resample(const std::vector<float>& in,
+                                         const double fsIn,
+                                         const double fsOut) {
     const int outExpectedLen = (int)((double)in.size() * fsOut / fsIn + 0.5);
-    std::vector<float> out(outExpectedLen);
 
-    SRC_DATA data;
-    memset(&data, 0, sizeof(data));
-    data.data_in = in.data();
-    data.data_out = out.data();
-    data.input_frames = in.size();
-    data.output_frames = out.size();
-    data.src_ratio = fsOut / fsIn;
+    std::vector<float> out;
+    out.reserve(outExpectedLen + 64);
 
-    src_simple(&data, SRC_SINC_BEST_QUALITY, 1);
+    resampler converter(fsIn, fsOut);
+    converter.process(in.data(), in.size(), out, true);
 
-    out.resize(data.output_frames_gen);
+    out.resize(std::min<int>(out.size(), outExpectedLen));
 
-    return std::vector<double>(out.begin(), out.end());
-}
\ No newline at end of file
+    return out;
+}
@@ -21,11 +21,59 @@
 
 #include <vector>
 
+typedef struct SRC_STATE_tag SRC_STATE;
+
 namespace babblesynth {
 
+// Sample rate converter which keeps its state between calls, so that a
+// signal can be converted one block at a time. The GUI renders and writes at
+// the audio device's own rate, so only the phoneme editor's analysis needs it.
+class resampler {
+   public:
+    enum quality {
+        QualityBest,
+        QualityMedium,
+        QualityFastest,
+        QualityLinear,
+    };
+
+    resampler(double fsIn, double fsOut, quality q = QualityBest);
+    ~resampler();
+
+    resampler(const resampler&) = delete;
+    resampler& operator=(const resampler&) = delete;
+
+    // Forgets the previous input, for converting an unrelated signal.
+    void reset();
+
+    // Converts the next `frames` input samples and appends the output to
+    // `out`. Set `endOfInput` on the last block to flush the samples still
+    // held back by the filter. Passing the same vector with its size cleared
+    // avoids allocating once it is large enough.
+    void process(const float* in, int frames, std::vector<float>& out,
+                 bool endOfInput = false);
+    void process(const double* in, int frames, std::vector<double>& out,
+                 bool endOfInput = false);
+
+    double ratio() const;
+
+   private:
+    SRC_STATE* m_state;
+    double m_ratio;
+
+    // Conversion buffers for the double precision overload.
+    std::vector<float> m_input;
+    std::vector<float> m_output;
+};
+
+// Converts a whole signal at once, with the best quality.
 std::vector<double> resample(const std::vector<double>& input, double fsIn,
                              double fsOut);
 
+// libsamplerate works in single precision, so this one avoids both copies.
+std::vector<float> resample(const std::vector<float>& input, double fsIn,
+                            double fsOut);
+
 }  // namespace babblesynth
 
 #endif  // BABBLESYNTH_RESAMPLE_H
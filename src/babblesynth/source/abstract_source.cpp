@@ -24,3 +24,18 @@ babblesynth::enumeration babblesynth::source::sources =
     babblesynth::enumeration("LF");
 
 abstract_source::abstract_source() : parameter_holder() {}
+
+std::vector<abstract_source::slope_discontinuity>
+abstract_source::slopeDiscontinuities() const {
+    return {};
+}
+
+bool abstract_source::beginPeriod(double time) { return false; }
+
+double abstract_source::openQuotient() const {
+    return getParameter("Oq").value<double>();
+}
+
+std::vector<double> abstract_source::saveState() const { return {}; }
+
+void abstract_source::restoreState(const std::vector<double>& state) {}
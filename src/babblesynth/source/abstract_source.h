@@ -20,6 +20,7 @@
 #define BABBLESYNTH_ABSTRACT_SOURCE_H
 
 #include <cmath>
+#include <vector>
 
 #include "../enumeration.h"
 #include "../parameter_holder.h"
@@ -34,6 +35,31 @@ class abstract_source : public parameter_holder {
 
     virtual double evaluateAtPhase(double theta) = 0;
 
+    // A point where the waveform is continuous but its derivative jumps.
+    // `phase` is in [0, 1], in fractions of a period, and `jump` is the
+    // derivative just after minus the derivative just before, per period.
+    struct slope_discontinuity {
+        double phase;
+        double jump;
+    };
+
+    // Used to band-limit the corners of the waveform. Sources without any
+    // return an empty list.
+    virtual std::vector<slope_discontinuity> slopeDiscontinuities() const;
+
+    // Called by the generator at the start of every glottal cycle, with the
+    // time of that cycle in seconds. Returns whether the shape of the
+    // waveform changed. The default does nothing.
+    virtual bool beginPeriod(double time);
+
+    // Open quotient of the current cycle, in fractions of a period.
+    virtual double openQuotient() const;
+
+    // Whatever state the source carries over from one cycle to the next, for
+    // the generator to resume from a checkpoint. The default has none.
+    virtual std::vector<double> saveState() const;
+    virtual void restoreState(const std::vector<double>& state);
+
    protected:
     abstract_source();
 };
@@ -18,6 +18,9 @@
 
 #include "lf.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 #include "../fzero.h"
 
 using namespace babblesynth::source;
@@ -37,16 +40,137 @@ static double oldfzero(const Func& f, const Func2& df, double x0,
     return x0;
 }
 
-lf::lf() : abstract_source(), Oq(0.6), am(0.7), Qa(0.1) {
+lf::lf()
+    : abstract_source(),
+      Oq(0.6),
+      am(0.7),
+      Qa(0.1),
+      m_isSolved(false),
+      m_usePlans(false),
+      m_useWavetable(false) {
     addParameter("Oq", 0.6);
     addParameter("am", 0.7).setMin(0.5).setMax(1);
     addParameter("Qa", 0.1);
+    addParameter("Wavetable", false);
+    addParameter("Voice quality plans", false);
+    addParameter("Oq plan", variable_plan(false, 0.6));
+    addParameter("am plan", variable_plan(false, 0.7));
+    addParameter("Qa plan", variable_plan(false, 0.1));
     calculateModelParameters();
 }
 
 double lf::evaluateAtPhase(double theta) {
     const double t = theta / (2 * M_PI);
 
+    if (!usesWavetable()) {
+        return evaluateAnalytic(t);
+    }
+
+    const std::vector<double>* table;
+    double x;
+
+    if (t <= Te) {
+        table = &m_openTable;
+        x = t / Te;
+    } else {
+        table = &m_returnTable;
+        x = (t - Te) / (T0 - Te);
+    }
+
+    const int intervals = table->size() - 1;
+
+    x = std::clamp(x, 0.0, 1.0) * intervals;
+
+    const int i = std::min(int(x), intervals - 1);
+    const double frac = x - i;
+
+    return (*table)[i] + frac * ((*table)[i + 1] - (*table)[i]);
+}
+
+bool lf::beginPeriod(double time) {
+    if (!m_usePlans) {
+        return false;
+    }
+
+    const double newOq = m_OqPlan.evaluateAtTime(time);
+    const double newAm = std::clamp(m_amPlan.evaluateAtTime(time), 0.5, 1.0);
+    const double newQa = m_QaPlan.evaluateAtTime(time);
+
+    if (newOq == Oq && newAm == am && newQa == Qa) {
+        return false;
+    }
+
+    const double oldOq = Oq;
+    const double oldAm = am;
+    const double oldQa = Qa;
+
+    Oq = newOq;
+    am = newAm;
+    Qa = newQa;
+
+    // Keep the previous shape if the model can't be solved for this cycle.
+    if (!calculateModelParameters()) {
+        Oq = oldOq;
+        am = oldAm;
+        Qa = oldQa;
+        calculateModelParameters();
+        return false;
+    }
+
+    return true;
+}
+
+double lf::openQuotient() const { return Oq; }
+
+std::vector<double> lf::saveState() const {
+    return {Oq, am, Qa, alpha, epsilon, double(m_isSolved)};
+}
+
+void lf::restoreState(const std::vector<double>& state) {
+    if (state.size() != 6) {
+        throw std::invalid_argument("invalid state for LF source");
+    }
+
+    const bool isSameShape = state[0] == Oq && state[1] == am &&
+                             state[2] == Qa && state[3] == alpha &&
+                             state[4] == epsilon;
+
+    Oq = state[0];
+    am = state[1];
+    Qa = state[2];
+    alpha = state[3];
+    epsilon = state[4];
+    m_isSolved = state[5] != 0;
+
+    Ee = E;
+    Te = Oq * T0;
+    Tp = (am > 0.5 ? am : 0.5001) * Oq * T0;
+    Ta = Qa * (1 - Oq) * T0;
+
+    if (usesWavetable() && !isSameShape) {
+        buildWavetable();
+    }
+}
+
+std::vector<abstract_source::slope_discontinuity> lf::slopeDiscontinuities()
+    const {
+    const double wg = M_PI / Tp;
+
+    // Derivatives at both ends of the open phase...
+    const double openStart = -Ee * exp(-alpha * Te) * wg / sin(wg * Te);
+    const double openEnd = -Ee * (alpha + wg / tan(wg * Te));
+
+    // ...and of the return phase.
+    const double returnStart = Ee / Ta;
+    const double returnEnd = Ee / Ta * exp(-epsilon * (T0 - Te));
+
+    return {
+        {Te / T0, returnStart - openEnd},
+        {1.0, openStart - returnEnd},
+    };
+}
+
+double lf::evaluateAnalytic(double t) const {
     if (t <= Te) {
         return -Ee * exp(alpha * (t - Te)) * sin(M_PI * t / Tp) /
                sin(M_PI * Te / Tp);
@@ -62,24 +186,77 @@ bool lf::calculateModelParameters() {
     Tp = (am > 0.5 ? am : 0.5001) * Oq * T0;
     Ta = Qa * (1 - Oq) * T0;
 
-    // epsilon is expressed by an implicit equation
-    const auto fn_e = [=](double e) {
-        return 1.0 - exp(-e * (T0 - Te)) - e * Ta;
-    };
-    epsilon = fzero(1.0 / (Ta + 1e-9), fn_e, 1e-10);
+    epsilon = solveEpsilon();
 
     // If epsilon did not solve to anything revert the param change.
     if (std::isnan(epsilon)) return false;
 
-    // alpha is expressed by another implicit equation
+    alpha = solveAlpha();
+
+    // If alpha did not solve to anything revert the param change.
+    if (std::isnan(alpha)) return false;
+
+    m_isSolved = true;
+
+    if (usesWavetable()) {
+        buildWavetable();
+    }
+
+    return true;
+}
+
+double lf::solveEpsilon() const {
+    const double D = T0 - Te;
+
+    // With u = epsilon * (T0 - Te) the implicit equation only depends on Qa:
+    //   f(u) = 1 - exp(-u) - Qa * u = 0
+    // For 0 < Qa < 1, f is concave with a single positive root, and f(1 / Qa)
+    // is negative, so Newton's method converges monotonically from there.
+    if (Qa > 0 && Qa < 1) {
+        double u = 1 / Qa;
+        for (int iter = 0; iter < maxNewtonIterations; ++iter) {
+            const double step = (1 - exp(-u) - Qa * u) / (exp(-u) - Qa);
+            u -= step;
+            if (std::abs(step) <= newtonTolerance * u) {
+                return u / D;
+            }
+        }
+    }
+
+    const auto fn_e = [=](double e) {
+        return 1.0 - exp(-e * D) - e * Ta;
+    };
+    return fzero(1.0 / (Ta + 1e-9), fn_e, 1e-10);
+}
+
+double lf::solveAlpha() const {
     const double wg = M_PI / Tp;
+    const double A = wg / sin(wg * Te);
+    const double B = wg / tan(wg * Te);
+    const double C = (T0 - Te) / (exp(epsilon * (T0 - Te)) - 1) - 1 / epsilon;
 
     const auto fn_a = [=](double a) {
-        return 1.0 / (a * a + wg * wg) *
-                   (exp(-a * Te) * wg / sin(wg * Te) + a - wg / tan(wg * Te)) -
-               ((T0 - Te) / (exp(epsilon * (T0 - Te)) - 1) - 1 / epsilon);
+        return (exp(-a * Te) * A + a - B) / (a * a + wg * wg) - C;
     };
 
+    if (m_isSolved && std::isfinite(alpha)) {
+        double a = alpha;
+        for (int iter = 0; iter < maxNewtonIterations; ++iter) {
+            const double q = a * a + wg * wg;
+            const double n = exp(-a * Te) * A + a - B;
+            const double dn = 1 - Te * exp(-a * Te) * A;
+            const double step = (n / q - C) / ((dn * q - 2 * a * n) / (q * q));
+            a -= step;
+            if (!std::isfinite(a)) {
+                break;
+            }
+            if (std::abs(step) <=
+                newtonTolerance * std::max(1.0, std::abs(a))) {
+                return a;
+            }
+        }
+    }
+
     // Find the first interval with a zero crossing
     std::array ints{-1e20, -1e9, -1e8, -1e7, -1e6, -1e5, -1e4,
                     -1e3,  -1e2, -1e1, 0.0,  1e1,  1e2,  1e3,
@@ -87,16 +264,6 @@ bool lf::calculateModelParameters() {
     double fa, fb;
     double a, b;
 
-    for (int i = 0; i < ints.size() - 1; ++i) {
-        a = ints[i];
-        fa = fn_a(a);
-
-        b = ints[i + 1];
-        fb = fn_a(b);
-
-        if (sgn(fa) * sgn(fb) <= 0) break;
-    }
-
     b = ints[0];
     fb = fn_a(b);
     for (int i = 1; i < ints.size(); ++i) {
@@ -111,16 +278,72 @@ bool lf::calculateModelParameters() {
         }
     }
 
-    alpha = fzero(a, b, fn_a, 1e-10);
+    return fzero(a, b, fn_a, 1e-10);
+}
 
-    // If alpha did not solve to anything revert the param change.
-    if (std::isnan(alpha)) return false;
+bool lf::usesWavetable() const { return m_useWavetable && !m_usePlans; }
 
-    return true;
+void lf::buildWavetable() {
+    constexpr int minIntervals = 256;
+    constexpr int maxIntervals = 1 << 16;
+
+    const auto build = [this](std::vector<double>& table, double start,
+                              double end) {
+        for (int n = minIntervals; n <= maxIntervals; n *= 2) {
+            table.resize(n + 1);
+            for (int i = 0; i <= n; ++i) {
+                table[i] = evaluateAnalytic(start + (end - start) * i / n);
+            }
+
+            // Linear interpolation error peaks near the middle of intervals.
+            double maxError = 0;
+            for (int i = 0; i < n; ++i) {
+                const double t = start + (end - start) * (i + 0.5) / n;
+                const double error = std::abs(
+                    (table[i] + table[i + 1]) / 2 - evaluateAnalytic(t));
+                maxError = std::max(maxError, error);
+            }
+
+            if (maxError <= wavetableTolerance * Ee) {
+                break;
+            }
+        }
+    };
+
+    build(m_openTable, 0, Te);
+    build(m_returnTable, Te, T0);
 }
 
 bool lf::onParameterChange(const parameter& param) {
-    if (param.name() == "Oq") {
+    if (param.name() == "Wavetable") {
+        m_useWavetable = param.value<bool>();
+        if (usesWavetable()) {
+            buildWavetable();
+        } else {
+            m_openTable.clear();
+            m_returnTable.clear();
+        }
+        return true;
+    } else if (param.name() == "Voice quality plans") {
+        m_usePlans = param.value<bool>();
+        if (m_usePlans) {
+            m_openTable.clear();
+            m_returnTable.clear();
+            return true;
+        }
+        Oq = getParameter("Oq").value<double>();
+        am = getParameter("am").value<double>();
+        Qa = getParameter("Qa").value<double>();
+    } else if (param.name() == "Oq plan") {
+        m_OqPlan.setPlan(param.value<variable_plan>());
+        return true;
+    } else if (param.name() == "am plan") {
+        m_amPlan.setPlan(param.value<variable_plan>());
+        return true;
+    } else if (param.name() == "Qa plan") {
+        m_QaPlan.setPlan(param.value<variable_plan>());
+        return true;
+    } else if (param.name() == "Oq") {
         Oq = param.value<double>();
     } else if (param.name() == "am") {
         am = param.value<double>();
@@ -19,6 +19,8 @@
 #ifndef BABBLESYNTH_LF_H
 #define BABBLESYNTH_LF_H
 
+#include <vector>
+
 #include "abstract_source.h"
 
 namespace babblesynth {
@@ -30,9 +32,54 @@ class lf : public abstract_source {
 
     double evaluateAtPhase(double theta) override;
 
+    // The derivative jumps at the end of the open phase (Te) and at the end
+    // of the return phase, where the next period starts.
+    std::vector<slope_discontinuity> slopeDiscontinuities() const override;
+
+    // When "Voice quality plans" is set, Oq, am and Qa are taken from their
+    // plans at the start of every cycle instead of from their parameters.
+    // The wavetable is not used then: the shape can change every cycle, and
+    // building a table costs more than evaluating a cycle analytically.
+    bool beginPeriod(double time) override;
+
+    double openQuotient() const override;
+
+    // The shape of the current cycle and the solution the solvers start from.
+    std::vector<double> saveState() const override;
+    void restoreState(const std::vector<double>& state) override;
+
+    // Largest absolute difference between the wavetable and the analytic
+    // model, relative to the excitation amplitude Ee, that buildWavetable()
+    // allows before settling for a table size.
+    static constexpr double wavetableTolerance = 1e-5;
+
    private:
     bool calculateModelParameters();
 
+    // Solvers for the two implicit equations of the model. Scaled by the
+    // length of the return phase, epsilon only depends on Qa, and Newton's
+    // method converges to it monotonically from a fixed start. Alpha is
+    // polished with Newton's method from the previous solution, which takes
+    // a handful of iterations when the parameters vary slowly from one
+    // cycle to the next. Both fall back to a bracketing search when Newton's
+    // method doesn't converge.
+    double solveEpsilon() const;
+    double solveAlpha() const;
+
+    static constexpr int maxNewtonIterations = 20;
+    static constexpr double newtonTolerance = 1e-13;
+
+    double evaluateAnalytic(double t) const;
+
+    // Whether evaluateAtPhase() reads the wavetable.
+    bool usesWavetable() const;
+
+    // Samples the open phase [0, Te] and the return phase [Te, T0] in two
+    // separate tables so that the slope discontinuity at Te always falls
+    // on a table boundary. Table sizes are doubled until linear
+    // interpolation is within wavetableTolerance.
+    void buildWavetable();
+
     bool onParameterChange(const parameter& param) override;
 
     static constexpr double T0 = 1;
@@ -49,6 +96,18 @@ class lf : public abstract_source {
 
     double alpha;
     double epsilon;
+
+    // Whether alpha and epsilon hold a previous solution to start from.
+    bool m_isSolved;
+
+    bool m_usePlans;
+    variable m_OqPlan;
+    variable m_amPlan;
+    variable m_QaPlan;
+
+    bool m_useWavetable;
+    std::vector<double> m_openTable;
+    std::vector<double> m_returnTable;
 };
 
 }  // namespace source
@@ -0,0 +1,247 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <babblesynth.h>
+
+#include <QTemporaryDir>
+#include <QtTest>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace babblesynth::dictionary;
+
+class CompiledDictionaryTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void readsBackWhatWasBuilt();
+    void writesWhatItSerializes();
+    void ignoresCase();
+    void rejectsInvalidFiles();
+    void rejectsInvalidMappings();
+
+   private:
+    static dictionary_builder makeBuilder();
+
+    std::string writeFile(const std::vector<char> &bytes);
+
+    // Whether the bytes open as a dictionary, or are rejected when opened.
+    bool opens(const std::vector<char> &bytes);
+
+    QTemporaryDir m_dir;
+};
+
+// Offsets in the header of a compiled dictionary: a 4-byte magic, then the
+// version, byte order and number of sections, the source hash, and the
+// offset and record count of each section.
+static constexpr size_t versionOffset = 4;
+static constexpr size_t sectionsOffset = 24;
+
+enum { StringsSection, EntriesSection = 3, EdgesSection = 6 };
+
+template <typename T>
+static T peek(const std::vector<char> &bytes, const size_t offset) {
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+static void poke(std::vector<char> &bytes, const size_t offset,
+                 const T value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+static uint32_t sectionOffset(const std::vector<char> &bytes, int section) {
+    return peek<uint32_t>(bytes, sectionsOffset + 8 * section);
+}
+
+dictionary_builder CompiledDictionaryTest::makeBuilder() {
+    dictionary_builder builder;
+
+    const uint32_t a = builder.addPhoneme(
+        u"a", {{700, 130, -1, 0}, {1220, 70, -1, 0}}, {{300, 100, 0, 0}});
+    const uint32_t i = builder.addPhoneme(u"i", {{300, 60, -1, 0}}, {});
+
+    builder.addMapping(u"a", {{0.1, 1.0, a, 0}});
+    builder.addMapping(u"ai", {{0.1, 1.0, a, 0}, {0.15, 0.8, i, 0}});
+    builder.addMapping(u"\u00e9", {{0.2, 0.5, i, 0}});
+    builder.setSourceHash(0x0123456789abcdef);
+
+    return builder;
+}
+
+std::string CompiledDictionaryTest::writeFile(const std::vector<char> &bytes) {
+    const std::string path = m_dir.filePath("test.bsdict").toStdString();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+    return path;
+}
+
+bool CompiledDictionaryTest::opens(const std::vector<char> &bytes) {
+    const std::string path = writeFile(bytes);
+    try {
+        const compiled_dictionary dictionary(path);
+        return true;
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+}
+
+void CompiledDictionaryTest::readsBackWhatWasBuilt() {
+    const compiled_dictionary dictionary(
+        writeFile(makeBuilder().serialize()));
+
+    QCOMPARE(dictionary.sourceHash(), uint64_t(0x0123456789abcdef));
+
+    QCOMPARE(dictionary.phonemeCount(), size_t(2));
+    QVERIFY(dictionary.phonemeName(1) == u"i");
+    QCOMPARE(dictionary.poles(0).size(), size_t(2));
+    QCOMPARE(dictionary.poles(0)[1].frequency, 1220.0);
+    QCOMPARE(dictionary.zeros(0).size(), size_t(1));
+    QCOMPARE(dictionary.zeros(0)[0].index, 0);
+    QVERIFY(dictionary.zeros(1).empty());
+
+    QCOMPARE(dictionary.mappingCount(), size_t(3));
+    QVERIFY(dictionary.mappingName(2) == u"\u00e9");
+    QCOMPARE(dictionary.entries(1).size(), size_t(2));
+    QCOMPARE(dictionary.entries(1)[1].phoneme, uint32_t(1));
+    QCOMPARE(dictionary.entries(1)[1].duration, 0.15);
+
+    QCOMPARE(dictionary.findMapping(u"ai"), 1);
+    QCOMPARE(dictionary.findMapping(u"i"), -1);
+    QCOMPARE(dictionary.findMapping(u""), -1);
+
+    // Longest match first, and the space matches nothing.
+    const auto matches = dictionary.matchMappings(u"aai \u00e9");
+    QCOMPARE(matches.size(), size_t(3));
+    QCOMPARE(matches[0].mapping, 0);
+    QCOMPARE(matches[1].start, 1);
+    QCOMPARE(matches[1].length, 2);
+    QCOMPARE(matches[1].mapping, 1);
+    QCOMPARE(matches[2].start, 4);
+    QCOMPARE(matches[2].mapping, 2);
+}
+
+void CompiledDictionaryTest::writesWhatItSerializes() {
+    const auto builder = makeBuilder();
+    const std::string path = m_dir.filePath("written.bsdict").toStdString();
+    builder.write(path);
+
+    std::ifstream in(path, std::ios::binary);
+    const std::vector<char> written((std::istreambuf_iterator<char>(in)),
+                                    std::istreambuf_iterator<char>());
+
+    QVERIFY(written == builder.serialize());
+}
+
+void CompiledDictionaryTest::ignoresCase() {
+    dictionary_builder builder;
+    const uint32_t phoneme = builder.addPhoneme(u"a", {}, {});
+    for (const std::u16string_view name : {u"h", u"he", u"llo", u"\u00e9"}) {
+        builder.addMapping(name, {{0.1, 1.0, phoneme, 0}});
+    }
+
+    const compiled_dictionary dictionary(writeFile(builder.serialize()));
+
+    const auto matches = [&](const std::u16string_view text) {
+        std::vector<std::pair<int, int>> result;
+        for (const auto &match : dictionary.matchMappings(text)) {
+            result.emplace_back(match.length, match.mapping);
+        }
+        return result;
+    };
+
+    const auto expected = matches(u"hello h\u00e9llo");
+    QCOMPARE(expected.size(), size_t(5));
+    QVERIFY(matches(u"Hello H\u00c9LLO") == expected);
+    QVERIFY(matches(u"HELLO h\u00c9lLo") == expected);
+    QCOMPARE(dictionary.findMapping(u"He"), expected[0].second);
+}
+
+void CompiledDictionaryTest::rejectsInvalidFiles() {
+    const std::vector<char> valid = makeBuilder().serialize();
+    QVERIFY(opens(valid));
+
+    QVERIFY(!opens({}));
+    QVERIFY(!opens(std::vector<char>(valid.begin(), valid.begin() + 40)));
+
+    auto magic = valid;
+    magic[0] = 'X';
+    QVERIFY(!opens(magic));
+
+    auto version = valid;
+    poke<uint32_t>(version, versionOffset, compiled_dictionary::version + 1);
+    QVERIFY(!opens(version));
+
+    auto truncated = valid;
+    truncated.resize(sectionOffset(valid, EdgesSection));
+    QVERIFY(!opens(truncated));
+
+    auto strings = valid;
+    poke<uint32_t>(strings, sectionsOffset + 8 * StringsSection + 4, 1 << 30);
+    QVERIFY(!opens(strings));
+
+    // The phoneme of the first entry, past its duration and intensity.
+    auto entry = valid;
+    poke<uint32_t>(entry, sectionOffset(valid, EntriesSection) + 16, 2);
+    QVERIFY(!opens(entry));
+
+    // The child of the first edge, past its character and padding.
+    auto edge = valid;
+    poke<uint32_t>(edge, sectionOffset(valid, EdgesSection) + 4, 1000);
+    QVERIFY(!opens(edge));
+}
+
+void CompiledDictionaryTest::rejectsInvalidMappings() {
+    dictionary_builder builder;
+    const uint32_t phoneme = builder.addPhoneme(u"a", {}, {});
+
+    bool unknownPhoneme = false;
+    try {
+        builder.addMapping(u"b", {{0.1, 1.0, phoneme + 1, 0}});
+    } catch (const std::invalid_argument &) {
+        unknownPhoneme = true;
+    }
+    QVERIFY(unknownPhoneme);
+
+    // Names which only differ by case are allowed, the first one wins.
+    builder.addMapping(u"ab", {{0.1, 1.0, phoneme, 0}});
+    builder.addMapping(u"AB", {{0.1, 1.0, phoneme, 0}});
+    QCOMPARE(compiled_dictionary(writeFile(builder.serialize()))
+                 .findMapping(u"Ab"),
+             0);
+
+    builder.addMapping(u"ab", {{0.2, 1.0, phoneme, 0}});
+    bool duplicate = false;
+    try {
+        builder.serialize();
+    } catch (const std::invalid_argument &) {
+        duplicate = true;
+    }
+    QVERIFY(duplicate);
+}
+
+QTEST_GUILESS_MAIN(CompiledDictionaryTest)
+
+#include "compiled_dictionary_test.moc"
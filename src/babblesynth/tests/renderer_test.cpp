@@ -0,0 +1,108 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <babblesynth.h>
+
+#include <QtTest>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace babblesynth;
+
+class RendererTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void floatStaysCloseToDouble();
+
+   private:
+    static constexpr int sampleRate = 48000;
+};
+
+// The utterance of the command-line demo: a rising arpeggio of 3.6 seconds.
+static void configureVoice(generator::source_generator &source,
+                           filter::formant_filter &vtf) {
+    variable_plan pitch(false, 130.81);
+    pitch.linearToValueAtTime(130.81, 0.6);
+    pitch.cubicToValueAtTime(164.81, 0.7);
+    pitch.linearToValueAtTime(164.81, 1.2);
+    pitch.cubicToValueAtTime(196.00, 1.3);
+    pitch.linearToValueAtTime(196.00, 1.8);
+    pitch.cubicToValueAtTime(246.94, 1.9);
+    pitch.linearToValueAtTime(246.94, 2.4);
+    pitch.cubicToValueAtTime(261.63, 2.5);
+    pitch.linearToValueAtTime(261.63, 3.6);
+
+    variable_plan amplitude(false, 1e-10);
+    amplitude.linearToValueAtTime(0.8, 0.1);
+    amplitude.linearToValueAtTime(1.0, 1.8);
+    amplitude.linearToValueAtTime(0.8, 3.5);
+    amplitude.linearToValueAtTime(0.2, 3.6);
+
+    source.getParameter("Pitch plan").setValue(pitch);
+    source.getParameter("Amplitude plan").setValue(amplitude);
+    source.getParameter("Noise seed").setValue(1);
+
+    source.getSource()->getParameter("Oq").setValue(0.6);
+    source.getSource()->getParameter("am").setValue(0.8);
+    source.getSource()->getParameter("Qa").setValue(0.2);
+
+    variable_plan F1(true, 900);
+    variable_plan F2(true, 1300);
+    F1.linearToValueAtTime(1100, 3.0);
+    F2.linearToValueAtTime(1400, 3.0);
+
+    vtf.getParameter("F1 plan").setValue(F1);
+    vtf.getParameter("F2 plan").setValue(F2);
+}
+
+void RendererTest::floatStaysCloseToDouble() {
+    generator::source_generator source(sampleRate);
+    filter::formant_filter vtf(sampleRate);
+    configureVoice(source, vtf);
+
+    renderer reference(source, vtf);
+    reference.begin();
+    std::vector<double> expected(source.totalSamples());
+    expected.resize(reference.process(expected.data(), expected.size()));
+
+    basic_renderer<float> single(source, vtf);
+    single.begin();
+    std::vector<float> actual(source.totalSamples());
+    actual.resize(single.process(actual.data(), actual.size()));
+
+    QCOMPARE(actual.size(), expected.size());
+
+    double peak = 0;
+    double error = 0;
+    for (int i = 0; i < expected.size(); ++i) {
+        peak = std::max(peak, std::abs(expected[i]));
+        error = std::max(error, std::abs(actual[i] - expected[i]));
+    }
+
+    // Largest difference over the whole utterance, in dB relative to the
+    // peak of the double precision output.
+    const double errorDb = 20 * std::log10(error / peak);
+    qInfo("basic_renderer<float> error: %.1f dB", errorDb);
+    QVERIFY(errorDb <= -80);
+}
+
+QTEST_GUILESS_MAIN(RendererTest)
+
+#include "renderer_test.moc"
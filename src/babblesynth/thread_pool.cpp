@@ -0,0 +1,160 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace babblesynth;
+
+thread_pool::thread_pool(int numThreads)
+    : m_task(nullptr), m_remaining(0), m_generation(0), m_stopping(false) {
+    if (numThreads <= 0) {
+        numThreads = std::max<int>(1, std::thread::hardware_concurrency());
+    }
+
+    for (int i = 0; i < numThreads; ++i) {
+        m_queues.push_back(std::make_unique<worker_queue>());
+    }
+
+    for (int i = 0; i < numThreads; ++i) {
+        m_threads.emplace_back(&thread_pool::workerLoop, this, i);
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeWorkers.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+int thread_pool::size() const { return m_threads.size(); }
+
+void thread_pool::run(const int count,
+                      const std::function<void(int, int)>& task) {
+    if (count <= 0) {
+        return;
+    }
+
+    std::lock_guard runLock(m_runMutex);
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_task = &task;
+        m_remaining = count;
+    }
+
+    // Give each worker a contiguous range of indices to start with.
+    const int numWorkers = m_queues.size();
+    for (int w = 0; w < numWorkers; ++w) {
+        const int first = (long long)count * w / numWorkers;
+        const int last = (long long)count * (w + 1) / numWorkers;
+
+        std::lock_guard lock(m_queues[w]->mutex);
+        for (int i = first; i < last; ++i) {
+            m_queues[w]->indices.push_back(i);
+        }
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        ++m_generation;
+    }
+    m_wakeWorkers.notify_all();
+
+    std::exception_ptr exception;
+    {
+        std::unique_lock lock(m_mutex);
+        m_batchDone.wait(lock, [this] { return m_remaining == 0; });
+        m_task = nullptr;
+        std::swap(exception, m_exception);
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void thread_pool::workerLoop(const int worker) {
+    unsigned generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_wakeWorkers.wait(lock, [&] {
+                return m_stopping || m_generation != generation;
+            });
+            if (m_stopping) {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        // An index can only be taken while its batch is running, so m_task
+        // is always the right one to call for it.
+        int index;
+        while (takeIndex(worker, &index)) {
+            try {
+                (*m_task)(index, worker);
+            } catch (...) {
+                std::lock_guard lock(m_mutex);
+                if (!m_exception) {
+                    m_exception = std::current_exception();
+                }
+            }
+
+            if (--m_remaining == 0) {
+                std::lock_guard lock(m_mutex);
+                m_batchDone.notify_all();
+            }
+        }
+    }
+}
+
+bool thread_pool::takeIndex(const int worker, int* index) {
+    const int numWorkers = m_queues.size();
+
+    {
+        auto& own = *m_queues[worker];
+        std::lock_guard lock(own.mutex);
+        if (!own.indices.empty()) {
+            *index = own.indices.front();
+            own.indices.pop_front();
+            return true;
+        }
+    }
+
+    for (int i = 1; i < numWorkers; ++i) {
+        auto& victim = *m_queues[(worker + i) % numWorkers];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.indices.empty()) {
+            *index = victim.indices.back();
+            victim.indices.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,86 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BABBLESYNTH_THREAD_POOL_H
+#define BABBLESYNTH_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace babblesynth {
+
+// A fixed set of worker threads that run indexed tasks.
+//
+// Each call to run() splits the task indices into one contiguous queue per
+// worker. Workers take indices from the front of their own queue and, once it
+// is empty, steal from the back of the other workers' queues, so that uneven
+// task durations still keep every worker busy.
+class thread_pool {
+   public:
+    // A thread count of 0 uses one worker per hardware thread.
+    explicit thread_pool(int numThreads = 0);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    int size() const;
+
+    // Calls task(index, worker) for every index in [0, count) and blocks until
+    // all of them have returned. `worker` is in [0, size()) and identifies the
+    // thread the task runs on. If a task throws, the remaining tasks still
+    // run and the first exception is rethrown here. Concurrent calls to run()
+    // are executed one after the other.
+    void run(int count, const std::function<void(int, int)>& task);
+
+   private:
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<int> indices;
+    };
+
+    void workerLoop(int worker);
+    bool takeIndex(int worker, int* index);
+
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<worker_queue>> m_queues;
+
+    std::mutex m_runMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeWorkers;
+    std::condition_variable m_batchDone;
+
+    const std::function<void(int, int)>* m_task;
+    std::atomic<int> m_remaining;
+    unsigned m_generation;
+    bool m_stopping;
+
+    std::exception_ptr m_exception;
+};
+
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_THREAD_POOL_H
@@ -19,6 +19,9 @@
 #ifndef BABBLESYNTH_UTILITY_H
 #define BABBLESYNTH_UTILITY_H
 
+#include <cstdint>
+#include <cstring>
+#include <string>
 #include <type_traits>
 #include <variant>
 
@@ -55,6 +58,35 @@ T get_with_numeric_conversion(const std::variant<Types...>& variant) {
     return std::get<T>(variant);
 }
 
+// 64-bit FNV-1a hash, which unlike std::hash gives the same value from one run
+// to the next.
+class hasher {
+   public:
+    template <typename T>
+    std::enable_if_t<std::is_trivially_copyable_v<T>, hasher&> add(
+        const T& value) {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        for (const unsigned char byte : bytes) {
+            m_value = (m_value ^ byte) * 0x100000001b3;
+        }
+        return *this;
+    }
+
+    hasher& add(const std::string& value) {
+        add(value.size());
+        for (const char c : value) {
+            add(c);
+        }
+        return *this;
+    }
+
+    std::uint64_t value() const { return m_value; }
+
+   private:
+    std::uint64_t m_value = 0xcbf29ce484222325;
+};
+
 }  // namespace util
 }  // namespace babblesynth
 
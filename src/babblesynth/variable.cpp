@@ -21,17 +21,35 @@
 using namespace babblesynth;
 
 variable::variable(bool isTrulyContinuous)
-    : m_isTrulyContinuous(isTrulyContinuous), m_actualValue(0), m_plan(0) {}
+    : m_isTrulyContinuous(isTrulyContinuous),
+      m_actualValue(0),
+      m_plan(0),
+      m_cursor(m_plan) {}
 
-void variable::setPlan(const variable_plan &plan) { m_plan = plan; }
+variable::variable(const variable &orig)
+    : m_isTrulyContinuous(orig.m_isTrulyContinuous),
+      m_actualValue(orig.m_actualValue),
+      m_plan(orig.m_plan),
+      m_cursor(m_plan) {}
 
-void variable::update(double time) {
-    m_actualValue = m_plan.evaluateAtTime(time);
+variable &variable::operator=(const variable &orig) {
+    m_isTrulyContinuous = orig.m_isTrulyContinuous;
+    m_actualValue = orig.m_actualValue;
+    m_plan = orig.m_plan;
+    m_cursor.reset();
+    return *this;
 }
 
+void variable::setPlan(const variable_plan &plan) {
+    m_plan = plan;
+    m_cursor.reset();
+}
+
+void variable::update(double time) { m_actualValue = m_cursor.advanceTo(time); }
+
 double variable::evaluateAtTime(double time) const {
     if (m_isTrulyContinuous) {
-        return m_plan.evaluateAtTime(time);
+        return m_cursor.advanceTo(time);
     } else {
         return m_actualValue;
     }
@@ -26,12 +26,18 @@ namespace babblesynth {
 class variable {
    public:
     explicit variable(bool isTrulyContinuous = true);
+    variable(const variable& orig);
+
+    variable& operator=(const variable& orig);
 
     void setPlan(const variable_plan& plan);
 
     void update(double time);  // used in the ^isTrulyContinuous case to update
                                // the value
 
+    // Cheapest when called with non-decreasing times, see plan_cursor.
+    // Not thread-safe despite being const: it moves the shared cursor, so
+    // threads must not evaluate the same variable concurrently.
     double evaluateAtTime(double time) const;
 
     double maxTime() const;
@@ -40,6 +46,7 @@ class variable {
     bool m_isTrulyContinuous;
     double m_actualValue;  // only used in the ^isTrulyContinuous case
     variable_plan m_plan;
+    mutable plan_cursor m_cursor;  // always refers to m_plan
 };
 
 }  // namespace babblesynth
@@ -18,6 +18,8 @@
 
 #include "variable_plan.h"
 
+#include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <stdexcept>
 
@@ -30,6 +32,7 @@ variable_plan::variable_plan(bool piecewiseMonotonic, double initialValue)
       m_times({0.0}),
       m_values({initialValue}),
       m_transitions({TransitionLinear, TransitionLinear}),
+      m_isSorted(true),
       m_spline(nullptr) {
     updateSpline();
 }
@@ -39,6 +42,7 @@ variable_plan::variable_plan(const variable_plan& orig)
       m_times(orig.m_times),
       m_values(orig.m_values),
       m_transitions(orig.m_transitions),
+      m_isSorted(orig.m_isSorted),
       m_spline(nullptr) {
     updateSpline();
 }
@@ -59,6 +63,7 @@ variable_plan& variable_plan::operator=(const variable_plan& orig) {
     m_times = orig.m_times;
     m_values = orig.m_values;
     m_transitions = orig.m_transitions;
+    m_isSorted = orig.m_isSorted;
     updateSpline();
     return *this;
 }
@@ -84,17 +89,91 @@ variable_plan& variable_plan::reset(double initialValue) {
     m_transitions.clear();
     m_times.push_back(0);
     m_values.push_back(initialValue);
+    m_isSorted = true;
     updateSpline();
     return *this;
 }
 
 double variable_plan::evaluateAtTime(double time) const {
+    return evaluateSegment(findLeftIndex(time), time);
+}
+
+void variable_plan::addToHash(util::hasher& h) const {
+    h.add(m_isPiecewiseMonotonic);
+    h.add(m_times.size());
+    for (int i = 0; i < m_times.size(); ++i) {
+        h.add(m_times[i]).add(m_values[i]);
+    }
+    h.add(m_transitions.size());
+    for (const auto transition : m_transitions) {
+        h.add(transition);
+    }
+}
+
+double variable_plan::agreesUntil(const variable_plan& other) const {
+    if (!m_isSorted || !other.m_isSorted) {
+        return -INFINITY;
+    }
+
+    const auto transitionAt = [](const variable_plan& plan, int index) {
+        return index < plan.m_transitions.size()
+                   ? int(plan.m_transitions[index])
+                   : -1;
+    };
+
+    // Up to the time of point k, the plans only read points 0 to k and the
+    // transitions of the segments in between.
+    const int common = std::min(m_times.size(), other.m_times.size());
+
+    int k = 0;
+    for (; k < common; ++k) {
+        if (m_times[k] != other.m_times[k] ||
+            m_values[k] != other.m_values[k]) {
+            break;
+        }
+        if (k > 0 && transitionAt(*this, k - 1) != transitionAt(other, k - 1)) {
+            break;
+        }
+    }
+
+    if (k == m_times.size() && k == other.m_times.size()) {
+        return INFINITY;
+    }
+    if (k == 0) {
+        return -INFINITY;
+    }
+
+    // Past point k - 1, a plan keeps its value until point k if both have
+    // the same value, whatever the transition, or forever if there is no
+    // point k. This is how a constant plan grows when the utterance does.
+    const auto holdsUntil = [k](const variable_plan& plan) {
+        if (k == plan.m_times.size()) {
+            return double(INFINITY);
+        }
+        return plan.m_values[k] == plan.m_values[k - 1] ? plan.m_times[k]
+                                                        : plan.m_times[k - 1];
+    };
+
+    return std::max(m_times[k - 1], std::min(holdsUntil(*this),
+                                             holdsUntil(other)));
+}
+
+plan_cursor variable_plan::cursor() const { return plan_cursor(*this); }
+
+int variable_plan::findLeftIndex(double time) const {
+    if (m_isSorted) {
+        return std::lower_bound(m_times.begin(), m_times.end(), time) -
+               m_times.begin() - 1;
+    }
+
     int leftIndex = 0;
     while (leftIndex < m_times.size() && m_times[leftIndex] < time) {
         ++leftIndex;
     }
-    leftIndex -= 1;
+    return leftIndex - 1;
+}
 
+double variable_plan::evaluateSegment(int leftIndex, double time) const {
     double value = 0;
 
     if (leftIndex < 0) {
@@ -127,7 +206,23 @@ double variable_plan::evaluateAtTime(double time) const {
 
 double variable_plan::duration() const { return m_times.back(); }
 
+double variable_plan::maxValueBetween(double startTime, double endTime) const {
+    double value =
+        std::max(evaluateAtTime(startTime), evaluateAtTime(endTime));
+
+    for (int i = findLeftIndex(startTime) + 1;
+         i < m_times.size() && m_times[i] < endTime; ++i) {
+        value = std::max(value, m_values[i]);
+    }
+
+    return value;
+}
+
 void variable_plan::addPoint(double time, double value, transition trans) {
+    if (time < m_times.back()) {
+        m_isSorted = false;
+    }
+
     m_times.push_back(time);
     m_values.push_back(value);
     m_transitions.push_back(trans);
@@ -177,4 +272,44 @@ double variable_plan::interpolateCubic(int index, double time) const {
     const double y = x < 0.5 ? 4 * x * x * x : 1 - std::pow(-2 * x + 2, 3) / 2;
 
     return V0 + (V1 - V0) * y;
-}
\ No newline at end of file
+}
+
+plan_cursor::plan_cursor(const variable_plan& plan) : m_plan(&plan) {
+    reset();
+}
+
+double plan_cursor::advanceTo(double time) {
+    const auto& times = m_plan->m_times;
+
+    if (!m_plan->m_isSorted) {
+        return m_plan->evaluateAtTime(time);
+    }
+
+    if (time < m_time || m_index > times.size()) {
+        // Going back in time, search from scratch.
+        m_index = m_plan->findLeftIndex(time) + 1;
+    } else {
+        // Step forward a few points, then binary search for long jumps.
+        constexpr int maxSteps = 8;
+
+        int steps = 0;
+        while (m_index < times.size() && times[m_index] < time) {
+            if (++steps > maxSteps) {
+                m_index = std::lower_bound(times.begin() + m_index,
+                                           times.end(), time) -
+                          times.begin();
+                break;
+            }
+            ++m_index;
+        }
+    }
+
+    m_time = time;
+
+    return m_plan->evaluateSegment(m_index - 1, time);
+}
+
+void plan_cursor::reset() {
+    m_index = 0;
+    m_time = -INFINITY;
+}
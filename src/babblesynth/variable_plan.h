@@ -21,8 +21,12 @@
 
 #include <vector>
 
+#include "utility.h"
+
 namespace babblesynth {
 
+class plan_cursor;
+
 class variable_plan {
    public:
     enum transition {
@@ -46,12 +50,32 @@ class variable_plan {
 
     double evaluateAtTime(double time) const;
 
+    // Returns a cursor for evaluating the plan at increasing times.
+    plan_cursor cursor() const;
+
     double duration() const;
 
+    // Largest value the plan takes between the two times. Transitions never
+    // overshoot the points at their ends.
+    double maxValueBetween(double startTime, double endTime) const;
+
+    // Adds every point of the plan to `h`. Equal plans hash equally.
+    void addToHash(util::hasher& h) const;
+
+    // Latest time up to which this plan evaluates exactly like `other`:
+    // infinity if they are equal, -infinity if they differ from the start.
+    double agreesUntil(const variable_plan& other) const;
+
    private:
+    friend class plan_cursor;
+
     void addPoint(double time, double value, transition trans);
     void updateSpline();
 
+    // Index of the last point strictly before `time`, or -1 if there is none.
+    int findLeftIndex(double time) const;
+    double evaluateSegment(int leftIndex, double time) const;
+
     double interpolateStep(int index, double time) const;
     double interpolateLinear(int index, double time) const;
     double interpolateCubic(int index, double time) const;
@@ -62,10 +86,38 @@ class variable_plan {
     std::vector<double> m_values;
     std::vector<transition> m_transitions;
 
+    // Whether the points were added in increasing time order, which allows
+    // binary searching for a time.
+    bool m_isSorted;
+
     // tk::spline m_spline; // Moved to the cpp file because anonymous namespace
     void* m_spline;
 };
 
+// Evaluates a plan at successive times.
+//
+// When the times passed to advanceTo() never decrease, finding the segment to
+// interpolate costs amortized O(1) instead of a search over every point.
+// Going back in time is allowed and falls back to a binary search.
+//
+// A cursor refers to its plan and must not outlive it. It has to be reset()
+// after the plan was modified.
+class plan_cursor {
+   public:
+    explicit plan_cursor(const variable_plan& plan);
+
+    double advanceTo(double time);
+
+    void reset();
+
+   private:
+    const variable_plan* m_plan;
+
+    // Number of points strictly before m_time.
+    int m_index;
+    double m_time;
+};
+
 }  // namespace babblesynth
 
 #endif  // BABBLESYNTH_VARIABLE_PLAN_H
\ No newline at end of file
@@ -0,0 +1,206 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "harness.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> g_allocationCount{0};
+std::atomic<uint64_t> g_allocatedBytes{0};
+
+volatile double g_sink;
+
+std::string jsonString(const std::string& str) {
+    std::string out = "\"";
+    for (const char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+double bench::result::samplesPerSecond() const {
+    return samplesPerIteration / secondsPerIteration;
+}
+
+double bench::result::realTimeFactor() const {
+    if (sampleRate <= 0) {
+        return 0;
+    }
+    return secondsPerIteration / (samplesPerIteration / sampleRate);
+}
+
+uint64_t bench::allocationCount() { return g_allocationCount; }
+
+uint64_t bench::allocatedBytes() { return g_allocatedBytes; }
+
+void bench::doNotOptimize(double value) { g_sink = value; }
+
+bench::runner::runner(double minTime, const std::string& filter)
+    : m_minTime(minTime), m_filter(filter) {}
+
+void bench::runner::run(const std::string& name, double samples,
+                        double sampleRate,
+                        const std::function<void()>& body) {
+    using clock = std::chrono::steady_clock;
+
+    if (!selected(name)) {
+        return;
+    }
+
+    body();
+
+    const uint64_t allocationsBefore = allocationCount();
+    const uint64_t bytesBefore = allocatedBytes();
+
+    int64_t iterations = 0;
+    double elapsed = 0;
+
+    const auto start = clock::now();
+    do {
+        body();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < m_minTime);
+
+    result res;
+    res.name = name;
+    res.iterations = iterations;
+    res.secondsPerIteration = elapsed / iterations;
+    res.samplesPerIteration = samples;
+    res.sampleRate = sampleRate;
+    res.allocationsPerIteration =
+        double(allocationCount() - allocationsBefore) / iterations;
+    res.bytesPerIteration = double(allocatedBytes() - bytesBefore) / iterations;
+
+    m_results.push_back(res);
+}
+
+bool bench::runner::selected(const std::string& name) const {
+    return name.find(m_filter) != std::string::npos;
+}
+
+const std::vector<bench::result>& bench::runner::results() const {
+    return m_results;
+}
+
+void bench::printText(std::ostream& out, const info_list& info,
+                      const std::vector<result>& results) {
+    for (const auto& [key, value] : info) {
+        out << key << ": " << value << "\n";
+    }
+    out << "\n";
+
+    out << std::left << std::setw(56) << "benchmark" << std::right
+        << std::setw(14) << "time/iter" << std::setw(16) << "samples/s"
+        << std::setw(10) << "RTF" << std::setw(12) << "allocs/iter"
+        << std::setw(14) << "bytes/iter"
+        << "\n";
+
+    for (const auto& res : results) {
+        const double micros = res.secondsPerIteration * 1e6;
+
+        out << std::left << std::setw(56) << res.name << std::right
+            << std::setw(11) << std::fixed << std::setprecision(2) << micros
+            << " us" << std::setw(16) << std::scientific
+            << std::setprecision(3) << res.samplesPerSecond();
+
+        if (res.sampleRate > 0) {
+            out << std::setw(10) << std::fixed << std::setprecision(5)
+                << res.realTimeFactor();
+        } else {
+            out << std::setw(10) << "-";
+        }
+
+        out << std::setw(12) << std::fixed << std::setprecision(1)
+            << res.allocationsPerIteration << std::setw(14)
+            << std::setprecision(0) << res.bytesPerIteration << "\n";
+    }
+}
+
+void bench::printCsv(std::ostream& out, const std::vector<result>& results) {
+    out << "name,iterations,seconds_per_iteration,samples_per_iteration,"
+           "sample_rate,samples_per_second,real_time_factor,"
+           "allocations_per_iteration,bytes_per_iteration\n";
+
+    out << std::setprecision(9);
+    for (const auto& res : results) {
+        out << res.name << "," << res.iterations << ","
+            << res.secondsPerIteration << "," << res.samplesPerIteration
+            << "," << res.sampleRate << "," << res.samplesPerSecond() << ","
+            << res.realTimeFactor() << "," << res.allocationsPerIteration
+            << "," << res.bytesPerIteration << "\n";
+    }
+}
+
+void bench::printJson(std::ostream& out, const info_list& info,
+                      const std::vector<result>& results) {
+    out << "{\n";
+    for (const auto& [key, value] : info) {
+        out << "  " << jsonString(key) << ": " << jsonString(value) << ",\n";
+    }
+
+    out << std::setprecision(9);
+    out << "  \"results\": [";
+    for (int i = 0; i < results.size(); ++i) {
+        const auto& res = results[i];
+        out << (i > 0 ? ",\n" : "\n") << "    {"
+            << "\"name\": " << jsonString(res.name)
+            << ", \"iterations\": " << res.iterations
+            << ", \"seconds_per_iteration\": " << res.secondsPerIteration
+            << ", \"samples_per_iteration\": " << res.samplesPerIteration
+            << ", \"sample_rate\": " << res.sampleRate
+            << ", \"samples_per_second\": " << res.samplesPerSecond()
+            << ", \"real_time_factor\": " << res.realTimeFactor()
+            << ", \"allocations_per_iteration\": "
+            << res.allocationsPerIteration
+            << ", \"bytes_per_iteration\": " << res.bytesPerIteration << "}";
+    }
+    out << "\n  ]\n}\n";
+}
@@ -0,0 +1,92 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BABBLESYNTH_BENCH_HARNESS_H
+#define BABBLESYNTH_BENCH_HARNESS_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+struct result {
+    std::string name;
+    int64_t iterations;
+    double secondsPerIteration;
+
+    // Audio processed by one iteration. For benchmarks that don't process
+    // audio, sampleRate is 0 and the samples count calls instead.
+    double samplesPerIteration;
+    double sampleRate;
+
+    double allocationsPerIteration;
+    double bytesPerIteration;
+
+    double samplesPerSecond() const;
+
+    // Processing time over audio duration: below 1 is faster than real time.
+    double realTimeFactor() const;
+};
+
+// Total number of allocations and allocated bytes since the program started,
+// counted by the global operator new replacements of the benchmark.
+uint64_t allocationCount();
+uint64_t allocatedBytes();
+
+// Keeps the compiler from optimizing away a computed value.
+void doNotOptimize(double value);
+
+class runner {
+   public:
+    // Benchmarks whose name doesn't contain `filter` are skipped.
+    runner(double minTime, const std::string& filter);
+
+    // Calls `body` once to warm up, then repeatedly for at least minTime
+    // seconds. Each call is expected to process `samples` samples of audio
+    // at `sampleRate`.
+    void run(const std::string& name, double samples, double sampleRate,
+             const std::function<void()>& body);
+
+    // Whether `name` passes the filter, for measurements that aren't timed.
+    bool selected(const std::string& name) const;
+
+    const std::vector<result>& results() const;
+
+   private:
+    double m_minTime;
+    std::string m_filter;
+    std::vector<result> m_results;
+};
+
+// Describes the build and machine the results were measured on.
+using info_list = std::vector<std::pair<std::string, std::string>>;
+
+void printText(std::ostream& out, const info_list& info,
+               const std::vector<result>& results);
+void printCsv(std::ostream& out, const std::vector<result>& results);
+void printJson(std::ostream& out, const info_list& info,
+               const std::vector<result>& results);
+
+}  // namespace bench
+
+#endif  // BABBLESYNTH_BENCH_HARNESS_H
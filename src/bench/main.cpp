@@ -0,0 +1,538 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <arima/Fitting/BurgYule.h>
+#include <babblesynth.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "harness.h"
+
+using namespace babblesynth;
+
+#ifndef BABBLESYNTH_VERSION
+#define BABBLESYNTH_VERSION "unknown"
+#endif
+
+namespace {
+
+constexpr int sampleRate = 48'000;
+
+// The utterance of the command-line demo: a rising arpeggio of 3.6 seconds.
+void configureVoice(generator::source_generator& source,
+                    filter::formant_filter& vtf) {
+    variable_plan pitch(false, 130.81);
+    pitch.linearToValueAtTime(130.81, 0.6);
+    pitch.cubicToValueAtTime(164.81, 0.7);
+    pitch.linearToValueAtTime(164.81, 1.2);
+    pitch.cubicToValueAtTime(196.00, 1.3);
+    pitch.linearToValueAtTime(196.00, 1.8);
+    pitch.cubicToValueAtTime(246.94, 1.9);
+    pitch.linearToValueAtTime(246.94, 2.4);
+    pitch.cubicToValueAtTime(261.63, 2.5);
+    pitch.linearToValueAtTime(261.63, 3.6);
+
+    variable_plan amplitude(false, 1e-10);
+    amplitude.linearToValueAtTime(0.8, 0.1);
+    amplitude.linearToValueAtTime(1.0, 1.8);
+    amplitude.linearToValueAtTime(0.8, 3.5);
+    amplitude.linearToValueAtTime(0.2, 3.6);
+
+    source.getParameter("Pitch plan").setValue(pitch);
+    source.getParameter("Amplitude plan").setValue(amplitude);
+    source.getParameter("Noise seed").setValue(1);
+
+    source.getSource()->getParameter("Oq").setValue(0.6);
+    source.getSource()->getParameter("am").setValue(0.8);
+    source.getSource()->getParameter("Qa").setValue(0.2);
+
+    variable_plan F1(true, 900);
+    variable_plan F2(true, 1300);
+    F1.linearToValueAtTime(1100, 3.0);
+    F2.linearToValueAtTime(1400, 3.0);
+
+    vtf.getParameter("F1 plan").setValue(F1);
+    vtf.getParameter("F2 plan").setValue(F2);
+}
+
+// A plan with `points` breakpoints alternating between the three transition
+// types over `duration` seconds.
+variable_plan makePlan(int points, double duration) {
+    variable_plan plan(false, 150);
+    for (int i = 1; i < points; ++i) {
+        const double time = duration * i / (points - 1);
+        const double value = 150 + 50 * std::sin(i * 0.7);
+        switch (i % 3) {
+            case 0:
+                plan.stepToValueAtTime(value, time);
+                break;
+            case 1:
+                plan.linearToValueAtTime(value, time);
+                break;
+            default:
+                plan.cubicToValueAtTime(value, time);
+                break;
+        }
+    }
+    return plan;
+}
+
+void benchSynthesis(bench::runner& runner) {
+    generator::source_generator source(sampleRate);
+    filter::formant_filter vtf(sampleRate);
+    configureVoice(source, vtf);
+
+    std::vector<std::pair<int, int>> periods;
+    double Oq;
+    const auto glottal = source.generate(periods, &Oq);
+    const double samples = glottal.size();
+
+    runner.run("source_generator::generate", samples, sampleRate, [&] {
+        std::vector<std::pair<int, int>> periods;
+        double Oq;
+        bench::doNotOptimize(source.generate(periods, &Oq).back());
+    });
+
+    runner.run("formant_filter::generateFrom", samples, sampleRate, [&] {
+        bench::doNotOptimize(vtf.generateFrom(glottal, periods, Oq).back());
+    });
+
+    renderer streaming(source, vtf);
+    std::vector<double> block(256);
+    runner.run("renderer::process (256-sample blocks)", samples, sampleRate,
+               [&] {
+                   streaming.begin();
+                   while (streaming.process(block.data(), block.size()) ==
+                          block.size()) {
+                   }
+                   bench::doNotOptimize(block[0]);
+               });
+
+    basic_renderer<float> streamingFloat(source, vtf);
+    std::vector<float> blockFloat(256);
+    runner.run("basic_renderer<float>::process (256-sample blocks)", samples,
+               sampleRate, [&] {
+                   streamingFloat.begin();
+                   while (streamingFloat.process(blockFloat.data(),
+                                                 blockFloat.size()) ==
+                          blockFloat.size()) {
+                   }
+                   bench::doNotOptimize(blockFloat[0]);
+               });
+
+    // Short dialogue blips, as rendered by the voice effect modes.
+    batch_renderer batch(sampleRate);
+
+    std::vector<render_job> jobs(4 * batch.numThreads());
+    for (int i = 0; i < jobs.size(); ++i) {
+        jobs[i].pitchPlan =
+            variable_plan(false, 180 + 10 * i).stepToValueAtTime(180, 0.1);
+        jobs[i].amplitudePlan =
+            variable_plan(false, 1).stepToValueAtTime(1, 0.1);
+        jobs[i].generatorParameters["Noise seed"] = i + 1;
+    }
+
+    const double batchSamples = jobs.size() * 0.1 * sampleRate;
+    runner.run("batch_renderer::render (0.1 s jobs)", batchSamples,
+               sampleRate, [&] {
+                   bench::doNotOptimize(batch.render(jobs).back().back());
+               });
+}
+
+void benchFilters(bench::runner& runner) {
+    // A typical vocal tract cascade: resonances at 500 Hz intervals.
+    std::vector<std::array<double, 6>> sos;
+    for (int i = 0; i < 10; ++i) {
+        const double R = std::exp(-M_PI * 100 / sampleRate);
+        const double theta = 2 * M_PI * (500 + 1000 * i) / sampleRate;
+        sos.push_back({1 - R, 0, 0, 1, -2 * R * std::cos(theta), R * R});
+    }
+
+    std::vector<double> x(sampleRate), y(sampleRate);
+    for (int i = 0; i < x.size(); ++i) {
+        x[i] = std::sin(0.01 * i) + 0.1 * std::sin(1.3 * i);
+    }
+
+    std::vector<std::array<double, 2>> zi(sos.size(), {0.0, 0.0});
+    runner.run("filter::sosfilt (10 sections)", x.size(), sampleRate, [&] {
+        filter::sosfilt(sos, x.data(), y.data(), x.size(), zi);
+        bench::doNotOptimize(y.back());
+    });
+
+    std::vector<std::array<float, 6>> sosFloat(sos.size());
+    for (int s = 0; s < sos.size(); ++s) {
+        std::copy(sos[s].begin(), sos[s].end(), sosFloat[s].begin());
+    }
+    std::vector<float> xFloat(x.begin(), x.end()), yFloat(x.size());
+    std::vector<std::array<float, 2>> ziFloat(sos.size(), {0.0f, 0.0f});
+    runner.run("filter::sosfilt<float> (10 sections)", x.size(), sampleRate,
+               [&] {
+                   filter::sosfilt(sosFloat, xFloat.data(), yFloat.data(),
+                                   xFloat.size(), ziFloat);
+                   bench::doNotOptimize(yFloat.back());
+               });
+
+    constexpr int voices = 8;
+    std::vector<double> sosBatch(sos.size() * 6 * voices);
+    std::vector<double> ziBatch(sos.size() * 2 * voices, 0.0);
+    std::vector<double> xBatch(x.size() * voices), yBatch(x.size() * voices);
+    for (int s = 0; s < sos.size(); ++s) {
+        for (int c = 0; c < 6; ++c) {
+            for (int v = 0; v < voices; ++v) {
+                sosBatch[(s * 6 + c) * voices + v] = sos[s][c];
+            }
+        }
+    }
+    for (int k = 0; k < x.size(); ++k) {
+        for (int v = 0; v < voices; ++v) {
+            xBatch[k * voices + v] = x[k];
+        }
+    }
+
+    runner.run(std::string("filter::sosfilt_batch (10 sections, 8 voices, ") +
+                   filter::sosfilt_batch_kernel() + ")",
+               xBatch.size(), sampleRate, [&] {
+                   filter::sosfilt_batch(sosBatch.data(), xBatch.data(),
+                                         yBatch.data(), sos.size(), voices,
+                                         x.size(), ziBatch.data());
+                   bench::doNotOptimize(yBatch.back());
+               });
+
+    // The same register holds twice as many voices in single precision.
+    constexpr int voicesFloat = 2 * voices;
+    std::vector<float> sosBatchFloat(sos.size() * 6 * voicesFloat);
+    std::vector<float> ziBatchFloat(sos.size() * 2 * voicesFloat, 0.0f);
+    std::vector<float> xBatchFloat(x.size() * voicesFloat),
+        yBatchFloat(x.size() * voicesFloat);
+    for (int s = 0; s < sos.size(); ++s) {
+        for (int c = 0; c < 6; ++c) {
+            for (int v = 0; v < voicesFloat; ++v) {
+                sosBatchFloat[(s * 6 + c) * voicesFloat + v] = sos[s][c];
+            }
+        }
+    }
+    for (int k = 0; k < x.size(); ++k) {
+        for (int v = 0; v < voicesFloat; ++v) {
+            xBatchFloat[k * voicesFloat + v] = x[k];
+        }
+    }
+
+    runner.run(std::string("filter::sosfilt_batch<float> (10 sections, 16 "
+                           "voices, ") +
+                   filter::sosfilt_batch_kernel() + ")",
+               xBatchFloat.size(), sampleRate, [&] {
+                   filter::sosfilt_batch(
+                       sosBatchFloat.data(), xBatchFloat.data(),
+                       yBatchFloat.data(), sos.size(), voicesFloat, x.size(),
+                       ziBatchFloat.data());
+                   bench::doNotOptimize(yBatchFloat.back());
+               });
+
+    const std::vector<double> b{1, 0}, a{1, 0.99};
+    std::vector<double> z(1, 0.0);
+    runner.run("filter::lfilter (leaky integrator)", x.size(), sampleRate,
+               [&] {
+                   filter::lfilter(b, a, x.data(), y.data(), x.size(), z);
+                   bench::doNotOptimize(y.back());
+               });
+}
+
+void benchPlans(bench::runner& runner) {
+    constexpr double duration = 10.0;
+    constexpr int evaluations = sampleRate;
+
+    for (const int points : {10, 1000, 10000, 100000}) {
+        const auto plan = makePlan(points, duration);
+        const std::string suffix = " (" + std::to_string(points) + " points)";
+
+        runner.run("variable_plan::evaluateAtTime" + suffix, evaluations,
+                   sampleRate, [&] {
+                       double sum = 0;
+                       for (int i = 0; i < evaluations; ++i) {
+                           sum += plan.evaluateAtTime(duration * i /
+                                                      evaluations);
+                       }
+                       bench::doNotOptimize(sum);
+                   });
+
+        runner.run("plan_cursor::advanceTo" + suffix, evaluations,
+                   sampleRate, [&] {
+                       auto cursor = plan.cursor();
+                       double sum = 0;
+                       for (int i = 0; i < evaluations; ++i) {
+                           sum += cursor.advanceTo(duration * i / evaluations);
+                       }
+                       bench::doNotOptimize(sum);
+                   });
+    }
+}
+
+void benchSource(bench::runner& runner) {
+    generator::source_generator source(sampleRate);
+    auto& Oq = source.getSource()->getParameter("Oq");
+
+    // Each change of a model parameter solves for the LF model again.
+    bool toggle = false;
+    runner.run("lf::calculateModelParameters", 1, 0, [&] {
+        toggle = !toggle;
+        Oq.setValue(toggle ? 0.55 : 0.65);
+    });
+
+    // Voice quality plans are evaluated at the start of every cycle.
+    source.getSource()->getParameter("Oq plan").setValue(
+        variable_plan(false, 0.4).linearToValueAtTime(0.8, 1.0));
+    source.getSource()->getParameter("Voice quality plans").setValue(true);
+    double time = 0;
+    runner.run("lf::beginPeriod (Oq plan)", 1, 0, [&] {
+        time = (time < 1) ? time + 1e-4 : 0;
+        source.getSource()->beginPeriod(time);
+    });
+}
+
+void benchAnalysis(bench::runner& runner) {
+    generator::source_generator source(sampleRate);
+    filter::formant_filter vtf(sampleRate);
+    configureVoice(source, vtf);
+
+    std::vector<std::pair<int, int>> periods;
+    double Oq;
+    const auto voice =
+        vtf.generateFrom(source.generate(periods, &Oq), periods, Oq);
+
+    const std::vector<double> second(voice.begin(),
+                                     voice.begin() + sampleRate);
+
+    runner.run("resample (48 kHz to 10 kHz)", second.size(), sampleRate, [&] {
+        bench::doNotOptimize(resample(second, sampleRate, 10'000).back());
+    });
+
+    const std::vector<float> secondFloat(second.begin(), second.end());
+    const std::pair<resampler::quality, const char*> qualities[] = {
+        {resampler::QualityBest, "best"},
+        {resampler::QualityMedium, "medium"},
+        {resampler::QualityFastest, "fastest"},
+        {resampler::QualityLinear, "linear"},
+    };
+    for (const auto& [quality, name] : qualities) {
+        resampler converter(sampleRate, 10'000, quality);
+        std::vector<float> out;
+        runner.run(std::string("resampler::process (to 10 kHz, ") + name +
+                       ", 256 blocks)",
+                   secondFloat.size(), sampleRate, [&] {
+                       converter.reset();
+                       out.clear();
+                       for (int i = 0; i < secondFloat.size(); i += 256) {
+                           const int frames =
+                               std::min<int>(256, secondFloat.size() - i);
+                           converter.process(secondFloat.data() + i, frames,
+                                             out);
+                       }
+                       converter.process(nullptr, 0, out, true);
+                       bench::doNotOptimize(out.back());
+                   });
+    }
+
+    // The phoneme editor fits 20 ms frames at 10 kHz.
+    const auto downsampled = resample(voice, sampleRate, 10'000);
+    const std::vector<double> frame(downsampled.begin() + 5000,
+                                    downsampled.begin() + 5200);
+
+    runner.run("arma::fit (AR 10, MA 4, 200 samples)", frame.size(), 10'000,
+               [&] {
+                   bench::doNotOptimize(arma::fit(frame, 10, 4).ar.back());
+               });
+
+    runner.run("suanshu::FitBurgYule (AR 10, MA 4, 200 samples)",
+               frame.size(), 10'000, [&] {
+                   bench::doNotOptimize(
+                       suanshu::FitBurgYule(frame, 10, 4).AR(1));
+               });
+
+    // AR polynomials of consecutive frames, 50 ms apart.
+    std::vector<std::vector<double>> polys;
+    for (int start = 0; start + 200 < downsampled.size(); start += 500) {
+        const std::vector<double> x(downsampled.begin() + start,
+                                    downsampled.begin() + start + 200);
+        const auto model = suanshu::FitBurgYule(x, 10, 4);
+        std::vector<double> poly(11, 1.0);
+        for (int i = 0; i < 10; ++i) {
+            poly[i + 1] = model.AR(i + 1);
+        }
+        polys.push_back(std::move(poly));
+    }
+
+    runner.run("filter::solveRoots (AR 10, every frame)", polys.size(), 0,
+               [&] {
+                   for (const auto& poly : polys) {
+                       bench::doNotOptimize(
+                           filter::solveRoots(poly).front().real());
+                   }
+               });
+
+    runner.run("filter::solveRootsTracked (AR 10, every frame)",
+               polys.size(), 0, [&] {
+                   bench::doNotOptimize(
+                       filter::solveRootsTracked(polys).back()[0].real());
+               });
+
+    arma::frame_analyzer analyzer(10'000);
+    runner.run("arma::frame_analyzer::analyze (3.6 s)", downsampled.size(),
+               10'000, [&] {
+                   auto audio = downsampled;
+                   bench::doNotOptimize(
+                       analyzer.analyze(audio).back().intensity);
+               });
+}
+
+// Average number of iterations per frame of the root finder, started from
+// scratch and tracked from the previous frame.
+std::pair<double, double> rootIterations() {
+    generator::source_generator source(sampleRate);
+    filter::formant_filter vtf(sampleRate);
+    configureVoice(source, vtf);
+
+    std::vector<std::pair<int, int>> periods;
+    double Oq;
+    const auto voice = resample(
+        vtf.generateFrom(source.generate(periods, &Oq), periods, Oq),
+        sampleRate, 10'000);
+
+    filter::root_tracker cold, tracked;
+    double coldIterations = 0;
+    double trackedIterations = 0;
+    int frames = 0;
+
+    std::vector<double> poly(11, 1.0);
+    for (int start = 0; start + 200 < voice.size(); start += 500) {
+        const std::vector<double> x(voice.begin() + start,
+                                    voice.begin() + start + 200);
+        const auto model = suanshu::FitBurgYule(x, 10, 4);
+        for (int i = 0; i < 10; ++i) {
+            poly[i + 1] = model.AR(i + 1);
+        }
+
+        cold.reset();
+        cold.solve(poly);
+        tracked.solve(poly);
+
+        coldIterations += cold.iterations();
+        trackedIterations += tracked.iterations();
+        frames++;
+    }
+
+    return {coldIterations / frames, trackedIterations / frames};
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program
+              << " [--format text|csv|json] [--filter SUBSTRING]"
+                 " [--min-time SECONDS] [--output FILE]\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string format = "text";
+    std::string filter;
+    std::string outputPath;
+    double minTime = 0.5;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--format" && hasValue) {
+            format = argv[++i];
+        } else if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            minTime = std::stod(argv[++i]);
+        } else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    if (format != "text" && format != "csv" && format != "json") {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    bench::runner runner(minTime, filter);
+
+    benchSynthesis(runner);
+    benchFilters(runner);
+    benchPlans(runner);
+    benchSource(runner);
+    benchAnalysis(runner);
+
+    bench::info_list info = {
+        {"version", BABBLESYNTH_VERSION},
+#if defined(__clang__)
+        {"compiler", "clang " __clang_version__},
+#elif defined(__GNUC__)
+        {"compiler", "gcc " __VERSION__},
+#elif defined(_MSC_VER)
+        {"compiler", "msvc " + std::to_string(_MSC_VER)},
+#endif
+#ifdef NDEBUG
+        {"assertions", "off"},
+#else
+        {"assertions", "on"},
+#endif
+        {"hardware_threads",
+         std::to_string(std::thread::hardware_concurrency())},
+        {"sosfilt_batch_kernel", filter::sosfilt_batch_kernel()},
+    };
+
+    if (runner.selected("root_tracker iterations")) {
+        const auto iterations = rootIterations();
+        info.emplace_back("root_iterations_cold",
+                          std::to_string(iterations.first));
+        info.emplace_back("root_iterations_tracked",
+                          std::to_string(iterations.second));
+    }
+
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file) {
+            std::cerr << "Could not open " << outputPath << " for writing\n";
+            return 1;
+        }
+    }
+    std::ostream& out = outputPath.empty() ? std::cout : file;
+
+    if (format == "csv") {
+        bench::printCsv(out, runner.results());
+    } else if (format == "json") {
+        bench::printJson(out, info, runner.results());
+    } else {
+        bench::printText(out, info, runner.results());
+    }
+
+    return 0;
+}
@@ -19,89 +19,229 @@
 #include <babblesynth.h>
 #include <dr_wav.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
-
-#include "filter/formant_filter.h"
-#include "source/abstract_source.h"
-#include "variable_plan.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "manifest.h"
+
+using namespace babblesynth;
+
+namespace {
+
+void printUsage(const char *program) {
+    std::cerr
+        << "Usage: " << program << " [options] MANIFEST\n"
+        << "\n"
+        << "Renders every job of a manifest to a 16-bit WAV file. The\n"
+        << "manifest has one JSON object per line, or is a CSV file with a\n"
+        << "header row if its name ends in .csv.\n"
+        << "\n"
+        << "Options:\n"
+        << "  -r, --rate HZ          sample rate (default 48000)\n"
+        << "  -j, --threads N        worker threads (default: all cores)\n"
+        << "  -d, --dictionary FILE  compiled phoneme dictionary (.bsdict)\n"
+        << "                         for the jobs with a \"text\" field and\n"
+        << "                         no \"dictionary\" field\n"
+        << "  -p, --profile          print the time spent in each stage\n"
+        << "  -h, --help             show this help\n";
+}
+
+// Writes one job's output as it is rendered.
+class wav_writer {
+   public:
+    wav_writer(const std::string &path, int sampleRate) {
+        drwav_data_format format;
+        format.container = drwav_container_riff;
+        format.format = DR_WAVE_FORMAT_PCM;
+        format.channels = 1;
+        format.sampleRate = sampleRate;
+        format.bitsPerSample = 16;
+
+        if (!drwav_init_file_write(&m_wav, path.c_str(), &format, nullptr)) {
+            throw std::runtime_error("can't open " + path + " for writing");
+        }
+    }
+
+    ~wav_writer() { drwav_uninit(&m_wav); }
+
+    wav_writer(const wav_writer &) = delete;
+    wav_writer &operator=(const wav_writer &) = delete;
+
+    void write(const double *samples, int count) {
+        m_block.resize(count);
+        drwav_f64_to_s16(m_block.data(), samples, count);
+        if (drwav_write_pcm_frames(&m_wav, count, m_block.data()) != count) {
+            throw std::runtime_error("write error");
+        }
+    }
+
+   private:
+    drwav m_wav;
+    std::vector<int16_t> m_block;
+};
+
+int parseInt(const char *option, const char *value) {
+    char *end;
+    const long n = std::strtol(value, &end, 10);
+    if (*end != '\0' || n < 0) {
+        throw std::invalid_argument(std::string("invalid value for ") +
+                                    option);
+    }
+    return n;
+}
+
+}  // namespace
 
 int main(int argc, char *argv[]) {
     int sampleRate = 48'000;
-
-    std::cout << "Generating at " << sampleRate << " Hz sample rate\n";
-
-    babblesynth::generator::source_generator source(sampleRate);
-
-    babblesynth::variable_plan pitch(true, 130.81);
-    pitch.linearToValueAtTime(130.81, 0.6);
-    pitch.cubicToValueAtTime(164.81, 0.7);
-    pitch.linearToValueAtTime(164.81, 1.2);
-    pitch.cubicToValueAtTime(196.00, 1.3);
-    pitch.linearToValueAtTime(196.00, 1.8);
-    pitch.cubicToValueAtTime(246.94, 1.9);
-    pitch.linearToValueAtTime(246.94, 2.4);
-    pitch.cubicToValueAtTime(261.63, 2.5);
-    pitch.linearToValueAtTime(261.63, 3.6);
-
-    babblesynth::variable_plan amplitude(true, 1e-10);
-    amplitude.linearToValueAtTime(0.8, 0.1);
-    amplitude.linearToValueAtTime(1.0, 1.8);
-    amplitude.linearToValueAtTime(0.8, 3.5);
-    amplitude.linearToValueAtTime(0.2, 3.6);
-
-    source.getParameter("Source type")
-        .setValue(babblesynth::source::sources.valueOf("LF"));
-    source.getParameter("Pitch plan").setValue(pitch);
-    source.getParameter("Amplitude plan").setValue(amplitude);
-    source.getParameter("Jitter amplitude").setValue(2);
-
-    source.getSource()->getParameter("Oq").setValue(0.6);
-    source.getSource()->getParameter("am").setValue(0.8);
-    source.getSource()->getParameter("Qa").setValue(0.2);
-
-    std::vector<std::pair<int, int>> pitchPeriods;
-    std::vector<double> glottalSource = source.generate(pitchPeriods);
-
-    babblesynth::filter::formant_filter vtf(sampleRate);
-
-    babblesynth::variable_plan F1(false, 900);
-    babblesynth::variable_plan F2(false, 1300);
-    babblesynth::variable_plan F3(false, 2400);
-    babblesynth::variable_plan F4(false, 2800);
-    babblesynth::variable_plan F5(false, 3800);
-
-    F1.linearToValueAtTime(1100, 3.0);
-    F2.linearToValueAtTime(1400, 3.0);
-
-    vtf.getParameter("F1 plan").setValue(F1);
-    vtf.getParameter("F2 plan").setValue(F2);
-    vtf.getParameter("F3 plan").setValue(F3);
-    vtf.getParameter("F4 plan").setValue(F4);
-    vtf.getParameter("F5 plan").setValue(F5);
-
-    std::vector<double> output = vtf.generateFrom(glottalSource, pitchPeriods);
-
-    int frameCount = output.size();
-
-    std::cout << "Audio is " << frameCount << " samples long\n";
-
-    std::vector<int16_t> output_s16(frameCount);
-    drwav_f64_to_s16(output_s16.data(), output.data(), frameCount);
-
-    drwav_data_format format;
-    format.container = drwav_container_riff;
-    format.format = DR_WAVE_FORMAT_PCM;
-    format.channels = 1;
-    format.sampleRate = sampleRate;
-    format.bitsPerSample = 16;
-
-    drwav wav;
-    drwav_init_file_write(&wav, "output.wav", &format, nullptr);
-    drwav_write_pcm_frames(&wav, frameCount, output_s16.data());
-    drwav_uninit(&wav);
-
-    std::cout << "Written to output.wav\n";
-    std::cout << std::flush;
+    int numThreads = 0;
+    bool profile = false;
+    std::string dictionaryPath;
+    std::string manifestPath;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "-h" || arg == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            } else if ((arg == "-r" || arg == "--rate") && hasValue) {
+                sampleRate = parseInt(argv[i], argv[i + 1]);
+                ++i;
+            } else if ((arg == "-j" || arg == "--threads") && hasValue) {
+                numThreads = parseInt(argv[i], argv[i + 1]);
+                ++i;
+            } else if ((arg == "-d" || arg == "--dictionary") && hasValue) {
+                dictionaryPath = argv[++i];
+            } else if (arg == "-p" || arg == "--profile") {
+                profile = true;
+            } else if (arg[0] != '-' && manifestPath.empty()) {
+                manifestPath = arg;
+            } else {
+                printUsage(argv[0]);
+                return 2;
+            }
+        }
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+
+    if (manifestPath.empty() || sampleRate <= 0) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    try {
+        std::unique_ptr<dictionary::compiled_dictionary> dictionary;
+        if (!dictionaryPath.empty()) {
+            dictionary = std::make_unique<dictionary::compiled_dictionary>(
+                dictionaryPath);
+        }
+
+        // Dictionaries named by the jobs themselves, loaded once each.
+        std::map<std::string, std::unique_ptr<dictionary::compiled_dictionary>>
+            jobDictionaries;
+
+        cli::manifest_options options;
+        options.sampleRate = sampleRate;
+        options.dictionary = dictionary.get();
+        options.loadDictionary = [&jobDictionaries](const std::string &path) {
+            auto &loaded = jobDictionaries[path];
+            if (!loaded) {
+                loaded =
+                    std::make_unique<dictionary::compiled_dictionary>(path);
+            }
+            return loaded.get();
+        };
+
+        const auto jobs = cli::readManifest(manifestPath, options);
+
+        std::vector<render_job> renderJobs;
+        renderJobs.reserve(jobs.size());
+        for (const auto &job : jobs) {
+            renderJobs.push_back(job.job);
+        }
+
+        batch_renderer batch(sampleRate, numThreads);
+
+        std::cout << "Rendering " << jobs.size() << " jobs at " << sampleRate
+                  << " Hz on " << batch.numThreads() << " threads\n"
+                  << std::flush;
+
+        // Files are opened on their first block so that only the jobs being
+        // rendered hold one open. Each slot is only touched by the thread
+        // rendering that job.
+        std::vector<std::unique_ptr<wav_writer>> writers(jobs.size());
+        std::vector<long long> lengths(jobs.size(), 0);
+
+        std::atomic<long long> totalSamples = 0;
+        std::atomic<int> jobsDone = 0;
+        std::mutex printMutex;
+
+        profiler::setEnabled(profile);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        batch.render(renderJobs, [&](const int index, const double *samples,
+                                     const int count) {
+            auto &writer = writers[index];
+            if (!writer) {
+                writer = std::make_unique<wav_writer>(jobs[index].output,
+                                                      sampleRate);
+            }
+
+            if (count > 0) {
+                writer->write(samples, count);
+                lengths[index] += count;
+                return;
+            }
+
+            writer.reset();
+            totalSamples += lengths[index];
+
+            const int done = ++jobsDone;
+
+            std::lock_guard lock(printMutex);
+            std::cout << "[" << done << "/" << jobs.size() << "] "
+                      << jobs[index].output << " (" << std::fixed
+                      << std::setprecision(2)
+                      << lengths[index] / double(sampleRate) << " s)\n";
+        });
+
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        const double wallTime = std::max(elapsed.count(), 1e-9);
+        const double audioTime = totalSamples / double(sampleRate);
+
+        std::cout << std::fixed << std::setprecision(2) << "Rendered "
+                  << jobs.size() << " jobs, " << audioTime << " s of audio in "
+                  << wallTime << " s\n"
+                  << "  " << jobs.size() / wallTime << " jobs/s, "
+                  << audioTime / wallTime << "x real time\n";
+
+        if (profile) {
+            // Summed over the worker threads.
+            std::cout << "\n";
+            profiler::print(std::cout);
+        }
+        std::cout << std::flush;
+    } catch (const std::exception &e) {
+        std::cerr << "babblesynth-cli: " << e.what() << "\n";
+        return 1;
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,777 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "manifest.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+
+using namespace babblesynth;
+using namespace babblesynth::cli;
+
+namespace {
+
+struct plan_point {
+    double time;
+    double value;
+    variable_plan::transition transition;
+};
+
+// A field of a job. JSON numbers and lists are parsed as they are read, JSON
+// strings and CSV cells are kept as text and parsed when they are used.
+struct field {
+    enum kind { number, text, points } kind;
+    double value;
+    std::string string;
+    std::vector<plan_point> plan;
+};
+
+using job_fields = std::map<std::string, field>;
+
+std::runtime_error lineError(const int line, const std::string& what) {
+    return std::runtime_error("line " + std::to_string(line) + ": " + what);
+}
+
+bool parseNumber(const std::string& text, double& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    value = std::strtod(text.c_str(), &end);
+    return *end == '\0' && errno == 0;
+}
+
+variable_plan::transition parseTransition(const std::string& name) {
+    if (name == "linear") {
+        return variable_plan::TransitionLinear;
+    } else if (name == "cubic") {
+        return variable_plan::TransitionCubic;
+    } else if (name == "step") {
+        return variable_plan::TransitionStep;
+    }
+    throw std::invalid_argument("unknown segment type \"" + name + "\"");
+}
+
+// Minimal JSON reader, enough for one object per line.
+class json_reader {
+   public:
+    explicit json_reader(const std::string& text) : m_text(text), m_pos(0) {}
+
+    job_fields readObject() {
+        job_fields fields;
+        readObjectInto(fields, "");
+        skipSpace();
+        if (m_pos != m_text.size()) {
+            fail("unexpected text after the object");
+        }
+        return fields;
+    }
+
+   private:
+    void readObjectInto(job_fields& fields, const std::string& prefix) {
+        expect('{');
+        if (consume('}')) {
+            return;
+        }
+        do {
+            const std::string key = prefix + readString();
+            expect(':');
+            skipSpace();
+            if (peek() == '{') {
+                readObjectInto(fields, key + ".");
+            } else if (!fields.emplace(key, readValue()).second) {
+                fail("duplicate field \"" + key + "\"");
+            }
+        } while (consume(','));
+        expect('}');
+    }
+
+    field readValue() {
+        skipSpace();
+        const char c = peek();
+        if (c == '"') {
+            return {field::text, 0, readString(), {}};
+        } else if (c == '[') {
+            return {field::points, 0, {}, readPoints()};
+        } else if (matchWord("true")) {
+            return {field::number, 1, {}, {}};
+        } else if (matchWord("false")) {
+            return {field::number, 0, {}, {}};
+        }
+        return {field::number, readNumber(), {}, {}};
+    }
+
+    std::vector<plan_point> readPoints() {
+        std::vector<plan_point> plan;
+        expect('[');
+        if (consume(']')) {
+            return plan;
+        }
+        do {
+            expect('[');
+            plan_point point{readNumber(), 0, variable_plan::TransitionLinear};
+            expect(',');
+            point.value = readNumber();
+            if (consume(',')) {
+                try {
+                    point.transition = parseTransition(readString());
+                } catch (const std::invalid_argument& e) {
+                    fail(e.what());
+                }
+            }
+            expect(']');
+            plan.push_back(point);
+        } while (consume(','));
+        expect(']');
+        return plan;
+    }
+
+    double readNumber() {
+        skipSpace();
+        const size_t start = m_pos;
+        while (m_pos < m_text.size() &&
+               std::string_view("+-.0123456789eE").find(m_text[m_pos]) !=
+                   std::string_view::npos) {
+            ++m_pos;
+        }
+        double value;
+        if (!parseNumber(m_text.substr(start, m_pos - start), value)) {
+            m_pos = start;
+            fail("expected a number");
+        }
+        return value;
+    }
+
+    std::string readString() {
+        expect('"');
+        std::string out;
+        while (true) {
+            if (m_pos >= m_text.size()) {
+                fail("unterminated string");
+            }
+            const char c = m_text[m_pos++];
+            if (c == '"') {
+                return out;
+            } else if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (m_pos >= m_text.size()) {
+                fail("unterminated string");
+            }
+            switch (const char e = m_text[m_pos++]) {
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u':
+                    appendUtf8(out, readCodePoint());
+                    break;
+                default:
+                    out += e;
+                    break;
+            }
+        }
+    }
+
+    // After "\u", combines surrogate pairs.
+    char32_t readCodePoint() {
+        char32_t c = readHex4();
+        if (c >= 0xD800 && c < 0xDC00 && m_text.compare(m_pos, 2, "\\u") == 0) {
+            m_pos += 2;
+            const char32_t low = readHex4();
+            if (low < 0xDC00 || low >= 0xE000) {
+                fail("invalid surrogate pair");
+            }
+            c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        }
+        return c;
+    }
+
+    char32_t readHex4() {
+        if (m_pos + 4 > m_text.size()) {
+            fail("invalid \\u escape");
+        }
+        char32_t c = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char h = m_text[m_pos++];
+            c <<= 4;
+            if (h >= '0' && h <= '9') {
+                c |= h - '0';
+            } else if (h >= 'a' && h <= 'f') {
+                c |= h - 'a' + 10;
+            } else if (h >= 'A' && h <= 'F') {
+                c |= h - 'A' + 10;
+            } else {
+                fail("invalid \\u escape");
+            }
+        }
+        return c;
+    }
+
+    static void appendUtf8(std::string& out, const char32_t c) {
+        if (c < 0x80) {
+            out += char(c);
+        } else if (c < 0x800) {
+            out += char(0xC0 | (c >> 6));
+            out += char(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += char(0xE0 | (c >> 12));
+            out += char(0x80 | ((c >> 6) & 0x3F));
+            out += char(0x80 | (c & 0x3F));
+        } else {
+            out += char(0xF0 | (c >> 18));
+            out += char(0x80 | ((c >> 12) & 0x3F));
+            out += char(0x80 | ((c >> 6) & 0x3F));
+            out += char(0x80 | (c & 0x3F));
+        }
+    }
+
+    void skipSpace() {
+        while (m_pos < m_text.size() &&
+               std::string_view(" \t\r\n").find(m_text[m_pos]) !=
+                   std::string_view::npos) {
+            ++m_pos;
+        }
+    }
+
+    char peek() const { return m_pos < m_text.size() ? m_text[m_pos] : '\0'; }
+
+    bool consume(const char c) {
+        skipSpace();
+        if (peek() == c) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const char c) {
+        if (!consume(c)) {
+            fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    bool matchWord(const char* word) {
+        const size_t length = std::char_traits<char>::length(word);
+        if (m_text.compare(m_pos, length, word) == 0) {
+            m_pos += length;
+            return true;
+        }
+        return false;
+    }
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::invalid_argument(what + " at column " +
+                                    std::to_string(m_pos + 1));
+    }
+
+    const std::string& m_text;
+    size_t m_pos;
+};
+
+// Splits one CSV row, with double quotes around cells that contain commas or
+// quotes, and "" for a quote inside them.
+std::vector<std::string> splitCsv(const std::string& line) {
+    std::vector<std::string> cells(1);
+    bool quoted = false;
+
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (quoted) {
+            if (c != '"') {
+                cells.back() += c;
+            } else if (i + 1 < line.size() && line[i + 1] == '"') {
+                cells.back() += '"';
+                ++i;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            cells.emplace_back();
+        } else if (c != '\r') {
+            cells.back() += c;
+        }
+    }
+
+    if (quoted) {
+        throw std::invalid_argument("unterminated quoted cell");
+    }
+    return cells;
+}
+
+// "0:220 0.5:240:cubic 1.2:200", points may also be separated by ';'.
+std::vector<plan_point> parsePoints(const std::string& text) {
+    std::vector<plan_point> plan;
+
+    size_t pos = 0;
+    while (true) {
+        pos = text.find_first_not_of(" \t;", pos);
+        if (pos == std::string::npos) {
+            break;
+        }
+        const size_t end = std::min(text.find_first_of(" \t;", pos),
+                                    text.size());
+        const std::string point = text.substr(pos, end - pos);
+        pos = end;
+
+        const size_t colon = point.find(':');
+        const size_t colon2 = point.find(':', colon + 1);
+
+        plan_point p{0, 0, variable_plan::TransitionLinear};
+        if (colon == std::string::npos ||
+            !parseNumber(point.substr(0, colon), p.time) ||
+            !parseNumber(point.substr(colon + 1, colon2 - colon - 1),
+                         p.value)) {
+            throw std::invalid_argument("invalid plan point \"" + point +
+                                        "\"");
+        }
+        if (colon2 != std::string::npos) {
+            p.transition = parseTransition(point.substr(colon2 + 1));
+        }
+        plan.push_back(p);
+    }
+
+    return plan;
+}
+
+double toNumber(const std::string& key, const field& f) {
+    double value;
+    if (f.kind == field::number) {
+        return f.value;
+    } else if (f.kind == field::text && parseNumber(f.string, value)) {
+        return value;
+    }
+    throw std::invalid_argument("\"" + key + "\" must be a number");
+}
+
+// `plan` holds the default, which sets whether the plan is piecewise
+// monotonic.
+void toPlan(const std::string& key, const field& f, variable_plan& plan) {
+    double constant;
+    std::vector<plan_point> points;
+
+    if (f.kind == field::points) {
+        points = f.plan;
+    } else if (f.kind == field::number) {
+        plan.reset(f.value);
+        return;
+    } else if (parseNumber(f.string, constant)) {
+        plan.reset(constant);
+        return;
+    } else {
+        points = parsePoints(f.string);
+    }
+
+    if (points.empty() || points.front().time != 0) {
+        throw std::invalid_argument("the plan \"" + key +
+                                    "\" must start at time 0");
+    }
+
+    plan.reset(points.front().value);
+    for (size_t i = 1; i < points.size(); ++i) {
+        const auto& [time, value, transition] = points[i];
+        if (time <= points[i - 1].time) {
+            throw std::invalid_argument("the times of the plan \"" + key +
+                                        "\" must increase");
+        }
+        switch (transition) {
+            case variable_plan::TransitionStep:
+                plan.stepToValueAtTime(value, time);
+                break;
+            case variable_plan::TransitionLinear:
+                plan.linearToValueAtTime(value, time);
+                break;
+            case variable_plan::TransitionCubic:
+                plan.cubicToValueAtTime(value, time);
+                break;
+        }
+    }
+}
+
+std::u16string toUtf16(const std::string& text) {
+    std::u16string out;
+    out.reserve(text.size());
+
+    for (size_t i = 0; i < text.size();) {
+        const unsigned char c = text[i];
+        const int length = c < 0x80          ? 1
+                           : (c >> 5) == 0x6 ? 2
+                           : (c >> 4) == 0xE ? 3
+                           : (c >> 3) == 0x1E ? 4
+                                              : 0;
+        if (length == 0 || i + length > text.size()) {
+            throw std::invalid_argument("the text is not valid UTF-8");
+        }
+
+        char32_t cp = length == 1 ? c : c & (0x7F >> length);
+        for (int k = 1; k < length; ++k) {
+            const unsigned char cc = text[i + k];
+            if ((cc >> 6) != 0x2) {
+                throw std::invalid_argument("the text is not valid UTF-8");
+            }
+            cp = (cp << 6) | (cc & 0x3F);
+        }
+        i += length;
+
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            out += char16_t(0xD800 + (cp >> 10));
+            out += char16_t(0xDC00 + (cp & 0x3FF));
+        } else {
+            out += char16_t(cp);
+        }
+    }
+
+    return out;
+}
+
+// Same plans as the Animal Crossing voice of the GUI.
+void planText(const dictionary::compiled_dictionary& dictionary,
+              const std::string& text, const double pitch,
+              const double phonemeDuration, render_job& job) {
+    job.pitchPlan.reset(pitch);
+    job.amplitudePlan.reset(0);
+
+    double time = 0.1;
+
+    job.amplitudePlan.linearToValueAtTime(0, time);
+
+    std::map<std::string, variable_plan>& plans = job.filterPlans;
+
+    const double formants[] = {700, 1200, 2400, 2900, 4200};
+    for (int i = 0; i < 5; ++i) {
+        const std::string n = std::to_string(i + 1);
+        plans.at("F" + n + " plan").reset(formants[i]);
+        plans.at("B" + n + " plan").reset(80 + i * 15);
+    }
+
+    plans.at("AF1 plan").reset(400);
+    plans.at("AB1 plan").reset(80);
+    plans.at("AF2 plan").reset(1200);
+    plans.at("AB2 plan").reset(110);
+
+    const auto planFor = [&plans](const std::string& prefix,
+                                  const int i) -> variable_plan& {
+        const auto it = plans.find(prefix + std::to_string(i + 1) + " plan");
+        if (it == plans.end()) {
+            throw std::invalid_argument("the dictionary uses a " + prefix +
+                                        std::to_string(i + 1) +
+                                        " which the formant filter lacks");
+        }
+        return it->second;
+    };
+
+    const auto updatePlans = [&](const size_t phoneme, const double at) {
+        const auto poles = dictionary.poles(phoneme);
+        for (size_t k = 0; k < poles.size(); ++k) {
+            const int i = poles[k].index >= 0 ? poles[k].index : k;
+            planFor("F", i).cubicToValueAtTime(poles[k].frequency, at);
+        }
+        const auto zeros = dictionary.zeros(phoneme);
+        for (size_t k = 0; k < zeros.size(); ++k) {
+            const int i = zeros[k].index >= 0 ? zeros[k].index : k;
+            planFor("AF", i).cubicToValueAtTime(zeros[k].frequency, at);
+        }
+    };
+
+    std::mt19937 rng(std::hash<std::string>{}(text));
+
+    std::normal_distribution<double> durationFactorDis(1.0, 0.02);
+
+    for (const auto& match : dictionary.matchMappings(toUtf16(text))) {
+        for (const auto& entry : dictionary.entries(match.mapping)) {
+            if (entry.duration <= 0) {
+                continue;
+            }
+
+            const double durationFactor =
+                std::min(std::max(durationFactorDis(rng), 0.75), 1.25);
+
+            const double duration = entry.duration * durationFactor;
+            const double transition =
+                duration * std::max(phonemeDuration * 0.1, 20.0 / 1000.0);
+
+            job.amplitudePlan.cubicToValueAtTime(
+                entry.intensity, time + duration * 15.0 / 1000.0);
+            updatePlans(entry.phoneme, time + transition);
+
+            time += duration * phonemeDuration;
+
+            job.amplitudePlan.cubicToValueAtTime(
+                entry.intensity, time - duration * 15.0 / 1000.0);
+            updatePlans(entry.phoneme, time - transition);
+        }
+    }
+
+    job.pitchPlan.linearToValueAtTime(pitch, time);
+}
+
+bool isNumeric(const parameter& param) {
+    const std::string type = param.type();
+    return type == "int" || type == "double" || type == "bool";
+}
+
+class job_builder {
+   public:
+    explicit job_builder(const manifest_options& options)
+        : m_options(options),
+          m_source(options.sampleRate),
+          m_filter(options.sampleRate) {
+        for (const auto& name : m_filter.getParameterNames()) {
+            const auto& param = m_filter.getParameter(name);
+            if (std::string(param.type()) == "var_plan") {
+                m_defaults.filterPlans.emplace(
+                    name, param.value<variable_plan>());
+            }
+        }
+    }
+
+    manifest_job build(const int line, job_fields fields) {
+        manifest_job out{line, "", m_defaults};
+        render_job& job = out.job;
+
+        if (m_options.withOutput) {
+            out.output = take(fields, "output").string;
+            if (out.output.empty()) {
+                throw std::invalid_argument("\"output\" is required");
+            }
+        }
+
+        const dictionary::compiled_dictionary* dictionary =
+            m_options.dictionary;
+        if (m_options.loadDictionary && fields.count("dictionary") > 0) {
+            dictionary =
+                m_options.loadDictionary(take(fields, "dictionary").string);
+        }
+
+        field f;
+        if (get(fields, "text", f)) {
+            if (dictionary == nullptr) {
+                throw std::invalid_argument(
+                    "text needs a phoneme dictionary (--dictionary)");
+            }
+
+            double pitch = 420;
+            double duration = 70;
+            if (get(fields, "pitch", f)) {
+                pitch = toNumber("pitch", f);
+            }
+            if (get(fields, "duration", f)) {
+                duration = toNumber("duration", f);
+            }
+            planText(*dictionary, take(fields, "text").string, pitch,
+                     duration / 1000.0, job);
+        } else if (get(fields, "pitch", f)) {
+            toPlan("pitch", f, job.pitchPlan);
+        }
+
+        if (get(fields, "amplitude", f)) {
+            toPlan("amplitude", f, job.amplitudePlan);
+        }
+
+        for (const auto& [key, value] : fields) {
+            const size_t dot = key.find('.');
+            const std::string group = key.substr(0, dot);
+            const std::string name =
+                dot != std::string::npos ? key.substr(dot + 1) : "";
+
+            if (key == "text" || key == "pitch" || key == "duration" ||
+                key == "amplitude") {
+                continue;
+            } else if (group == "filter") {
+                const auto it = job.filterPlans.find(name + " plan");
+                if (it == job.filterPlans.end()) {
+                    throw std::invalid_argument("unknown filter plan \"" +
+                                                name + "\"");
+                }
+                toPlan(key, value, it->second);
+            } else if (group == "generator") {
+                checkNumeric(m_source, key, name);
+                job.generatorParameters[name] = toNumber(key, value);
+            } else if (group == "source") {
+                checkNumeric(*m_source.getSource(), key, name);
+                job.sourceParameters[name] = toNumber(key, value);
+            } else {
+                throw std::invalid_argument("unknown field \"" + key + "\"");
+            }
+        }
+
+        if (job.pitchPlan.duration() <= 0) {
+            throw std::invalid_argument("the pitch plan has no duration");
+        }
+
+        return out;
+    }
+
+   private:
+    static bool get(const job_fields& fields, const std::string& key,
+                    field& f) {
+        const auto it = fields.find(key);
+        if (it == fields.end()) {
+            return false;
+        }
+        f = it->second;
+        return true;
+    }
+
+    static field take(job_fields& fields, const std::string& key) {
+        const auto it = fields.find(key);
+        if (it == fields.end()) {
+            return {field::text, 0, {}, {}};
+        }
+        if (it->second.kind != field::text) {
+            throw std::invalid_argument("\"" + key + "\" must be a string");
+        }
+        field f = std::move(it->second);
+        fields.erase(it);
+        return f;
+    }
+
+    static void checkNumeric(const parameter_holder& holder,
+                             const std::string& key, const std::string& name) {
+        const auto names = holder.getParameterNames();
+        if (std::find(names.begin(), names.end(), name) == names.end() ||
+            !isNumeric(holder.getParameter(name))) {
+            throw std::invalid_argument("unknown numeric parameter \"" + key +
+                                        "\"");
+        }
+    }
+
+    manifest_options m_options;
+
+    // Only used to look up parameter names.
+    generator::source_generator m_source;
+    filter::formant_filter m_filter;
+
+    render_job m_defaults;
+};
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+std::vector<manifest_job> babblesynth::cli::readManifest(
+    const std::string& filename, const manifest_options& options) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("can't open the manifest " + filename);
+    }
+
+    std::string lower = filename;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    const bool isCsv = endsWith(lower, ".csv");
+
+    job_builder builder(options);
+
+    std::vector<manifest_job> jobs;
+    std::vector<std::string> header;
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        try {
+            if (!isCsv) {
+                jobs.push_back(builder.build(
+                    lineNumber, json_reader(line).readObject()));
+                continue;
+            }
+
+            auto cells = splitCsv(line);
+            if (header.empty()) {
+                for (auto& name : cells) {
+                    const size_t begin = name.find_first_not_of(' ');
+                    const size_t end = name.find_last_not_of(' ');
+                    header.push_back(begin != std::string::npos
+                                         ? name.substr(begin, end + 1 - begin)
+                                         : "");
+                }
+                continue;
+            }
+            if (cells.size() > header.size()) {
+                throw std::invalid_argument("more cells than in the header");
+            }
+
+            job_fields fields;
+            for (size_t i = 0; i < cells.size(); ++i) {
+                // Empty cells keep the default.
+                if (!cells[i].empty()) {
+                    fields[header[i]] = {field::text, 0, cells[i], {}};
+                }
+            }
+            jobs.push_back(builder.build(lineNumber, std::move(fields)));
+        } catch (const std::invalid_argument& e) {
+            throw lineError(lineNumber, e.what());
+        } catch (const std::out_of_range& e) {
+            throw lineError(lineNumber, e.what());
+        }
+    }
+
+    return jobs;
+}
+
+struct job_parser::impl {
+    explicit impl(const manifest_options& options) : builder(options) {}
+
+    job_builder builder;
+    int line = 0;
+};
+
+job_parser::job_parser(const manifest_options& options)
+    : m_impl(std::make_unique<impl>(options)) {}
+
+job_parser::~job_parser() = default;
+
+manifest_job job_parser::parse(const std::string& json) {
+    try {
+        return m_impl->builder.build(++m_impl->line,
+                                     json_reader(json).readObject());
+    } catch (const std::out_of_range& e) {
+        throw std::invalid_argument(e.what());
+    }
+}
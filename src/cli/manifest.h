@@ -0,0 +1,103 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BABBLESYNTH_CLI_MANIFEST_H
+#define BABBLESYNTH_CLI_MANIFEST_H
+
+#include <babblesynth.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace babblesynth {
+namespace cli {
+
+// A job manifest lists one utterance per line, either as a JSON object (JSON
+// lines) or, if the file name ends in ".csv", as a CSV row under a header row
+// which names the fields. Blank lines and lines starting with '#' are
+// skipped. The fields of a job are:
+//
+//  - "output": path of the WAV file to write, required.
+//  - "text": text to read with the phoneme dictionary. It sets the pitch,
+//    amplitude and formant plans, the way the Animal Crossing voice does.
+//  - "dictionary": compiled dictionary for the text, if the reader allows
+//    it (see manifest_options::loadDictionary).
+//  - "pitch": pitch plan, or the pitch in Hz for text (420 by default).
+//  - "duration": length of a phoneme for text, in ms (70 by default).
+//  - "amplitude": amplitude plan.
+//  - "filter.F1", "filter.AB2", ...: formant filter plans.
+//  - "generator.Jitter", ...: numeric source generator parameters.
+//  - "source.Oq", ...: numeric glottal source parameters.
+//
+// In JSON, the dotted fields can also be written as nested objects, e.g.
+// "source": {"Oq": 0.6}. A plan is either a constant, or a list of points
+// which starts at time 0:
+//
+//   JSON: [[0, 220], [0.5, 240, "cubic"], [1.2, 200]]
+//   CSV:  "0:220 0.5:240:cubic 1.2:200"
+//
+// Each point is reached from the previous one with a "linear" (the default),
+// "cubic" or "step" segment. Plans given explicitly replace the ones derived
+// from the text.
+struct manifest_job {
+    int line;
+    std::string output;
+    render_job job;
+};
+
+struct manifest_options {
+    int sampleRate;
+
+    // Required by the jobs which have a "text" field.
+    const dictionary::compiled_dictionary* dictionary = nullptr;
+
+    // When set, a job can name its own dictionary, which is looked up with
+    // this function instead of using the one above.
+    std::function<const dictionary::compiled_dictionary*(const std::string&)>
+        loadDictionary;
+
+    // When cleared, jobs have no "output" field.
+    bool withOutput = true;
+};
+
+// Throws std::runtime_error with the line number for any invalid job,
+// before anything is rendered.
+std::vector<manifest_job> readManifest(const std::string& filename,
+                                       const manifest_options& options);
+
+// Reads JSON jobs one at a time, e.g. as they arrive from a client.
+class job_parser {
+   public:
+    explicit job_parser(const manifest_options& options);
+    ~job_parser();
+
+    // Throws std::invalid_argument if the job is invalid, and whatever
+    // manifest_options::loadDictionary throws.
+    manifest_job parse(const std::string& json);
+
+   private:
+    struct impl;
+    std::unique_ptr<impl> m_impl;
+};
+
+}  // namespace cli
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_CLI_MANIFEST_H
@@ -0,0 +1,220 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QTemporaryDir>
+#include <QtTest>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "manifest.h"
+
+using namespace babblesynth;
+using namespace babblesynth::cli;
+
+class ManifestTest : public QObject {
+    Q_OBJECT
+
+   public:
+    ManifestTest();
+
+   private slots:
+    void readsJsonLines();
+    void readsCsv();
+    void decodesUtf8Text();
+    void reportsTheLineOfAnError();
+    void rejectsInvalidJobs();
+
+   private:
+    std::string writeFile(const std::string &name, const std::string &text);
+
+    // Whether the job parses, or is rejected as invalid.
+    bool parses(const std::string &json);
+
+    // Duration of the plans made from the text, 0.1 s if nothing matched.
+    double textDuration(const std::string &json);
+
+    static constexpr int sampleRate = 48000;
+
+    QTemporaryDir m_dir;
+    std::unique_ptr<dictionary::compiled_dictionary> m_dictionary;
+    manifest_options m_options;
+};
+
+ManifestTest::ManifestTest() {
+    dictionary::dictionary_builder builder;
+    const uint32_t a = builder.addPhoneme(u"a", {{700, 130, -1, 0}}, {});
+    for (const std::u16string_view name : {u"a", u"\u00e9", u"\U0001F600"}) {
+        builder.addMapping(name, {{1.0, 1.0, a, 0}});
+    }
+
+    const std::string path = m_dir.filePath("test.bsdict").toStdString();
+    builder.write(path);
+    m_dictionary = std::make_unique<dictionary::compiled_dictionary>(path);
+
+    m_options.sampleRate = sampleRate;
+    m_options.dictionary = m_dictionary.get();
+}
+
+std::string ManifestTest::writeFile(const std::string &name,
+                                    const std::string &text) {
+    const std::string path =
+        m_dir.filePath(QString::fromStdString(name)).toStdString();
+    std::ofstream(path) << text;
+    return path;
+}
+
+bool ManifestTest::parses(const std::string &json) {
+    manifest_options options = m_options;
+    options.withOutput = false;
+    try {
+        job_parser(options).parse(json);
+        return true;
+    } catch (const std::invalid_argument &) {
+        return false;
+    }
+}
+
+double ManifestTest::textDuration(const std::string &json) {
+    manifest_options options = m_options;
+    options.withOutput = false;
+    return job_parser(options).parse(json).job.pitchPlan.duration();
+}
+
+void ManifestTest::readsJsonLines() {
+    const auto jobs = readManifest(
+        writeFile("jobs.jsonl",
+                  "# comment\n"
+                  "\n"
+                  R"({"output": "a.wav", "pitch": [[0, 220], )"
+                  R"([0.5, 240, "cubic"], [1, 200, "step"]], )"
+                  R"("amplitude": 0.5, "filter.F1": 800, )"
+                  R"("source": {"Oq": 0.6}, "generator": {"Jitter": 0.1}})"
+                  "\n"
+                  R"({"output": "b \"quoted\".wav", "pitch": "0:100 2:100"})"
+                  "\n"),
+        m_options);
+
+    QCOMPARE(jobs.size(), size_t(2));
+
+    const manifest_job &a = jobs[0];
+    QCOMPARE(a.line, 3);
+    QCOMPARE(a.output, std::string("a.wav"));
+    QCOMPARE(a.job.pitchPlan.duration(), 1.0);
+    QCOMPARE(a.job.pitchPlan.evaluateAtTime(0.5), 240.0);
+    QCOMPARE(a.job.amplitudePlan.evaluateAtTime(0.7), 0.5);
+    QCOMPARE(a.job.filterPlans.at("F1 plan").evaluateAtTime(0.3), 800.0);
+    QCOMPARE(a.job.sourceParameters.at("Oq"), 0.6);
+    QCOMPARE(a.job.generatorParameters.at("Jitter"), 0.1);
+
+    // Plans can also be given as text, like in CSV.
+    const manifest_job &b = jobs[1];
+    QCOMPARE(b.line, 4);
+    QCOMPARE(b.output, std::string("b \"quoted\".wav"));
+    QCOMPARE(b.job.pitchPlan.duration(), 2.0);
+}
+
+void ManifestTest::readsCsv() {
+    const auto jobs = readManifest(
+        writeFile("jobs.csv",
+                  "output, pitch, source.Oq, filter.F2\r\n"
+                  "\"a,b.wav\",0:220 0.5:240:cubic 1:200,0.6,\r\n"
+                  "# comment\r\n"
+                  "b.wav,\"0:100;2:100\",,1500\r\n"),
+        m_options);
+
+    QCOMPARE(jobs.size(), size_t(2));
+
+    const manifest_job &a = jobs[0];
+    QCOMPARE(a.line, 2);
+    QCOMPARE(a.output, std::string("a,b.wav"));
+    QCOMPARE(a.job.pitchPlan.evaluateAtTime(0.5), 240.0);
+    QCOMPARE(a.job.pitchPlan.duration(), 1.0);
+    QCOMPARE(a.job.sourceParameters.at("Oq"), 0.6);
+
+    // Empty cells keep the default.
+    const manifest_job &b = jobs[1];
+    QCOMPARE(b.line, 4);
+    QCOMPARE(b.job.pitchPlan.duration(), 2.0);
+    QCOMPARE(b.job.sourceParameters.count("Oq"), size_t(0));
+    QCOMPARE(b.job.filterPlans.at("F2 plan").evaluateAtTime(1), 1500.0);
+}
+
+void ManifestTest::decodesUtf8Text() {
+    const double unmatched = textDuration(R"({"text": "zz"})");
+    QCOMPARE(unmatched, 0.1);
+
+    // The phoneme durations vary with a seed taken from the text, so only
+    // the same decoded text gives the same plans.
+    const double e = textDuration("{\"text\": \"\xc3\xa9\"}");
+    QVERIFY(e > unmatched);
+    QCOMPARE(textDuration(R"({"text": "\u00e9"})"), e);
+    QCOMPARE(textDuration(R"({"text": "\u00E9"})"), e);
+
+    // Outside of the BMP, as a surrogate pair in UTF-16.
+    const double emoji = textDuration("{\"text\": \"\xf0\x9f\x98\x80\"}");
+    QVERIFY(emoji > unmatched);
+    QCOMPARE(textDuration(R"({"text": "\ud83d\ude00"})"), emoji);
+
+    // Case is ignored, as with the XML dictionaries.
+    QVERIFY(textDuration("{\"text\": \"\xc3\x89\"}") > unmatched);
+
+    QVERIFY(!parses("{\"text\": \"\xff\"}"));
+    QVERIFY(!parses("{\"text\": \"\xc3\"}"));
+    QVERIFY(!parses("{\"text\": \"\xc3(\"}"));
+    QVERIFY(!parses(R"({"text": "\ud83d\u0041"})"));
+    QVERIFY(!parses(R"({"text": "\u00g9"})"));
+}
+
+void ManifestTest::reportsTheLineOfAnError() {
+    const std::string path = writeFile(
+        "bad.jsonl", "{\"output\": \"a.wav\"}\n\n{\"output\": \"b.wav\", "
+                     "\"pitch\": [[0.5, 220]]}\n");
+
+    try {
+        readManifest(path, m_options);
+        QFAIL("the manifest was accepted");
+    } catch (const std::runtime_error &e) {
+        QCOMPARE(std::string(e.what()),
+                 std::string("line 3: the plan \"pitch\" must start at "
+                             "time 0"));
+    }
+}
+
+void ManifestTest::rejectsInvalidJobs() {
+    QVERIFY(parses(R"({})"));
+
+    QVERIFY(!parses(R"({"output": "a.wav"})"));
+    QVERIFY(!parses(R"({"bogus": 1})"));
+    QVERIFY(!parses(R"({"pitch": 220, "pitch": 230})"));
+    QVERIFY(!parses(R"({"pitch": 220} trailing)"));
+    QVERIFY(!parses(R"({"pitch": "unterminated})"));
+    QVERIFY(!parses(R"({"pitch": [[0, 220], [0, 230]]})"));
+    QVERIFY(!parses(R"({"pitch": [[0, 220], [1, 230, "sine"]]})"));
+    QVERIFY(!parses(R"({"pitch": "0:220 1"})"));
+    QVERIFY(!parses(R"({"pitch": 0})"));
+    QVERIFY(!parses(R"({"filter.F9": 800})"));
+    QVERIFY(!parses(R"({"source.Oq": "high"})"));
+    QVERIFY(!parses(R"({"generator.Pitch plan": 1})"));
+    QVERIFY(!parses(R"({"source": {"nope": 1}})"));
+}
+
+QTEST_GUILESS_MAIN(ManifestTest)
+
+#include "manifest_test.moc"
@@ -0,0 +1,89 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <babblesynth.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLString.hpp>
+
+#include "../gui/phonemes/phoneme_dictionary.h"
+
+using babblesynth::dictionary::compiled_dictionary;
+using babblesynth::gui::phonemes::PhonemeDictionary;
+using namespace xercesc;
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " INPUT.xml OUTPUT.bsdict\n\n"
+                  << "Compiles an XML phoneme dictionary. The GUI looks for "
+                     "the compiled\n"
+                     "version of a dictionary at INPUT.xml.bsdict."
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const char *inputPath = argv[1];
+    const char *outputPath = argv[2];
+
+    std::ifstream input(inputPath, std::ios::binary);
+    if (!input) {
+        std::cerr << "Can't open " << inputPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string xml((std::istreambuf_iterator<char>(input)),
+                          std::istreambuf_iterator<char>());
+
+    try {
+        XMLPlatformUtils::Initialize();
+    } catch (const XMLException &toCatch) {
+        char *message = XMLString::transcode(toCatch.getMessage());
+        std::cerr << "Error during initialization! :\n" << message << "\n";
+        XMLString::release(&message);
+        return EXIT_FAILURE;
+    }
+
+    int exitCode = EXIT_SUCCESS;
+
+    try {
+        std::unique_ptr<PhonemeDictionary> phonemes(
+            PhonemeDictionary::loadFromXML(inputPath));
+        if (phonemes == nullptr) {
+            throw std::runtime_error("not a valid XML file");
+        }
+
+        const uint64_t hash =
+            compiled_dictionary::hashSource(xml.data(), xml.size());
+        phonemes->saveCompiled(outputPath, hash);
+
+        const compiled_dictionary compiled(outputPath);
+        std::cout << "Compiled " << compiled.phonemeCount() << " phonemes and "
+                  << compiled.mappingCount() << " mappings to " << outputPath
+                  << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << inputPath << ": " << e.what() << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+
+    XMLPlatformUtils::Terminate();
+
+    return exitCode;
+}
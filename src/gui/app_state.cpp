@@ -18,7 +18,10 @@
 
 #include "app_state.h"
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <tuple>
 
 #include "filter/formant_filter.h"
 #include "generator/source_generator.h"
@@ -29,8 +32,26 @@ using namespace babblesynth::gui;
 constexpr int nF = 5;
 constexpr int nZ = 2;
 
+template <typename T>
+static std::size_t vectorBytes(const std::vector<T> &vector) {
+    return vector.capacity() * sizeof(T);
+}
+
+// Filter cascades of a checkpoint, in either sample type.
+template <typename Cascade>
+static std::size_t cascadeBytes(const Cascade &cascade) {
+    return vectorBytes(cascade.integratorB) + vectorBytes(cascade.integratorA) +
+           vectorBytes(cascade.integratorState);
+}
+
 AppState::AppState(int sampleRate)
-    : m_pitchPlan(false),
+    : m_revision(0),
+      m_cacheBytes(0),
+      m_cacheBudget(64 << 20),
+      m_cacheHits(0),
+      m_cacheMisses(0),
+      m_cacheResumes(0),
+      m_pitchPlan(false),
       m_amplitudePlan(false),
       m_formantFrequencyPlans(nF),
       m_formantBandwidthPlans(nF),
@@ -108,6 +129,8 @@ babblesynth::variable_plan *AppState::antiformantBandwidthPlan(int n) {
 }
 
 void AppState::updatePlans() {
+    markEdited();
+
     m_sourceGenerator->getParameter("Pitch plan").setValue(m_pitchPlan);
     m_sourceGenerator->getParameter("Amplitude plan").setValue(m_amplitudePlan);
 
@@ -132,4 +155,193 @@ void AppState::updatePlans() {
         m_formantFilter->getParameter(nameB).setValue(
             m_antiformantBandwidthPlans[n]);
     }
-}
\ No newline at end of file
+}
+
+void AppState::markEdited() { m_revision++; }
+
+int AppState::revision() const { return m_revision; }
+
+std::uint64_t AppState::renderKey() const {
+    util::hasher h;
+    h.add(m_sampleRate);
+    m_sourceGenerator->addToHash(h);
+    m_sourceGenerator->getSource()->addToHash(h);
+    m_formantFilter->addToHash(h);
+    return h.value();
+}
+
+AppState::Render AppState::findRender(std::uint64_t key) {
+    const auto it = m_renderIndex.find(key);
+    if (it == m_renderIndex.end()) {
+        m_cacheMisses++;
+        return nullptr;
+    }
+
+    m_cacheHits++;
+    m_renders.splice(m_renders.begin(), m_renders, it->second);
+    return it->second->second;
+}
+
+AppState::Render AppState::render() {
+    if (auto cached = findRender(renderKey())) {
+        return cached;
+    }
+
+    babblesynth::renderer streaming(*m_sourceGenerator, *m_formantFilter);
+    auto render = startRender(streaming);
+
+    // Appended a block at a time to stay within the reserved capacity.
+    std::vector<double> block(8192);
+    int count;
+    do {
+        count = streaming.process(block.data(), block.size());
+        render->samples.insert(render->samples.end(), block.begin(),
+                               block.begin() + count);
+    } while (count == block.size());
+
+    return finishRender(std::move(render), streaming);
+}
+
+std::shared_ptr<AppState::CachedRender> AppState::startRender(
+    babblesynth::renderer &streaming) {
+    auto render = std::make_shared<CachedRender>();
+    render->key = renderKey();
+    render->revision = m_revision;
+    render->sampleRate = m_sampleRate;
+    render->sourceParameters =
+        m_sourceGenerator->getSource()->takeSnapshot();
+    render->generatorParameters = m_sourceGenerator->takeSnapshot();
+    render->filterParameters = m_formantFilter->takeSnapshot();
+
+    streaming.setCheckpointInterval(std::lround(checkpointInterval *
+                                                m_sampleRate));
+
+    render->samples.reserve(m_sourceGenerator->totalSamples());
+
+    const auto [base, checkpoint] = findCheckpoint();
+    if (checkpoint != nullptr) {
+        // Everything up to the checkpoint is still the same.
+        render->samples.assign(base->samples.begin(),
+                               base->samples.begin() + checkpoint->position);
+        render->checkpoints.assign(&base->checkpoints.front(),
+                                   checkpoint + 1);
+        streaming.resume(*checkpoint);
+        m_cacheResumes++;
+    } else {
+        streaming.begin();
+    }
+
+    return render;
+}
+
+AppState::Render AppState::finishRender(
+    std::shared_ptr<CachedRender> render,
+    const babblesynth::renderer &streaming) {
+    render->checkpoints.insert(render->checkpoints.end(),
+                               streaming.checkpoints().begin(),
+                               streaming.checkpoints().end());
+
+    // Samples and checkpoints from before and after an edit don't belong
+    // together, even if the edit was undone since.
+    if (render->revision == m_revision && render->key == renderKey()) {
+        storeRender(render->key, render);
+    }
+    return render;
+}
+
+std::pair<AppState::Render, const babblesynth::renderer::checkpoint *>
+AppState::findCheckpoint() const {
+    Render bestRender;
+    const babblesynth::renderer::checkpoint *best = nullptr;
+
+    // A plan may agree with the old one past its new end when it was only
+    // cut short.
+    const int samples = m_sourceGenerator->totalSamples();
+
+    for (const auto &[key, render] : m_renders) {
+        if (render->sampleRate != m_sampleRate) {
+            continue;
+        }
+
+        const double time = std::min(
+            {m_sourceGenerator->getSource()->agreesUntil(
+                 render->sourceParameters),
+             m_sourceGenerator->agreesUntil(render->generatorParameters),
+             m_formantFilter->agreesUntil(render->filterParameters)});
+
+        // Checkpoints are in increasing time order.
+        for (auto it = render->checkpoints.rbegin();
+             it != render->checkpoints.rend(); ++it) {
+            if (it->time() <= time && it->source.index <= samples) {
+                if (best == nullptr || it->position > best->position) {
+                    bestRender = render;
+                    best = &*it;
+                }
+                break;
+            }
+        }
+    }
+
+    return {bestRender, best};
+}
+
+void AppState::storeRender(std::uint64_t key, Render render) {
+    const std::size_t bytes = renderBytes(*render);
+    if (bytes > m_cacheBudget) {
+        return;
+    }
+
+    if (const auto it = m_renderIndex.find(key); it != m_renderIndex.end()) {
+        m_cacheBytes -= renderBytes(*it->second->second);
+        m_renders.erase(it->second);
+        m_renderIndex.erase(it);
+    }
+
+    m_renders.emplace_front(key, std::move(render));
+    m_renderIndex[key] = m_renders.begin();
+    m_cacheBytes += bytes;
+
+    evictRenders();
+}
+
+std::size_t AppState::renderBytes(const CachedRender &render) {
+    std::size_t bytes = vectorBytes(render.samples);
+    for (const auto &checkpoint : render.checkpoints) {
+        const auto &source = checkpoint.source;
+        const auto &filter = checkpoint.filter;
+
+        bytes += sizeof(checkpoint) + vectorBytes(checkpoint.pending) +
+                 vectorBytes(source.discontinuities) +
+                 vectorBytes(source.antialiasState) +
+                 vectorBytes(source.antialiasStateF) +
+                 vectorBytes(source.sourceState) +
+                 cascadeBytes(std::get<0>(filter.cascades)) +
+                 cascadeBytes(std::get<1>(filter.cascades)) +
+                 vectorBytes(filter.periods);
+    }
+    return bytes;
+}
+
+bool AppState::isCacheable(std::size_t samples) const {
+    return samples * sizeof(double) <= m_cacheBudget;
+}
+
+void AppState::setCacheBudget(std::size_t bytes) {
+    m_cacheBudget = bytes;
+    evictRenders();
+}
+
+void AppState::evictRenders() {
+    while (m_cacheBytes > m_cacheBudget) {
+        const auto &[oldKey, oldRender] = m_renders.back();
+        m_cacheBytes -= renderBytes(*oldRender);
+        m_renderIndex.erase(oldKey);
+        m_renders.pop_back();
+    }
+}
+
+int AppState::cacheHits() const { return m_cacheHits; }
+
+int AppState::cacheMisses() const { return m_cacheMisses; }
+
+int AppState::cacheResumes() const { return m_cacheResumes; }
@@ -21,7 +21,12 @@
 
 #include <babblesynth.h>
 
+#include <cstdint>
+#include <list>
 #include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace babblesynth {
 namespace gui {
@@ -44,8 +49,85 @@ class AppState {
 
     void updatePlans();
 
+    // Counts the edits of the state. updatePlans() is one, and any other
+    // change to the parameters of the generator, its source or the filter
+    // must call markEdited(). A render started before an edit is not cached.
+    void markEdited();
+    int revision() const;
+
+    // Cache of rendered utterances, keyed by renderKey() and evicted least
+    // recently used first once they take up more than the budget. With a
+    // random noise seed, a cached render repeats the noise of the first one.
+    //
+    // Renders keep the parameters they were made with and checkpoints of the
+    // synthesis, so that after an edit only the part from the last checkpoint
+    // before the first change has to be rendered again.
+    struct CachedRender {
+        std::uint64_t key;
+        int revision;  // of the state when the render started
+        std::vector<double> samples;  // not normalized
+
+        int sampleRate;
+        babblesynth::parameter_holder::snapshot sourceParameters;
+        babblesynth::parameter_holder::snapshot generatorParameters;
+        babblesynth::parameter_holder::snapshot filterParameters;
+        std::vector<babblesynth::renderer::checkpoint> checkpoints;
+    };
+
+    using Render = std::shared_ptr<const CachedRender>;
+
+    std::uint64_t renderKey() const;
+    Render findRender(std::uint64_t key);
+
+    // Returns the cached render of the current state, or renders and caches
+    // it, resuming from a checkpoint of another cached render if possible.
+    Render render();
+
+    // The same in steps, for streaming the render as it goes: startRender()
+    // sets `streaming` up to render the current state and returns the render
+    // to fill. If it resumes from a checkpoint, that checkpoint is the last
+    // one of the render and the samples before it are already there. Once
+    // the rest of the samples were appended, finishRender() adds the
+    // checkpoints of `streaming` and caches the render, unless the state was
+    // edited in the meantime.
+    std::shared_ptr<CachedRender> startRender(babblesynth::renderer &streaming);
+    Render finishRender(std::shared_ptr<CachedRender> render,
+                        const babblesynth::renderer &streaming);
+
+    // Whether a render of that many samples would fit in the cache at all.
+    bool isCacheable(std::size_t samples) const;
+
+    void setCacheBudget(std::size_t bytes);
+    int cacheHits() const;
+    int cacheMisses() const;
+    int cacheResumes() const;
+
+    // Time between two checkpoints of a cached render.
+    static constexpr double checkpointInterval = 0.1;
+
    private:
+    void storeRender(std::uint64_t key, Render render);
+    void evictRenders();
+
+    // The cached render and checkpoint to resume from for the current
+    // state, the one furthest into the utterance, or nulls.
+    std::pair<Render, const babblesynth::renderer::checkpoint *>
+    findCheckpoint() const;
+
+    static std::size_t renderBytes(const CachedRender &render);
+
     int m_sampleRate;
+    int m_revision;
+
+    std::list<std::pair<std::uint64_t, Render>> m_renders;  // most recent first
+    std::unordered_map<std::uint64_t,
+                       std::list<std::pair<std::uint64_t, Render>>::iterator>
+        m_renderIndex;
+    std::size_t m_cacheBytes;
+    std::size_t m_cacheBudget;
+    int m_cacheHits;
+    int m_cacheMisses;
+    int m_cacheResumes;
 
     std::unique_ptr<babblesynth::generator::source_generator> m_sourceGenerator;
     babblesynth::variable_plan m_pitchPlan;
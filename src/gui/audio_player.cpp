@@ -25,43 +25,24 @@
 
 using namespace babblesynth::gui;
 
-static void f64_to_s16(QByteArray& dst, const std::vector<double>& src) {
-    constexpr int channels = 2;
-    const int sampleCount = src.size();
-    dst.resize(sizeof(int16_t) * channels * sampleCount);
-
-    int16_t* pDst = reinterpret_cast<int16_t*>(dst.data());
-
-    int r;
-    size_t i, ch;
-    for (i = 0; i < sampleCount; ++i) {
-        double x = src[i];
-        double c;
-        c = ((x < -1) ? -1 : ((x > 1) ? 1 : x));
-        c = c + 1;
-        r = (int)(c * 32767.5);
-        r = r - 32768;
-        for (ch = 0; ch < channels; ++ch) {
-            pDst[i * channels + ch] = (int16_t)r;
-        }
-    }
-}
-
 AudioPlayer::AudioPlayer(QObject* parent)
     : QObject(parent),
       m_deviceInfo(QMediaDevices::defaultAudioOutput()),
-      m_audio(nullptr) {
+      m_audio(nullptr),
+      m_playing(false) {
     initAudio();
-    m_buffer.setBuffer(&m_data);
 }
 
-void AudioPlayer::play(const std::vector<double>& data) {
+void AudioPlayer::play() {
     if (m_playing) {
         m_audio->stop();
     }
-    f64_to_s16(m_data, data);
-    m_buffer.open(QIODevice::ReadOnly);
-    m_audio->start(&m_buffer);
+
+    m_device = std::make_unique<RenderDevice>(appState.get(),
+                                              m_audioFormat.channelCount());
+    m_device->open(QIODevice::ReadOnly);
+
+    m_audio->start(m_device.get());
 }
 
 void AudioPlayer::stop() {
@@ -78,7 +59,7 @@ void AudioPlayer::onStateChanged(QAudio::State state) {
             break;
         case QAudio::IdleState:
             m_audio->stop();
-            m_buffer.close();
+            m_device->close();
             m_playing = false;
             emit stopped();
             break;
@@ -23,13 +23,12 @@
 #include <QAudioDevice>
 #include <QAudioFormat>
 #include <QAudioSink>
-#include <QBuffer>
-#include <QByteArray>
 #include <QMediaDevices>
 #include <QObject>
-#include <vector>
+#include <memory>
 
 #include "app_state.h"
+#include "render_device.h"
 
 namespace babblesynth {
 namespace gui {
@@ -40,7 +39,10 @@ class AudioPlayer : public QObject {
    public:
     AudioPlayer(QObject *parent = nullptr);
 
-    void play(const std::vector<double> &data);
+    // Starts playing the current synthesis state, rendered as the sink pulls
+    // the samples. Utterances which fit in the render cache are played from
+    // it or added to it, see RenderDevice.
+    void play();
 
     int preferredSampleRate() const;
 
@@ -64,8 +66,7 @@ class AudioPlayer : public QObject {
 
     QAudioSink *m_audio;
 
-    QByteArray m_data;
-    QBuffer m_buffer;
+    std::unique_ptr<RenderDevice> m_device;
 
     bool m_playing;
 };
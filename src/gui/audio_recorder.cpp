@@ -25,12 +25,13 @@
 
 using namespace babblesynth::gui;
 
-static void s16_to_f64(std::vector<double>& dst, const QByteArray& src) {
+static void s16_to_f64(std::vector<double>& dst, const char* src,
+                       const qint64 size) {
     constexpr int channels = 1;
-    const int sampleCount = (src.size() / sizeof(int16_t)) / channels;
+    const int sampleCount = (size / sizeof(int16_t)) / channels;
     dst.resize(sampleCount);
 
-    auto pSrc = reinterpret_cast<const int16_t*>(src.constData());
+    auto pSrc = reinterpret_cast<const int16_t*>(src);
 
     size_t i, ch;
     for (i = 0; i < sampleCount; ++i) {
@@ -53,7 +54,8 @@ static void s16_to_f64(std::vector<double>& dst, const QByteArray& src) {
 AudioRecorder::AudioRecorder(QObject* parent)
     : QObject(parent),
       m_deviceInfo(QMediaDevices::defaultAudioOutput()),
-      m_audio(nullptr) {
+      m_audio(nullptr),
+      m_chunkPosition(0) {
     m_timer.setInterval(50);
     m_timer.setTimerType(Qt::PreciseTimer);
     connect(&m_timer, &QTimer::timeout, this, &AudioRecorder::onNotified);
@@ -65,6 +67,7 @@ void AudioRecorder::start() {
         m_audio->stop();
     }
     m_buffer.open(QIODevice::WriteOnly);
+    m_chunkPosition = 0;
     m_audio->start(&m_buffer);
 }
 
@@ -104,12 +107,29 @@ void AudioRecorder::onStateChanged(QAudio::State state) {
 
 void AudioRecorder::onNotified() {
     emit recording(m_audio->processedUSecs() / 1000);
+    emitChunk();
 }
 
 void AudioRecorder::onStopped() {
+    emitChunk();
+    emit stopped();
+}
+
+void AudioRecorder::emitChunk() {
+    const QByteArray& data = m_buffer.data();
+
+    // Whole samples only, the rest comes with the next chunk.
+    const qint64 end = data.size() - data.size() % sizeof(int16_t);
+    if (end <= m_chunkPosition) {
+        return;
+    }
+
     std::vector<double> audio;
-    s16_to_f64(audio, m_buffer.data());
-    emit stopped(audio);
+    s16_to_f64(audio, data.constData() + m_chunkPosition,
+               end - m_chunkPosition);
+    m_chunkPosition = end;
+
+    emit chunk(audio);
 }
 
 void AudioRecorder::initAudio() {
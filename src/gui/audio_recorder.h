@@ -50,15 +50,21 @@ class AudioRecorder : public QObject {
 
    signals:
     void started();
-    void stopped(std::vector<double> audio);
+    void stopped();
     void recording(int durationMillis);
 
+    // The audio captured since the previous chunk, emitted along with
+    // recording() and once more with the rest before stopped(). The chunks
+    // are the only way to get the recorded audio.
+    void chunk(std::vector<double> audio);
+
    private slots:
     void onStateChanged(QAudio::State state);
     void onNotified();
 
    private:
     void onStopped();
+    void emitChunk();
 
     void initAudio();
 
@@ -72,6 +78,7 @@ class AudioRecorder : public QObject {
     QAudioSource *m_audio;
 
     QBuffer m_buffer;
+    qint64 m_chunkPosition;  // bytes of m_buffer already sent as chunks
 
     bool m_recording;
 };
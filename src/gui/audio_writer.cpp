@@ -24,34 +24,122 @@
 
 using namespace babblesynth::gui;
 
+AudioWriter::AudioWriter()
+    : m_sndfile(nullptr), m_failed(false), m_closing(false) {}
+
+AudioWriter::~AudioWriter() { close(); }
+
 void AudioWriter::write(const QString &filePath, const int formatIndex,
+                        const int sampleRate,
                         const std::vector<double> &data) {
-    SNDFILE *sndfile;
+    if (open(filePath, formatIndex, sampleRate)) {
+        append(data.data(), data.size());
+        close();
+    }
+}
+
+bool AudioWriter::open(const QString &filePath, const int formatIndex,
+                       const int sampleRate) {
+    close();
+
     int mode = SFM_WRITE;
 
     SF_INFO sfinfo;
-    sfinfo.samplerate = 48000;
+    sfinfo.samplerate = sampleRate;
     sfinfo.channels = 1;
     sfinfo.format = (formatIndex & SF_FORMAT_TYPEMASK) | SF_FORMAT_PCM_24;
 
 #if defined(_WIN32) && defined(_UNICODE)
     std::wstring filePathString = filePath.toStdWString();
-    sndfile = sf_wchar_open(filePathString.c_str(), mode, &sfinfo);
+    m_sndfile = sf_wchar_open(filePathString.c_str(), mode, &sfinfo);
 #else
     std::string filePathString = filePath.toStdString();
-    sndfile = sf_open(filePathString.c_str(), mode, &sfinfo);
+    m_sndfile = sf_open(filePathString.c_str(), mode, &sfinfo);
 #endif
 
-    if (sndfile == nullptr) {
+    if (m_sndfile == nullptr) {
         qDebug() << "error opening file:" << sf_strerror(nullptr);
+        return false;
+    }
+
+    m_failed = false;
+    m_closing = false;
+    m_thread = std::thread(&AudioWriter::encodeLoop, this);
+
+    return true;
+}
+
+void AudioWriter::append(const double *data, const int frames) {
+    if (m_sndfile == nullptr || frames <= 0) {
         return;
     }
 
-    sf_writef_double(sndfile, data.data(), data.size());
+    std::vector<double> block;
+
+    std::unique_lock lock(m_mutex);
+    m_canPush.wait(lock, [this] { return m_queue.size() < maxQueuedBlocks; });
+
+    if (!m_spareBlocks.empty()) {
+        block = std::move(m_spareBlocks.back());
+        m_spareBlocks.pop_back();
+    }
+
+    lock.unlock();
+    block.assign(data, data + frames);
+    lock.lock();
+
+    m_queue.push_back(std::move(block));
+    m_canPop.notify_one();
+}
+
+bool AudioWriter::close() {
+    if (m_sndfile == nullptr) {
+        return false;
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_closing = true;
+    }
+    m_canPop.notify_one();
+    m_thread.join();
 
-    int err = sf_close(sndfile);
+    int err = sf_close(m_sndfile);
     if (err != 0) {
         qDebug() << "error closing file:" << sf_error_number(err);
+        m_failed = true;
+    }
+    m_sndfile = nullptr;
+
+    return !m_failed;
+}
+
+void AudioWriter::encodeLoop() {
+    std::unique_lock lock(m_mutex);
+
+    while (true) {
+        m_canPop.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+
+        if (m_queue.empty()) {
+            // Closing, and everything was written.
+            break;
+        }
+
+        std::vector<double> block = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_canPush.notify_one();
+
+        lock.unlock();
+        const sf_count_t written =
+            sf_writef_double(m_sndfile, block.data(), block.size());
+        lock.lock();
+
+        if (written != block.size() && !m_failed) {
+            qDebug() << "error writing file:" << sf_strerror(m_sndfile);
+            m_failed = true;
+        }
+
+        m_spareBlocks.push_back(std::move(block));
     }
 }
 
@@ -21,21 +21,62 @@
 
 #include <QString>
 #include <QStringList>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "app_state.h"
 #include "widgets/source_parameters.h"
 
+// Same declaration as in <sndfile.h>, which only the source file includes.
+typedef struct sf_private_tag SNDFILE;
+
 namespace babblesynth {
 namespace gui {
 
+// Writes mono audio files. Blocks passed to append() are queued and encoded
+// on a separate thread, so rendering can go on while the file is written.
 class AudioWriter {
    public:
-    void write(const QString &filePath, int formatIndex,
+    AudioWriter();
+    ~AudioWriter();
+
+    AudioWriter(const AudioWriter &) = delete;
+    AudioWriter &operator=(const AudioWriter &) = delete;
+
+    void write(const QString &filePath, int formatIndex, int sampleRate,
                const std::vector<double> &data);
 
+    // Streaming interface: open() starts a new file, append() queues the
+    // next block and only waits when the encoder is more than
+    // maxQueuedBlocks behind, and close() waits for every queued block to be
+    // written. Returns false if the file couldn't be opened or written.
+    bool open(const QString &filePath, int formatIndex, int sampleRate);
+    void append(const double *data, int frames);
+    bool close();
+
     std::pair<std::vector<int>, QStringList> supportedFileFormats() const;
+
+    static constexpr int maxQueuedBlocks = 16;
+
+   private:
+    void encodeLoop();
+
+    SNDFILE *m_sndfile;
+    bool m_failed;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_canPush;
+    std::condition_variable m_canPop;
+    bool m_closing;
+
+    std::deque<std::vector<double>> m_queue;
+    // Blocks which were already written, kept to be filled again.
+    std::vector<std::vector<double>> m_spareBlocks;
 };
 
 }  // namespace gui
@@ -19,6 +19,7 @@
 #include "phoneme_dictionary.h"
 
 #include <QDebug>
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <xercesc/dom/DOM.hpp>
@@ -42,44 +43,101 @@ inline bool stringEqualsI(const XMLCh *xmlStr, const char *cStr2) {
     return test;
 }
 
+// Same case folding as compiled dictionaries.
+static XMLCh foldCase(const XMLCh ch) {
+    return babblesynth::dictionary::foldCase(ch);
+}
+
 PhonemeDictionary::~PhonemeDictionary() {}
 
-std::vector<PhonemeMapping> PhonemeDictionary::mappingsFor(
-    const XMLWStr &text) {
-    int textLength = text.length();
+std::vector<MappingMatch> PhonemeDictionary::matchMappings(
+    const XMLWStr &text) const {
+    const XMLCh *chars = text.xmlch();
+    const int textLength = text.length();
 
-    std::vector<PhonemeMapping> mappings;
+    std::vector<MappingMatch> matches;
 
     int chIndex = 0;
 
     while (chIndex < textLength) {
-        int prefixLengthFound = 0;
-        std::vector<PhonemeMapping> mappingFound;
-
-        // Search for the longest mapping that starts at chIndex.
-        for (const auto &[prefix, mapping] : m_mappings) {
-            const int prefixLength = prefix.length();
+        MappingMatch match{chIndex, 0, nullptr};
+
+        // Walk down the trie for the longest mapping that starts at chIndex.
+        int node = 0;
+        for (int i = chIndex; i < textLength; ++i) {
+            const XMLCh folded = foldCase(chars[i]);
+            const auto &children = m_trie[node].children;
+            const auto it = std::lower_bound(
+                children.begin(), children.end(), folded,
+                [](const auto &edge, XMLCh ch) { return edge.first < ch; });
+            if (it == children.end() || it->first != folded) {
+                break;
+            }
 
-            if (prefixLength > prefixLengthFound &&
-                text.startsWith(prefix, chIndex)) {
-                prefixLengthFound = prefixLength;
-                mappingFound = mapping;
+            node = it->second;
+            if (m_trie[node].mappings != nullptr) {
+                match.length = i + 1 - chIndex;
+                match.mappings = m_trie[node].mappings;
             }
         }
 
         // If no mapping was found, advance by one character and try again.
-        if (prefixLengthFound > 0) {
-            chIndex += prefixLengthFound;
-            mappings.insert(mappings.end(), mappingFound.cbegin(),
-                            mappingFound.cend());
+        if (match.length > 0) {
+            chIndex += match.length;
+            matches.push_back(match);
         } else {
             chIndex++;
         }
     }
 
+    return matches;
+}
+
+std::vector<PhonemeMapping> PhonemeDictionary::mappingsFor(
+    const XMLWStr &text) const {
+    std::vector<PhonemeMapping> mappings;
+
+    for (const auto &match : matchMappings(text)) {
+        mappings.insert(mappings.end(), match.mappings->cbegin(),
+                        match.mappings->cend());
+    }
+
     return mappings;
 }
 
+void PhonemeDictionary::buildTrie() {
+    m_trie.assign(1, TrieNode{{}, nullptr});
+
+    for (const auto &[name, mapping] : m_mappings) {
+        const XMLCh *chars = name.xmlch();
+        int node = 0;
+
+        for (int i = 0; i < name.length(); ++i) {
+            const XMLCh folded = foldCase(chars[i]);
+            auto &children = m_trie[node].children;
+            const auto it = std::lower_bound(
+                children.begin(), children.end(), folded,
+                [](const auto &edge, XMLCh ch) { return edge.first < ch; });
+
+            if (it != children.end() && it->first == folded) {
+                node = it->second;
+            } else {
+                const int child = m_trie.size();
+                // The edge goes first, adding the node may move `children`.
+                children.emplace(it, folded, child);
+                m_trie.push_back({{}, nullptr});
+                node = child;
+            }
+        }
+
+        // An empty name never matched anything. Of names which only differ
+        // by case, the first one matched.
+        if (node != 0 && m_trie[node].mappings == nullptr) {
+            m_trie[node].mappings = &mapping;
+        }
+    }
+}
+
 void PhonemeDictionary::addOrReplaceMapping(
     const XMLWStr &name, const std::vector<PhonemeMapping> &mappings) {
     const XMLWStr prefix(name + "_");
@@ -101,6 +159,8 @@ void PhonemeDictionary::addOrReplaceMapping(
     } else {
         m_mappings.emplace(name, namedMappings);
     }
+
+    buildTrie();
 }
 
 void PhonemeDictionary::deleteMapping(const XMLWStr &name) {
@@ -126,6 +186,8 @@ void PhonemeDictionary::deleteMapping(const XMLWStr &name) {
             ++phoneIt;
         }
     }
+
+    buildTrie();
 }
 
 void PhonemeDictionary::renameMapping(const XMLWStr &oldName,
@@ -167,6 +229,8 @@ void PhonemeDictionary::renameMapping(const XMLWStr &oldName,
     }
 
     m_mappings.emplace(newName, std::move(mappings));
+
+    buildTrie();
 }
 
 bool PhonemeDictionary::mappingExists(const XMLWStr &name) const {
@@ -476,6 +540,8 @@ PhonemeDictionary::PhonemeDictionary(DOMDocument *doc) {
             m_mappings.emplace(forString, std::move(mappingDefs));
         }
     }
+
+    buildTrie();
 }
 
 void PhonemeDictionary::saveToXml(const XMLWStr &filename) {
@@ -588,6 +654,107 @@ void PhonemeDictionary::saveToXml(const XMLWStr &filename) {
     }
 }
 
+// Names are XMLCh strings, which are UTF-16 like in compiled dictionaries.
+static_assert(sizeof(XMLCh) == sizeof(char16_t));
+
+static std::u16string_view nameView(const XMLWStr &name) {
+    return {reinterpret_cast<const char16_t *>(name.xmlch()),
+            size_t(name.length())};
+}
+
+PhonemeDictionary *PhonemeDictionary::fromCompiled(
+    const babblesynth::dictionary::compiled_dictionary &compiled) {
+    // Compiled names end with a 0, so they can be copied as they are.
+    const auto name = [](const std::u16string_view view) {
+        return XMLWStr(reinterpret_cast<const XMLCh *>(view.data()));
+    };
+
+    auto *result = new PhonemeDictionary;
+
+    std::vector<const Phoneme *> phonemes;
+    phonemes.reserve(compiled.phonemeCount());
+
+    for (size_t i = 0; i < compiled.phonemeCount(); ++i) {
+        Phoneme phoneme(name(compiled.phonemeName(i)));
+
+        for (const auto &pole : compiled.poles(i)) {
+            phoneme.addPole(pole.frequency, pole.bandwidth, pole.index);
+        }
+        for (const auto &zero : compiled.zeros(i)) {
+            phoneme.addZero(zero.frequency, zero.bandwidth, zero.index);
+        }
+
+        const auto it =
+            result->m_phonemes.emplace(phoneme.name(), std::move(phoneme))
+                .first;
+        phonemes.push_back(&it->second);
+    }
+
+    for (size_t i = 0; i < compiled.mappingCount(); ++i) {
+        std::vector<PhonemeMapping> mappingDefs;
+
+        for (const auto &entry : compiled.entries(i)) {
+            mappingDefs.push_back(
+                {*phonemes[entry.phoneme], entry.duration, entry.intensity});
+        }
+
+        result->m_mappings.emplace(name(compiled.mappingName(i)),
+                                   std::move(mappingDefs));
+    }
+
+    result->buildTrie();
+
+    return result;
+}
+
+void PhonemeDictionary::saveCompiled(const std::string &filename,
+                                     const uint64_t sourceHash) const {
+    babblesynth::dictionary::dictionary_builder builder;
+    builder.setSourceHash(sourceHash);
+
+    const auto poleZeros = [](const std::vector<PoleZero> &list) {
+        std::vector<babblesynth::dictionary::pole_zero> result;
+        for (const auto &[i, frequency, bandwidth] : list) {
+            result.push_back({frequency, bandwidth, i, 0});
+        }
+        return result;
+    };
+
+    // Phonemes are stored once and referred to by index.
+    std::map<XMLWStr, uint32_t> indices;
+
+    const auto indexOf = [&](const Phoneme &phoneme) {
+        const auto it = indices.find(phoneme.name());
+        if (it != indices.end()) {
+            return it->second;
+        }
+
+        const uint32_t index =
+            builder.addPhoneme(nameView(phoneme.name()),
+                               poleZeros(phoneme.m_poles),
+                               poleZeros(phoneme.m_zeros));
+        indices.emplace(phoneme.name(), index);
+        return index;
+    };
+
+    for (const auto &[name, phoneme] : m_phonemes) {
+        indexOf(phoneme);
+    }
+
+    for (const auto &[name, mapping] : m_mappings) {
+        std::vector<babblesynth::dictionary::mapping_entry> entries;
+
+        for (const auto &def : mapping) {
+            entries.push_back(
+                {def.duration, def.intensity, indexOf(def.phoneme), 0});
+        }
+
+        builder.addMapping(nameView(name), entries);
+    }
+
+    builder.write(filename);
+}
+
 std::ostream &operator<<(std::ostream &os,
                          const PhonemeDictionary &dictionary) {
     os << "PhonemeDictionary[\n";
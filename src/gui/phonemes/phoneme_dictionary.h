@@ -19,9 +19,13 @@
 #ifndef BABBLESYNTH_PHONEMES_PHONEME_DICTIONARY_H
 #define BABBLESYNTH_PHONEMES_PHONEME_DICTIONARY_H
 
+#include <babblesynth.h>
+
 #include <QObject>
 #include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 #include <xercesc/dom/DOM.hpp>
 
 #include "phoneme.h"
@@ -41,6 +45,14 @@ struct PhonemeMapping {
     double intensity;
 };
 
+// A run of text matched by a mapping. `mappings` points into the dictionary
+// and stays valid until the dictionary is modified.
+struct MappingMatch {
+    int start;
+    int length;
+    const std::vector<PhonemeMapping> *mappings;
+};
+
 }  // namespace phonemes
 }  // namespace gui
 }  // namespace babblesynth
@@ -67,7 +79,23 @@ class PhonemeDictionary : public QObject {
 
     void saveToXml(const XMLWStr &xmlFilename);
 
-    std::vector<PhonemeMapping> mappingsFor(const XMLWStr &text);
+    // Copies a compiled dictionary, which is much faster than parsing XML.
+    // The phoneme editor changes the copy, the file itself is only read once.
+    static PhonemeDictionary *fromCompiled(
+        const dictionary::compiled_dictionary &compiled);
+
+    // Writes the dictionary in the compiled format. `sourceHash` identifies
+    // the XML file it was loaded from, if any. Throws std::runtime_error.
+    void saveCompiled(const std::string &filename,
+                      uint64_t sourceHash = 0) const;
+
+    // Splits the text into the longest mappings that match from left to
+    // right, ignoring case, and skipping the characters which no mapping
+    // starts with.
+    std::vector<MappingMatch> matchMappings(const XMLWStr &text) const;
+
+    // The phonemes of every match, in order.
+    std::vector<PhonemeMapping> mappingsFor(const XMLWStr &text) const;
 
     void addOrReplaceMapping(const XMLWStr &name,
                              const std::vector<PhonemeMapping> &mappings);
@@ -81,9 +109,20 @@ class PhonemeDictionary : public QObject {
    private:
     PhonemeDictionary(xercesc::DOMDocument *doc);
 
+    // Rebuilds m_trie, after any change to m_mappings.
+    void buildTrie();
+
     std::map<XMLWStr, Phoneme> m_phonemes;
     std::map<XMLWStr, std::vector<PhonemeMapping>> m_mappings;
 
+    // Prefix tree of the mapping names, the root is the first node. The
+    // characters are case-folded with dictionary::foldCase().
+    struct TrieNode {
+        std::vector<std::pair<XMLCh, int>> children;  // sorted by character
+        const std::vector<PhonemeMapping> *mappings;  // if a name ends here
+    };
+    std::vector<TrieNode> m_trie{TrieNode{{}, nullptr}};
+
     friend std::ostream & ::operator<<(std::ostream &os,
                                        const PhonemeDictionary &phoneme);
 
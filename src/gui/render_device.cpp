@@ -0,0 +1,149 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render_device.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace babblesynth::gui;
+
+RenderDevice::RenderDevice(generator::source_generator *source,
+                           filter::formant_filter *filter, int channels,
+                           QObject *parent)
+    : QIODevice(parent),
+      m_state(nullptr),
+      m_source(source),
+      m_renderer(std::make_unique<renderer>(*source, *filter)),
+      m_normalizer(std::make_unique<stream_normalizer>(source->sampleRate())),
+      m_channels(channels),
+      m_renderedBefore(0),
+      m_position(0),
+      m_isRendering(false) {}
+
+RenderDevice::RenderDevice(AppState *state, int channels, QObject *parent)
+    : RenderDevice(state->source(), state->formantFilter(), channels,
+                   parent) {
+    m_state = state;
+}
+
+bool RenderDevice::open(OpenMode mode) {
+    if (mode & WriteOnly) {
+        return false;
+    }
+
+    m_cached = nullptr;
+    m_recording = nullptr;
+
+    if (m_state != nullptr) {
+        m_cached = m_state->findRender(m_state->renderKey());
+    }
+
+    if (m_cached) {
+        m_renderedBefore = m_cached->samples.size();
+        m_isRendering = false;
+    } else if (m_state != nullptr &&
+               m_state->isCacheable(m_source->totalSamples())) {
+        m_recording = m_state->startRender(*m_renderer);
+        m_renderedBefore = m_recording->samples.size();
+        m_isRendering = true;
+    } else {
+        m_renderer->setCheckpointInterval(0);
+        m_renderer->begin();
+        m_renderedBefore = 0;
+        m_isRendering = true;
+    }
+
+    m_position = 0;
+    m_normalizer->begin(
+        m_source->getParameter("Amplitude plan").value<variable_plan>());
+
+    return QIODevice::open(mode);
+}
+
+bool RenderDevice::isSequential() const { return true; }
+
+bool RenderDevice::atEnd() const {
+    return m_normalizer->finished() && QIODevice::atEnd();
+}
+
+int RenderDevice::readSamples(double *out, int frames) {
+    fillNormalizer(frames);
+    return m_normalizer->read(out, frames);
+}
+
+qint64 RenderDevice::readData(char *data, qint64 maxSize) {
+    const int frameSize = sizeof(int16_t) * m_channels;
+    const int frames = maxSize / frameSize;
+
+    m_block.resize(std::max<size_t>(m_block.size(), frames));
+
+    const int count = readSamples(m_block.data(), frames);
+
+    int16_t *pDst = reinterpret_cast<int16_t *>(data);
+
+    for (int i = 0; i < count; ++i) {
+        double c = std::clamp(m_block[i], -1.0, 1.0);
+        c = c + 1;
+        int r = (int)(c * 32767.5);
+        r = r - 32768;
+        for (int ch = 0; ch < m_channels; ++ch) {
+            pDst[i * m_channels + ch] = (int16_t)r;
+        }
+    }
+
+    return qint64(count) * frameSize;
+}
+
+void RenderDevice::fillNormalizer(int frames) {
+    constexpr int blockSize = 1024;
+    m_rendered.resize(blockSize);
+
+    while (m_normalizer->available() < frames) {
+        if (m_position < m_renderedBefore) {
+            const auto &samples =
+                m_cached ? m_cached->samples : m_recording->samples;
+            const int count =
+                std::min(blockSize, m_renderedBefore - m_position);
+            m_normalizer->write(samples.data() + m_position, count);
+            m_position += count;
+        } else if (m_isRendering) {
+            const int count =
+                m_renderer->process(m_rendered.data(), blockSize);
+            m_normalizer->write(m_rendered.data(), count);
+            if (m_recording) {
+                m_recording->samples.insert(m_recording->samples.end(),
+                                            m_rendered.begin(),
+                                            m_rendered.begin() + count);
+            }
+            m_isRendering = !m_renderer->finished();
+        } else {
+            break;
+        }
+    }
+
+    if (m_position >= m_renderedBefore && !m_isRendering) {
+        m_normalizer->finish();
+        if (m_recording) {
+            m_state->finishRender(m_recording, *m_renderer);
+            m_recording = nullptr;
+        }
+    }
+}
+
+qint64 RenderDevice::writeData(const char *data, qint64 maxSize) { return -1; }
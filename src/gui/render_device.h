@@ -0,0 +1,91 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BABBLESYNTH_RENDER_DEVICE_H
+#define BABBLESYNTH_RENDER_DEVICE_H
+
+#include <babblesynth.h>
+
+#include <QIODevice>
+#include <memory>
+#include <vector>
+
+#include "app_state.h"
+
+namespace babblesynth {
+namespace gui {
+
+// Sequential read-only device which renders interleaved signed 16-bit PCM on
+// demand, one block at a time. Opening the device rewinds the synthesis to
+// t = 0; it reaches its end once the whole utterance has been read. The
+// output is peak-normalized in the same pass, with a look-ahead of a few
+// blocks, see stream_normalizer.
+//
+// A device for an AppState goes through its render cache. A cached render of
+// the current state is read from memory, otherwise the render resumes from
+// the last valid checkpoint of another one if possible, and is cached once
+// it is complete. Utterances too long to be cached are only streamed. The
+// output is normalized the same way in every case.
+class RenderDevice : public QIODevice {
+    Q_OBJECT
+
+   public:
+    RenderDevice(babblesynth::generator::source_generator *source,
+                 babblesynth::filter::formant_filter *filter,
+                 int channels = 2, QObject *parent = nullptr);
+
+    RenderDevice(AppState *state, int channels = 2, QObject *parent = nullptr);
+
+    bool open(OpenMode mode) override;
+    bool isSequential() const override;
+    bool atEnd() const override;
+
+    // Reads up to `frames` normalized samples, one per frame, before they
+    // are converted to PCM. Returns less than `frames` only at the end.
+    int readSamples(double *out, int frames);
+
+   protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+   private:
+    // Renders until `frames` normalized samples can be read, or the end.
+    void fillNormalizer(int frames);
+
+    AppState *m_state;
+    babblesynth::generator::source_generator *m_source;
+    std::unique_ptr<babblesynth::renderer> m_renderer;
+    std::unique_ptr<babblesynth::stream_normalizer> m_normalizer;
+    int m_channels;
+
+    // Samples which were already rendered when the device was opened come
+    // from the cached render, or from the start of the one being recorded.
+    AppState::Render m_cached;
+    std::shared_ptr<AppState::CachedRender> m_recording;
+    int m_renderedBefore;
+    int m_position;
+    bool m_isRendering;
+
+    std::vector<double> m_rendered;
+    std::vector<double> m_block;
+};
+
+}  // namespace gui
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_RENDER_DEVICE_H
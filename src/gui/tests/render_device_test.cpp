@@ -0,0 +1,260 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <babblesynth.h>
+
+#include <QByteArray>
+#include <QtTest>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "render_device.h"
+
+using namespace babblesynth;
+using namespace babblesynth::gui;
+
+// Reads the device headlessly, the way an audio sink in pull mode does.
+class RenderDeviceTest : public QObject {
+    Q_OBJECT
+
+   public:
+    RenderDeviceTest();
+
+   private slots:
+    void readsWholeUtterance();
+    void staysWithinFullScale();
+    void restartsWhenReopened();
+    void replaysCachedRender();
+    void resumesAfterExtendingPlan();
+    void resumesAfterCuttingPlanShort();
+    void abandonsRenderEditedDuringPlayback();
+
+   private:
+    QByteArray readUntilEnd(RenderDevice &device, qint64 chunkSize);
+    int renderedSamples();
+
+    // Plays the pitch plan `before` then `after` with the same AppState, and
+    // checks that the second render resumed from the first one and cached
+    // the same samples as a render from scratch.
+    void checkTailEdit(const variable_plan &before,
+                       const variable_plan &after);
+
+    static constexpr int sampleRate = 48000;
+    static constexpr int channels = 2;
+
+    generator::source_generator m_source;
+    filter::formant_filter m_filter;
+};
+
+RenderDeviceTest::RenderDeviceTest()
+    : m_source(sampleRate), m_filter(sampleRate) {
+    m_source.getParameter("Noise seed").setValue(7);
+
+    variable_plan pitch(false, 140);
+    pitch.linearToValueAtTime(180, 0.5).cubicToValueAtTime(120, 1.0);
+    m_source.getParameter("Pitch plan").setValue(pitch);
+
+    variable_plan amplitude(false, 0);
+    amplitude.linearToValueAtTime(1, 0.1)
+        .stepToValueAtTime(1, 0.9)
+        .cubicToValueAtTime(0, 1.0);
+    m_source.getParameter("Amplitude plan").setValue(amplitude);
+}
+
+QByteArray RenderDeviceTest::readUntilEnd(RenderDevice &device,
+                                          qint64 chunkSize) {
+    QByteArray data;
+    while (!device.atEnd()) {
+        const QByteArray chunk = device.read(chunkSize);
+        if (chunk.isEmpty()) {
+            break;
+        }
+        data.append(chunk);
+    }
+    return data;
+}
+
+int RenderDeviceTest::renderedSamples() {
+    renderer streaming(m_source, m_filter);
+    streaming.begin();
+
+    std::vector<double> block(4096);
+    int total = 0;
+    int count;
+    do {
+        count = streaming.process(block.data(), block.size());
+        total += count;
+    } while (count == block.size());
+    return total;
+}
+
+void RenderDeviceTest::readsWholeUtterance() {
+    const int expected = renderedSamples();
+
+    for (const qint64 chunkSize : {64, 4096, 65536}) {
+        RenderDevice device(&m_source, &m_filter, channels);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+
+        const QByteArray data = readUntilEnd(device, chunkSize);
+        QCOMPARE(data.size(), qsizetype(expected) * channels * 2);
+        QVERIFY(device.atEnd());
+    }
+}
+
+void RenderDeviceTest::staysWithinFullScale() {
+    RenderDevice device(&m_source, &m_filter, channels);
+    QVERIFY(device.open(QIODevice::ReadOnly));
+
+    const QByteArray data = readUntilEnd(device, 4096);
+    const auto *samples = reinterpret_cast<const int16_t *>(data.constData());
+    const int frames = data.size() / (channels * 2);
+
+    int peak = 0;
+    int clipped = 0;
+    for (int i = 0; i < frames; ++i) {
+        QCOMPARE(samples[i * channels + 1], samples[i * channels]);
+
+        const int x = std::abs(int(samples[i * channels]));
+        peak = std::max(peak, x);
+        if (x >= 32767) {
+            clipped++;
+        }
+    }
+
+    // Normalized in a single pass, so a bit below full scale at worst, but
+    // only the loudest sample may reach it.
+    QVERIFY(peak >= 32767 / 2);
+    QVERIFY(clipped <= 1);
+}
+
+void RenderDeviceTest::restartsWhenReopened() {
+    RenderDevice device(&m_source, &m_filter, channels);
+
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    const QByteArray first = readUntilEnd(device, 4096);
+    device.close();
+
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    const QByteArray second = readUntilEnd(device, 4096);
+
+    QCOMPARE(second, first);
+}
+
+void RenderDeviceTest::replaysCachedRender() {
+    AppState state(sampleRate);
+    state.updatePlans();
+
+    RenderDevice device(&state, channels);
+
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    const QByteArray first = readUntilEnd(device, 4096);
+    device.close();
+
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    const QByteArray second = readUntilEnd(device, 4096);
+
+    QCOMPARE(state.cacheHits(), 1);
+    QCOMPARE(second, first);
+}
+
+void RenderDeviceTest::checkTailEdit(const variable_plan &before,
+                                     const variable_plan &after) {
+    AppState state(sampleRate);
+    state.source()->getParameter("Noise seed").setValue(7);
+
+    for (const auto *plan : {&before, &after}) {
+        *state.pitchPlan() = *plan;
+        state.updatePlans();
+
+        RenderDevice device(&state, channels);
+        QVERIFY(device.open(QIODevice::ReadOnly));
+        readUntilEnd(device, 4096);
+    }
+
+    QCOMPARE(state.cacheResumes(), 1);
+
+    AppState fresh(sampleRate);
+    fresh.source()->getParameter("Noise seed").setValue(7);
+    *fresh.pitchPlan() = after;
+    fresh.updatePlans();
+
+    QVERIFY(state.render()->samples == fresh.render()->samples);
+}
+
+void RenderDeviceTest::resumesAfterExtendingPlan() {
+    variable_plan before(false, 140);
+    before.stepToValueAtTime(140, 1.0);
+
+    variable_plan after = before;
+    after.linearToValueAtTime(180, 1.5);
+
+    checkTailEdit(before, after);
+}
+
+void RenderDeviceTest::resumesAfterCuttingPlanShort() {
+    // The plans agree until 2 s, past the end of the second one.
+    variable_plan before(false, 140);
+    before.stepToValueAtTime(140, 1.0).stepToValueAtTime(140, 2.0);
+
+    variable_plan after(false, 140);
+    after.stepToValueAtTime(140, 1.0);
+
+    checkTailEdit(before, after);
+}
+
+void RenderDeviceTest::abandonsRenderEditedDuringPlayback() {
+    variable_plan before(false, 140);
+    before.stepToValueAtTime(140, 1.0);
+
+    variable_plan after(false, 180);
+    after.stepToValueAtTime(180, 1.0);
+
+    AppState state(sampleRate);
+    state.source()->getParameter("Noise seed").setValue(7);
+    *state.pitchPlan() = before;
+    state.updatePlans();
+    const std::uint64_t beforeKey = state.renderKey();
+
+    RenderDevice device(&state, channels);
+    QVERIFY(device.open(QIODevice::ReadOnly));
+    QVERIFY(!device.read(4096).isEmpty());
+
+    // The rest of the utterance is rendered from the new plan.
+    *state.pitchPlan() = after;
+    state.updatePlans();
+    readUntilEnd(device, 4096);
+    device.close();
+
+    // Neither the samples nor the checkpoints of the mixed render are kept.
+    QVERIFY(!state.findRender(beforeKey));
+    QVERIFY(!state.findRender(state.renderKey()));
+
+    AppState fresh(sampleRate);
+    fresh.source()->getParameter("Noise seed").setValue(7);
+    *fresh.pitchPlan() = after;
+    fresh.updatePlans();
+
+    QVERIFY(state.render()->samples == fresh.render()->samples);
+    QCOMPARE(state.cacheResumes(), 0);
+}
+
+QTEST_GUILESS_MAIN(RenderDeviceTest)
+
+#include "render_device_test.moc"
@@ -83,6 +83,17 @@ AppWindow::AppWindow() : QMainWindow() {
     m_voiceFxLayout->addWidget(new voicefx::Undertale);
     m_voiceFxLayout->addWidget(new voicefx::AnimalCrossing);
 
+    // Playback renders from the live plans and parameters, stop it on any
+    // change to them.
+    for (int i = 0; i < m_voiceFxLayout->count(); ++i) {
+        connect(static_cast<voicefx::VoiceFxType *>(
+                    m_voiceFxLayout->widget(i)),
+                &voicefx::VoiceFxType::plansChanged, m_audioPlayer,
+                &AudioPlayer::stop);
+    }
+    connect(m_sourceParameters, &SourceParameters::parametersChanged,
+            m_audioPlayer, &AudioPlayer::stop);
+
     m_dialogueText = new QPlainTextEdit(centralWidget);
     m_dialogueText->setPlaceholderText("Enter example dialogue text here.");
     // Fix to three rows.
@@ -139,20 +150,7 @@ AppWindow::AppWindow() : QMainWindow() {
 
 AppWindow::~AppWindow() { delete m_sourceParameters; }
 
-std::vector<double> AppWindow::render() const {
-    std::vector<std::pair<int, int>> pitchPeriods;
-    double Oq;
-
-    std::vector<double> glottalSource =
-        appState->source()->generate(pitchPeriods, &Oq);
-
-    std::vector<double> output = appState->formantFilter()->generateFrom(
-        glottalSource, pitchPeriods, Oq);
-
-    return output;
-}
-
-void AppWindow::renderAndPlay() { m_audioPlayer->play(render()); }
+void AppWindow::renderAndPlay() { m_audioPlayer->play(); }
 
 void AppWindow::renderAndSave() {
     const auto &[filterIndices, filters] = m_audioWriter.supportedFileFormats();
@@ -169,7 +167,26 @@ void AppWindow::renderAndSave() {
 
     int formatIndex = filterIndices.at(filters.indexOf(selectedFilter));
 
-    m_audioWriter.write(filePath, formatIndex, render());
+    if (!m_audioWriter.open(filePath, formatIndex, m_sampleRate)) {
+        return;
+    }
+
+    // Playback renders with the same generator and filter.
+    m_audioPlayer->stop();
+
+    // Same output as playback. Blocks are encoded while the next ones are
+    // rendered.
+    RenderDevice device(appState.get(), 1);
+    device.open(QIODevice::ReadOnly);
+
+    std::vector<double> block(8192);
+    int count;
+    do {
+        count = device.readSamples(block.data(), block.size());
+        m_audioWriter.append(block.data(), count);
+    } while (count == block.size());
+
+    m_audioWriter.close();
 }
 
 void AppWindow::chooseVoiceFxType(int id, bool checked) {
@@ -181,6 +198,9 @@ void AppWindow::chooseVoiceFxType(int id, bool checked) {
 }
 
 void AppWindow::handleDialogueTextChanged() {
+    // Playback renders from the live plans, don't change them underneath it.
+    m_audioPlayer->stop();
+
     QString text = m_dialogueText->toPlainText();
 
     auto widget =
@@ -53,8 +53,6 @@ class AppWindow : public QMainWindow {
     void closeEvent(QCloseEvent *event) override;
 
    private:
-    std::vector<double> render() const;
-
     int m_sampleRate;
 
     bool m_isPlaying;
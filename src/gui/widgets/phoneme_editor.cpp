@@ -18,38 +18,22 @@
 
 #include "phoneme_editor.h"
 
-#include <arima/Fitting/BurgYule.h>
-#include <arima/Fitting/ConditionalSumOfSquares.h>
-
 #include <QBoxLayout>
-#include <QDebug>
 #include <QGroupBox>
 #include <QLabel>
 
 using namespace xercesc;
 using namespace babblesynth::gui;
 
-static std::vector<double> blackmanNuttall(const int N) {
-    constexpr double a0 = 0.3635819;
-    constexpr double a1 = 0.4891775;
-    constexpr double a2 = 0.1365995;
-    constexpr double a3 = 0.0106411;
-
-    std::vector<double> window(N);
-
-    for (int n = 0; n < N; ++n) {
-        window[n] = a0 - a1 * cos(2 * M_PI * n / (N - 1)) +
-                    a2 * cos(4 * M_PI * n / (N - 1)) -
-                    a3 * cos(6 * M_PI * n / (N - 1));
-    }
-
-    return window;
-}
+// Recordings are analyzed at a lower sample rate, which is enough for the
+// formants of interest.
+constexpr double analysisSampleRate = 10000;
 
 PhonemeEditor::PhonemeEditor(phonemes::PhonemeDictionary **pDictionary,
                              QWidget *parent)
     : QWidget(parent),
       m_ptrDictionary(pDictionary),
+      m_analyzer(analysisSampleRate),
       m_recording(false),
       m_selectedRow(0),
       m_changed(false) {
@@ -60,6 +44,13 @@ PhonemeEditor::PhonemeEditor(phonemes::PhonemeDictionary **pDictionary,
     m_audioRecorder = new AudioRecorder(this);
     m_sampleRate = m_audioRecorder->preferredSampleRate();
 
+    m_resampler = std::make_unique<babblesynth::resampler>(m_sampleRate,
+                                                           analysisSampleRate);
+
+    connect(m_audioRecorder, &AudioRecorder::started, this,
+            &PhonemeEditor::onRecordingStarted);
+    connect(m_audioRecorder, &AudioRecorder::chunk, this,
+            &PhonemeEditor::onRecordingChunk);
     connect(m_audioRecorder, &AudioRecorder::stopped, this,
             &PhonemeEditor::onRecordingStopped);
 
@@ -172,81 +163,46 @@ PhonemeEditor::PhonemeEditor(phonemes::PhonemeDictionary **pDictionary,
     emit mappingsChanged();
 }
 
-void PhonemeEditor::onRecordingStopped(
-    const std::vector<double> &originalAudio) {
-    // Sample down.
-    const double downSampleRate = 10000;
-    auto audio = resample(originalAudio, m_sampleRate, downSampleRate);
-
-    // Process audio.
-
-    const int length = audio.size();
-
-    constexpr double frameDuration = 20.0 / 1000.0;
-    const int frameSamples = (int)std::round(frameDuration * downSampleRate);
-
-    constexpr double gapDuration = 50.0 / 1000.0;
-    const int gapSamples = (int)std::round(gapDuration * downSampleRate);
-
-    // Window function for the chunks.
-    const auto window = blackmanNuttall(frameSamples);
+void PhonemeEditor::onRecordingStarted() {
+    m_resampler->reset();
+    m_analyzer.begin();
+    m_frames.clear();
+}
 
-    // Do optimal pre-emphasis first.
-    std::vector<double> alpha;
-    do {
-        // Do 1st order LP.
-        alpha = arma::fitArOnly(audio, 1);
-        if (fabs(alpha[0]) < 0.001) break;
-        // Do preemphasis.
-        for (int i = length - 1; i > 0; --i) {
-            audio[i] += alpha[0] * audio[i - 1];
-        }
-    } while (fabs(alpha[0]) >= 0.001);
+void PhonemeEditor::onRecordingChunk(const std::vector<double> &audio) {
+    // Sample down, then analyze the frames this chunk completes.
+    m_analysisChunk.clear();
+    m_resampler->process(audio.data(), audio.size(), m_analysisChunk);
+    m_analyzer.feed(m_analysisChunk.data(), m_analysisChunk.size(), m_frames);
+}
 
-    std::vector<double> frame(frameSamples);
-    int start = 0;
-    int phonemeNumber = 0;
+void PhonemeEditor::onRecordingStopped() {
+    // The last chunk was already received, only the samples held back by
+    // the resampler are left.
+    const double none = 0;
+    m_analysisChunk.clear();
+    m_resampler->process(&none, 0, m_analysisChunk, true);
+    m_analyzer.feed(m_analysisChunk.data(), m_analysisChunk.size(), m_frames);
 
     std::vector<phonemes::PhonemeMapping> mappingList;
+    mappingList.reserve(m_frames.size());
 
     double maxFrameIntensity = 0;
 
-    while (start + frameSamples < length) {
-        std::copy(audio.begin() + start, audio.begin() + start + frameSamples,
-                  frame.begin());
-
-        // Find min, max, and mean for amplitude/intensity calculation.
-
-        double min = std::numeric_limits<double>::max();
-        double max = std::numeric_limits<double>::lowest();
-        double mean = 0;
-
-        for (int i = 0; i < frameSamples; ++i) {
-            if (frame[i] < min) min = frame[i];
-            if (frame[i] > max) max = frame[i];
-            mean += frame[i];
+    for (const auto &frame : m_frames) {
+        phonemes::Phoneme phoneme;
+        for (const auto &pole : frame.poles) {
+            phoneme.addPole(pole.frequency, pole.bandwidth);
         }
-        mean /= frameSamples;
-
-        const double frameIntensity =
-            std::max(std::abs(min - mean), std::abs(max - mean));
-
-        if (frameIntensity > maxFrameIntensity) {
-            maxFrameIntensity = frameIntensity;
+        for (const auto &zero : frame.zeros) {
+            phoneme.addZero(zero.frequency, zero.bandwidth);
         }
 
-        // Apply window.
+        mappingList.push_back({phoneme, 0, frame.intensity});
 
-        for (int i = 0; i < frameSamples; ++i) {
-            frame[i] *= window[i];
+        if (frame.intensity > maxFrameIntensity) {
+            maxFrameIntensity = frame.intensity;
         }
-
-        const auto phoneme = generatePhoneme(frame, downSampleRate);
-
-        mappingList.push_back({phoneme, 0, frameIntensity});
-
-        start += gapSamples;
-        phonemeNumber++;
     }
 
     /* TODO: process the last chunk, may not be needed */
@@ -442,113 +398,3 @@ void PhonemeEditor::closeEvent(QCloseEvent *event) {
         }
     }
 }
-
-phonemes::Phoneme PhonemeEditor::generatePhoneme(
-    const std::vector<double> &audio, const double sampleRate) {
-    const int arTerms = 10;
-    const int maTerms = 4;
-
-    /*suanshu::ConditionalSumOfSquares solver(audio, arTerms, 0, maTerms);
-    const auto model = solver.getFittedARMA();*/
-    const auto model = suanshu::FitBurgYule(audio, arTerms, maTerms);
-    const auto modelAR = model.AR();
-    const auto modelMA = model.MA();
-
-    std::vector<double> arPoly(arTerms + 1);
-    std::vector<double> maPoly(maTerms + 1);
-    arPoly[0] = 1;
-    maPoly[0] = 1;
-    for (int i = 0; i < arTerms; ++i) {
-        arPoly[i + 1] = model.AR(i + 1);
-    }
-    for (int i = 0; i < maTerms; ++i) {
-        maPoly[i + 1] = model.MA(i + 1);
-    }
-
-    auto arRoots = filter::solveRoots(arPoly);
-    auto maRoots = filter::solveRoots(maPoly);
-
-    phonemes::Phoneme phoneme;
-
-    // Analyze and add AR polynomial roots (poles)
-
-    std::sort(arRoots.begin(), arRoots.end(), [](const auto &x, const auto &y) {
-        return std::abs(std::arg(x)) < std::abs(std::arg(y));
-    });
-
-    std::sort(maRoots.begin(), maRoots.end(), [](const auto &x, const auto &y) {
-        return std::abs(std::arg(x)) < std::abs(std::arg(y));
-    });
-
-    int n = 1;
-
-    for (const auto &z : arRoots) {
-        if (z.imag() < 0) {
-            continue;
-        }
-
-        const double r = std::abs(z);
-        if (/*r <= 0.6 ||*/ r >= 1.0) {
-            continue;
-        }
-
-        const double phi = std::arg(z);
-
-        const double frequency = std::abs(phi) * sampleRate / (2 * M_PI);
-        if (frequency <= 50 || frequency >= sampleRate / 2 - 50) {
-            continue;
-        }
-
-        /*const double bandwidth =
-            std::clamp(-std::log(r) * sampleRate / M_PI, 40.0, 200.0);*/
-        const double bandwidth = -std::log(r) * sampleRate / M_PI;
-
-        if (n <= 5) phoneme.addPole(frequency, bandwidth);
-
-        qDebug() << "pole" << n << ": (" << frequency << "Hz," << bandwidth
-                 << "Hz )";
-
-        ++n;
-    }
-
-    // Analyze and add MA polynomial roots (zeros)
-
-    std::sort(maRoots.begin(), maRoots.end(), [](const auto &x, const auto &y) {
-        return std::abs(std::arg(x)) < std::abs(std::arg(y));
-    });
-
-    int m = 1;
-
-    for (const auto &z : maRoots) {
-        if (z.imag() < 0) {
-            continue;
-        }
-
-        const double r = std::abs(z);
-        if (/*r <= 0.6 ||*/ r >= 1.0) {
-            continue;
-        }
-
-        const double phi = std::arg(z);
-
-        const double frequency = std::abs(phi) * sampleRate / (2 * M_PI);
-        if (frequency <= 50 || frequency >= sampleRate / 2 - 50) {
-            continue;
-        }
-
-        /*const double bandwidth =
-            std::clamp(-std::log(r) * sampleRate / M_PI, 40.0, 200.0);*/
-        const double bandwidth = -std::log(r) * sampleRate / M_PI;
-
-        if (m <= 2) phoneme.addZero(frequency, bandwidth);
-
-        qDebug() << "zero " << m << ": (" << frequency << "Hz, " << bandwidth
-                 << "Hz)";
-
-        ++m;
-    }
-
-    qDebug() << "---";
-
-    return phoneme;
-}
\ No newline at end of file
@@ -19,6 +19,8 @@
 #ifndef BABBLESYNTH_PHONEME_EDITOR_H
 #define BABBLESYNTH_PHONEME_EDITOR_H
 
+#include <babblesynth.h>
+
 #include <QCloseEvent>
 #include <QInputDialog>
 #include <QLabel>
@@ -27,6 +29,7 @@
 #include <QMessageBox>
 #include <QPushButton>
 #include <QWidget>
+#include <memory>
 
 #include "../audio_recorder.h"
 #include "../phonemes/phoneme_dictionary.h"
@@ -45,7 +48,9 @@ class PhonemeEditor : public QWidget {
     void mappingsChanged();
 
    private slots:
-    void onRecordingStopped(const std::vector<double> &audio);
+    void onRecordingStarted();
+    void onRecordingChunk(const std::vector<double> &audio);
+    void onRecordingStopped();
     void onMappingRenamed(const QString &text);
     void onMappingSelected(const QString &name);
     void onMappingAdd();
@@ -57,14 +62,18 @@ class PhonemeEditor : public QWidget {
     void closeEvent(QCloseEvent *event) override;
 
    private:
-    phonemes::Phoneme generatePhoneme(const std::vector<double> &audio,
-                                      double sampleRate);
-
     phonemes::PhonemeDictionary **m_ptrDictionary;
 
+    babblesynth::arma::frame_analyzer m_analyzer;
+
     AudioRecorder *m_audioRecorder;
     int m_sampleRate;
 
+    // The recording is analyzed while it is being made.
+    std::unique_ptr<babblesynth::resampler> m_resampler;
+    std::vector<double> m_analysisChunk;
+    std::vector<babblesynth::arma::frame_analysis> m_frames;
+
     QListWidget *m_mappingList;
     QPushButton *m_saveButton;
     QLineEdit *m_mappingEdit;
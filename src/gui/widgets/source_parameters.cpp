@@ -55,9 +55,11 @@ SourceParameters::SourceParameters(QWidget *parent) : QWidget(parent) {
     flutter->setRange(0, 2);
     flutter->setValue(flutterParam->value<double>());
     connect(flutter, qOverload<double>(&QDoubleSpinBox::valueChanged), this,
-            [flutter, flutterParam](double value) {
+            [this, flutter, flutterParam](double value) {
                 auto o = flutterParam->setValue(value);
-                if (o.has_value()) {
+                if (!o.has_value()) {
+                    markEdited();
+                } else {
                     flutter->setValue(o.value());
                 }
             });
@@ -72,9 +74,11 @@ SourceParameters::SourceParameters(QWidget *parent) : QWidget(parent) {
     jitter->setRange(0, 2);
     jitter->setValue(jitterParam->value<double>());
     connect(jitter, qOverload<double>(&QDoubleSpinBox::valueChanged), this,
-            [jitter, jitterParam](double value) {
+            [this, jitter, jitterParam](double value) {
                 auto o = jitterParam->setValue(value);
-                if (o.has_value()) {
+                if (!o.has_value()) {
+                    markEdited();
+                } else {
                     jitter->setValue(o.value());
                 }
             });
@@ -89,9 +93,11 @@ SourceParameters::SourceParameters(QWidget *parent) : QWidget(parent) {
     aspiration->setRange(0, 2);
     aspiration->setValue(aspirationParam->value<double>());
     connect(aspiration, qOverload<double>(&QDoubleSpinBox::valueChanged), this,
-            [aspiration, aspirationParam](double value) {
+            [this, aspiration, aspirationParam](double value) {
                 auto o = aspirationParam->setValue(value);
-                if (o.has_value()) {
+                if (!o.has_value()) {
+                    markEdited();
+                } else {
                     aspiration->setValue(o.value());
                 }
             });
@@ -171,9 +177,15 @@ void SourceParameters::onSourceTypeChanged(const QString &name) {
     appState->source()
         ->getParameter("Source type")
         .setValue(source::sources.valueOf(name.toStdString()));
+    markEdited();
     updateFields();
 }
 
+void SourceParameters::markEdited() {
+    appState->markEdited();
+    emit parametersChanged();
+}
+
 void SourceParameters::updateFields() {
     // Clear the QFormLayout
     while (m_sourceParams->count() > 0) {
@@ -198,6 +210,11 @@ void SourceParameters::addField(parameter &param) {
     QString name = QString::fromStdString(param.name());
     const std::string type = param.type();
 
+    // Per-cycle voice quality plans have no field of their own.
+    if (type == "var_plan") {
+        return;
+    }
+
     QWidget *field;
 
     if (type == "int") {
@@ -210,6 +227,7 @@ void SourceParameters::addField(parameter &param) {
                 [this, spin, &param](int value) {
                     auto o = param.setValue(value);
                     if (!o.has_value()) {
+                        markEdited();
                         redrawGraph();
                     } else {
                         spin->setValue(o.value());
@@ -228,6 +246,7 @@ void SourceParameters::addField(parameter &param) {
                 [this, spin, &param](double value) {
                     auto o = param.setValue(value);
                     if (!o.has_value()) {
+                        markEdited();
                         redrawGraph();
                     } else {
                         spin->setValue(o.value());
@@ -241,6 +260,7 @@ void SourceParameters::addField(parameter &param) {
                 [this, check, &param](const int state) {
                     auto o = param.setValue(state == Qt::Checked);
                     if (!o.has_value()) {
+                        markEdited();
                         redrawGraph();
                     } else {
                         check->setChecked(o.value());
@@ -37,6 +37,10 @@ class SourceParameters : public QWidget {
    public:
     SourceParameters(QWidget *parent = nullptr);
 
+   signals:
+    // The source parameters of the app state were edited.
+    void parametersChanged();
+
    private slots:
     void onSourceTypeChanged(const QString &);
 
@@ -44,6 +48,7 @@ class SourceParameters : public QWidget {
     void updateFields();
     void addField(parameter &param);
     void redrawGraph();
+    void markEdited();
 
     QVector<QPointF> calculateSpectrum(int fs, int f0, int nfft);
 
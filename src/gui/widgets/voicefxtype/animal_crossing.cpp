@@ -20,8 +20,11 @@
 
 #include <QBoxLayout>
 #include <QDebug>
+#include <QDir>
 #include <QDirIterator>
+#include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QGroupBox>
 #include <QLabel>
 #include <QMessageBox>
@@ -37,6 +40,71 @@
 using namespace babblesynth::gui::voicefx;
 using namespace xercesc;
 
+using babblesynth::dictionary::compiled_dictionary;
+using babblesynth::gui::phonemes::PhonemeDictionary;
+
+// Dictionaries with this extension are in the compiled format.
+static bool isCompiled(const QString &filePath) {
+    return filePath.endsWith(".bsdict", Qt::CaseInsensitive);
+}
+
+// Where the compiled copy of an XML dictionary is cached, named after the
+// file and a hash of its full path so that files of the same name in
+// different folders don't share it.
+static QString cachePathFor(const QString &filePath) {
+    const QString dir =
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+        "/dictionaries";
+    QDir().mkpath(dir);
+
+    const QFileInfo info(filePath);
+    const QByteArray path = info.absoluteFilePath().toUtf8();
+    const uint64_t pathHash =
+        compiled_dictionary::hashSource(path.constData(), path.size());
+
+    return dir + "/" + info.completeBaseName() + "-" +
+           QString::number(pathHash, 16) + ".bsdict";
+}
+
+// XML dictionaries are compiled into the cache the first time they are
+// loaded, then loaded from there for as long as the XML doesn't change.
+static PhonemeDictionary *loadXmlDictionary(const QString &filePath) {
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly)) {
+        throw std::runtime_error("can't open the file");
+    }
+    const QByteArray xml = file.readAll();
+    const uint64_t hash = compiled_dictionary::hashSource(xml.constData(),
+                                                          xml.size());
+
+    const QString cachePath = cachePathFor(filePath);
+
+    if (QFile::exists(cachePath)) {
+        try {
+            const compiled_dictionary cached(cachePath.toStdString());
+            if (cached.sourceHash() == hash) {
+                return PhonemeDictionary::fromCompiled(cached);
+            }
+        } catch (const std::runtime_error &e) {
+            qWarning() << "Ignoring compiled dictionary:" << e.what();
+        }
+    }
+
+    PhonemeDictionary *dictionary =
+        PhonemeDictionary::loadFromXML(filePath.toStdString().c_str());
+    if (dictionary == nullptr) {
+        throw std::runtime_error("not a valid XML file");
+    }
+
+    try {
+        dictionary->saveCompiled(cachePath.toStdString(), hash);
+    } catch (const std::runtime_error &e) {
+        qWarning() << "Couldn't compile dictionary:" << e.what();
+    }
+
+    return dictionary;
+}
+
 AnimalCrossing::AnimalCrossing()
     : m_phonemeDictionary(new phonemes::PhonemeDictionary),
       m_phonemeEditor(new PhonemeEditor(&m_phonemeDictionary)) {
@@ -174,7 +242,8 @@ void AnimalCrossing::handleOpenDictionaryFile() {
     QString filePath = QFileDialog::getOpenFileName(
         this, tr("Open dictionary file"),
         QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation),
-        "Phoneme dictionary definition (*.xml)");
+        "Phoneme dictionary definition (*.xml);;"
+        "Compiled phoneme dictionary (*.bsdict)");
 
     if (filePath.isNull()) {
         return;
@@ -195,7 +264,8 @@ void AnimalCrossing::handleSaveAsDictionaryFile() {
     QString filePath = QFileDialog::getSaveFileName(
         this, tr("Save dictionary file"),
         QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation),
-        "Phoneme dictionary definition (*.xml)");
+        "Phoneme dictionary definition (*.xml);;"
+        "Compiled phoneme dictionary (*.bsdict)");
 
     if (filePath.isNull()) {
         return;
@@ -237,12 +307,17 @@ void AnimalCrossing::extractDictionaryFiles() {
 
 void AnimalCrossing::loadDictionaryFile(const QString &filePath) {
     try {
-        if (m_phonemeDictionary != nullptr) {
-            delete m_phonemeDictionary;
+        PhonemeDictionary *dictionary;
+
+        if (isCompiled(filePath)) {
+            const compiled_dictionary compiled(filePath.toStdString());
+            dictionary = PhonemeDictionary::fromCompiled(compiled);
+        } else {
+            dictionary = loadXmlDictionary(filePath);
         }
 
-        m_phonemeDictionary = phonemes::PhonemeDictionary::loadFromXML(
-            filePath.toStdString().c_str());
+        delete m_phonemeDictionary;
+        m_phonemeDictionary = dictionary;
 
         QFileInfo fileInfo(filePath);
 
@@ -255,7 +330,7 @@ void AnimalCrossing::loadDictionaryFile(const QString &filePath) {
         m_dictionarySaveButton->setEnabled(false);
 
         emit m_phonemeEditor->mappingsChanged();
-    } catch (const std::logic_error &e) {
+    } catch (const std::exception &e) {
         QMessageBox::warning(this, tr("Phoneme dictionary failed to load"),
                              tr("Phoneme dictionary at %1 failed to load:\n%2")
                                  .arg(filePath)
@@ -264,7 +339,20 @@ void AnimalCrossing::loadDictionaryFile(const QString &filePath) {
 }
 
 void AnimalCrossing::saveDictionaryFile(const QString &filePath) {
-    m_phonemeDictionary->saveToXml(filePath);
+    if (isCompiled(filePath)) {
+        try {
+            m_phonemeDictionary->saveCompiled(filePath.toStdString());
+        } catch (const std::runtime_error &e) {
+            QMessageBox::warning(this, tr("Phoneme dictionary failed to save"),
+                                 tr("Phoneme dictionary at %1 failed to "
+                                    "save:\n%2")
+                                     .arg(filePath)
+                                     .arg(e.what()));
+            return;
+        }
+    } else {
+        m_phonemeDictionary->saveToXml(filePath);
+    }
 
     QFileInfo fileInfo(filePath);
     m_dictionaryFileLabel->setText(fileInfo.fileName());
@@ -362,4 +450,5 @@ void AnimalCrossing::updatePlans() {
     appState->pitchPlan()->linearToValueAtTime(m_pitch, time);
 
     appState->updatePlans();
+    emit plansChanged();
 }
\ No newline at end of file
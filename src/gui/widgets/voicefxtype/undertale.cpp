@@ -315,4 +315,5 @@ void Undertale::updatePlans() {
     appState->antiformantBandwidthPlan(1)->reset(110);
 
     appState->updatePlans();
+    emit plansChanged();
 }
\ No newline at end of file
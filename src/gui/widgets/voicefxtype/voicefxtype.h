@@ -30,6 +30,10 @@ class VoiceFxType : public QWidget {
     Q_OBJECT
    public slots:
     virtual void updateDialogueTextChanged(const QString& text) = 0;
+
+   signals:
+    // The plans of the app state were updated.
+    void plansChanged();
 };
 
 }  // namespace voicefx
@@ -0,0 +1,216 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <babblesynth.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "render_server.h"
+
+using namespace babblesynth;
+
+namespace {
+
+void printUsage(const char *program) {
+    std::cerr
+        << "Usage: " << program << " [options] SOCKET\n"
+        << "\n"
+        << "Listens on the Unix domain socket SOCKET for render requests,\n"
+        << "one JSON job per line, and streams back 16-bit PCM.\n"
+        << "\n"
+        << "Options:\n"
+        << "  -r, --rate HZ          sample rate (default 48000)\n"
+        << "  -j, --workers N        render threads (default: all cores)\n"
+        << "  -q, --queue N          requests waiting for a worker before\n"
+        << "                         clients are throttled (default 4 per\n"
+        << "                         worker)\n"
+        << "  -d, --dictionary FILE  default compiled phoneme dictionary\n"
+        << "  -v, --verbose          log every request\n"
+        << "  -p, --profile          print the time spent in each stage on\n"
+        << "                         exit\n"
+        << "  -h, --help             show this help\n";
+}
+
+int parseInt(const char *option, const char *value) {
+    char *end;
+    const long n = std::strtol(value, &end, 10);
+    if (*end != '\0' || n < 0) {
+        throw std::invalid_argument(std::string("invalid value for ") +
+                                    option);
+    }
+    return n;
+}
+
+std::runtime_error systemError(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+int listenOn(const std::string &path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("socket path is too long: " + path);
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    // Only replace a socket left behind by an earlier run.
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path.c_str());
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw systemError("socket");
+    }
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+            0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        const auto error = systemError(path);
+        close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    server::server_options options;
+    bool profile = false;
+    std::string dictionaryPath;
+    std::string socketPath;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "-h" || arg == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            } else if ((arg == "-r" || arg == "--rate") && hasValue) {
+                options.sampleRate = parseInt(argv[i], argv[i + 1]);
+                ++i;
+            } else if ((arg == "-j" || arg == "--workers") && hasValue) {
+                options.numWorkers = parseInt(argv[i], argv[i + 1]);
+                ++i;
+            } else if ((arg == "-q" || arg == "--queue") && hasValue) {
+                options.queueSize = parseInt(argv[i], argv[i + 1]);
+                ++i;
+            } else if ((arg == "-d" || arg == "--dictionary") && hasValue) {
+                dictionaryPath = argv[++i];
+            } else if (arg == "-v" || arg == "--verbose") {
+                options.verbose = true;
+            } else if (arg == "-p" || arg == "--profile") {
+                profile = true;
+            } else if (arg[0] != '-' && socketPath.empty()) {
+                socketPath = arg;
+            } else {
+                printUsage(argv[0]);
+                return 2;
+            }
+        }
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+
+    if (socketPath.empty() || options.sampleRate <= 0) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    // Writes to clients which went away fail with EPIPE instead.
+    signal(SIGPIPE, SIG_IGN);
+
+    // SIGINT and SIGTERM are only ever delivered to the thread below, which
+    // stops the server. Every other thread inherits the mask.
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    int listenSocket = -1;
+
+    try {
+        std::unique_ptr<dictionary::compiled_dictionary> dictionary;
+        if (!dictionaryPath.empty()) {
+            dictionary = std::make_unique<dictionary::compiled_dictionary>(
+                dictionaryPath);
+            options.dictionary = dictionary.get();
+        }
+
+        profiler::setEnabled(profile);
+
+        server::render_server server(options);
+
+        listenSocket = listenOn(socketPath);
+
+        std::thread signalThread([&server, &stopSignals] {
+            int signal;
+            sigwait(&stopSignals, &signal);
+            server.stop();
+        });
+
+        std::cout << "Listening on " << socketPath << " at "
+                  << options.sampleRate << " Hz" << std::endl;
+
+        try {
+            server.serve(listenSocket);
+        } catch (...) {
+            pthread_kill(signalThread.native_handle(), SIGTERM);
+            signalThread.join();
+            throw;
+        }
+        signalThread.join();
+
+        close(listenSocket);
+        unlink(socketPath.c_str());
+
+        server.printStats(std::cout);
+
+        if (profile) {
+            std::cout << "\n";
+            profiler::print(std::cout);
+        }
+    } catch (const std::exception &e) {
+        if (listenSocket >= 0) {
+            close(listenSocket);
+            unlink(socketPath.c_str());
+        }
+        std::cerr << "babblesynth-server: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,625 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "render_server.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "../cli/manifest.h"
+
+using namespace babblesynth;
+using namespace babblesynth::server;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+#ifdef MSG_NOSIGNAL
+constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+constexpr int sendFlags = 0;  // SIGPIPE has to be ignored instead
+#endif
+
+// Longest request line accepted before the connection is dropped.
+constexpr size_t maxLineLength = 1 << 20;
+
+// Thrown from the block sink to stop rendering a cancelled request.
+struct render_cancelled {};
+
+bool sendAll(const int socket, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t sent = send(socket, bytes, size, sendFlags);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool sendLine(const int socket, std::string line) {
+    std::replace(line.begin(), line.end(), '\n', ' ');
+    line += '\n';
+    return sendAll(socket, line.data(), line.size());
+}
+
+double milliseconds(const clock_type::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Same conversion as the GUI's audio output.
+void toS16(const double* in, int16_t* out, const int count) {
+    for (int i = 0; i < count; ++i) {
+        const double c = std::clamp(in[i], -1.0, 1.0) + 1;
+        out[i] = int16_t(int(c * 32767.5) - 32768);
+    }
+}
+
+}  // namespace
+
+latency_reservoir::latency_reservoir(const int capacity)
+    : m_capacity(capacity), m_count(0), m_max(0) {
+    m_values.reserve(capacity);
+}
+
+void latency_reservoir::add(const double value) {
+    m_count++;
+    m_max = std::max(m_max, value);
+
+    // Every value added so far stays in with the same probability.
+    if (m_values.size() < m_capacity) {
+        m_values.push_back(value);
+    } else {
+        const long long index =
+            std::uniform_int_distribution<long long>(0, m_count - 1)(m_rng);
+        if (index < m_capacity) {
+            m_values[index] = value;
+        }
+    }
+}
+
+long long latency_reservoir::count() const { return m_count; }
+
+double latency_reservoir::percentile(const double p) const {
+    if (m_values.empty()) {
+        return 0;
+    }
+    std::vector<double> values = m_values;
+    const size_t k = std::min<size_t>(p * values.size(), values.size() - 1);
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+double latency_reservoir::max() const { return m_max; }
+
+struct render_server::request {
+    render_job job;
+
+    // Set if the request couldn't be parsed or rendered.
+    std::string error;
+
+    clock_type::time_point received;
+    clock_type::time_point startTime;
+    clock_type::time_point firstBlock;
+
+    // Everything below is guarded by the mutex.
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    // Rendered blocks which weren't sent yet.
+    std::deque<std::vector<int16_t>> blocks;
+    long long samples = 0;
+
+    bool started = false;
+    bool finished = false;
+    bool cancelled = false;
+};
+
+struct render_server::connection {
+    explicit connection(int socket) : socket(socket) {}
+
+    const int socket;
+
+    std::thread reader;
+    std::thread writer;
+    std::atomic<int> threadsDone = 0;
+
+    // Everything below is guarded by the mutex.
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    // Requests in the order they were received, until they are answered.
+    std::deque<std::shared_ptr<request>> responses;
+    bool inputClosed = false;
+
+    // Set once the client can't be written to anymore.
+    bool failed = false;
+};
+
+render_server::render_server(const server_options& options)
+    : m_options(options), m_stopping(false), m_failed(0), m_samples(0) {
+    if (m_options.numWorkers <= 0) {
+        m_options.numWorkers =
+            std::max<int>(1, std::thread::hardware_concurrency());
+    }
+    if (m_options.queueSize <= 0) {
+        m_options.queueSize = 4 * m_options.numWorkers;
+    }
+
+    if (pipe(m_wakePipe) != 0) {
+        throw std::runtime_error(std::string("pipe: ") + std::strerror(errno));
+    }
+
+    for (int i = 0; i < m_options.numWorkers; ++i) {
+        m_workers.emplace_back(&render_server::workerLoop, this);
+    }
+}
+
+render_server::~render_server() {
+    stop();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    reapConnections(true);
+
+    close(m_wakePipe[0]);
+    close(m_wakePipe[1]);
+}
+
+void render_server::serve(const int listenSocket) {
+    while (true) {
+        pollfd fds[2] = {{listenSocket, POLLIN, 0}, {m_wakePipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("poll: ") +
+                                     std::strerror(errno));
+        }
+
+        if (fds[1].revents != 0) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            const int socket = accept(listenSocket, nullptr, nullptr);
+            if (socket < 0) {
+                // The client may have given up already.
+                continue;
+            }
+
+            reapConnections(false);
+
+            auto& conn = *m_connections.emplace_back(
+                std::make_unique<connection>(socket));
+
+            conn.reader = std::thread([this, &conn] {
+                readLoop(conn);
+                ++conn.threadsDone;
+            });
+            conn.writer = std::thread([this, &conn] {
+                writeLoop(conn);
+                ++conn.threadsDone;
+            });
+        }
+    }
+
+    // stop() was called: wake up every thread and wait for them.
+    for (auto& conn : m_connections) {
+        shutdown(conn->socket, SHUT_RDWR);
+        cancelResponses(*conn);
+    }
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+
+    reapConnections(true);
+}
+
+void render_server::stop() {
+    {
+        std::lock_guard lock(m_queueMutex);
+        if (m_stopping) {
+            return;
+        }
+        m_stopping = true;
+    }
+    m_queueChanged.notify_all();
+
+    const char byte = 0;
+    while (write(m_wakePipe[1], &byte, 1) < 0 && errno == EINTR) {
+    }
+}
+
+void render_server::printStats(std::ostream& out) const {
+    std::lock_guard lock(m_statsMutex);
+
+    const auto& first = m_firstBlockLatencies;
+    const auto& total = m_totalLatencies;
+
+    out << std::fixed << std::setprecision(2) << "Served " << total.count()
+        << " requests (" << m_failed << " failed), "
+        << m_samples / double(m_options.sampleRate) << " s of audio\n"
+        << "  first block: p50 " << first.percentile(0.5) << " ms, p95 "
+        << first.percentile(0.95) << " ms, max " << first.max() << " ms\n"
+        << "  total:       p50 " << total.percentile(0.5) << " ms, p95 "
+        << total.percentile(0.95) << " ms, max " << total.max() << " ms\n";
+}
+
+void render_server::workerLoop() {
+    // Reused for every request this worker renders.
+    render_voice voice(m_options.sampleRate);
+
+    while (auto req = dequeue()) {
+        {
+            std::lock_guard lock(req->mutex);
+            if (req->cancelled) {
+                continue;
+            }
+            req->started = true;
+            req->startTime = clock_type::now();
+        }
+
+        std::string error;
+
+        try {
+            voice.stream(
+                req->job, m_options.blockSize,
+                [&](const double* samples, const int count) {
+                    std::vector<int16_t> block(count);
+                    toS16(samples, block.data(), count);
+
+                    std::unique_lock lock(req->mutex);
+                    req->changed.wait(lock, [&] {
+                        return req->cancelled ||
+                               req->blocks.size() <
+                                   m_options.maxBufferedBlocks;
+                    });
+                    if (req->cancelled) {
+                        throw render_cancelled();
+                    }
+                    if (req->samples == 0) {
+                        req->firstBlock = clock_type::now();
+                    }
+                    req->blocks.push_back(std::move(block));
+                    req->samples += count;
+                    req->changed.notify_all();
+                });
+        } catch (const render_cancelled&) {
+            error = "cancelled";
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard lock(req->mutex);
+            req->error = error;
+            req->finished = true;
+        }
+        req->changed.notify_all();
+    }
+}
+
+void render_server::readLoop(connection& conn) {
+    cli::manifest_options options;
+    options.sampleRate = m_options.sampleRate;
+    options.dictionary = m_options.dictionary;
+    options.loadDictionary = [this](const std::string& path) {
+        return loadDictionary(path);
+    };
+    options.withOutput = false;
+
+    cli::job_parser parser(options);
+
+    // The last request given to the workers. The next one waits until it is
+    // rendered.
+    std::shared_ptr<request> rendering;
+
+    std::string buffer;
+    char chunk[4096];
+
+    bool reading = true;
+    while (reading) {
+        const ssize_t count = recv(conn.socket, chunk, sizeof(chunk), 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        buffer.append(chunk, count);
+
+        size_t start = 0;
+        size_t end;
+        while (reading && (end = buffer.find('\n', start)) != buffer.npos) {
+            const std::string line = buffer.substr(start, end - start);
+            start = end + 1;
+
+            if (line.find_first_not_of(" \t\r") == line.npos) {
+                continue;
+            }
+
+            auto req = std::make_shared<request>();
+            req->received = clock_type::now();
+
+            try {
+                req->job = parser.parse(line).job;
+            } catch (const std::exception& e) {
+                req->error = e.what();
+                req->finished = true;
+            }
+
+            {
+                std::lock_guard lock(conn.mutex);
+                if (conn.failed) {
+                    reading = false;
+                    break;
+                }
+                conn.responses.push_back(req);
+            }
+            conn.changed.notify_all();
+
+            if (req->finished) {
+                continue;
+            }
+
+            // The requests before this one are rendered already, so a client
+            // which doesn't read can only keep this request's worker waiting.
+            if (rendering) {
+                std::unique_lock lock(rendering->mutex);
+                rendering->changed.wait(lock,
+                                        [&] { return rendering->finished; });
+            }
+
+            // Blocks while the queue is full, which leaves the rest of the
+            // requests in the socket buffers and eventually blocks the
+            // client.
+            if (!enqueue(req)) {
+                {
+                    std::lock_guard lock(req->mutex);
+                    req->error = "the server is shutting down";
+                    req->finished = true;
+                }
+                req->changed.notify_all();
+                reading = false;
+            }
+            rendering = req;
+        }
+        buffer.erase(0, start);
+
+        if (buffer.size() > maxLineLength) {
+            break;
+        }
+    }
+
+    {
+        std::lock_guard lock(conn.mutex);
+        conn.inputClosed = true;
+    }
+    conn.changed.notify_all();
+}
+
+void render_server::writeLoop(connection& conn) {
+    while (true) {
+        std::shared_ptr<request> req;
+        {
+            std::unique_lock lock(conn.mutex);
+            conn.changed.wait(lock, [&] {
+                return !conn.responses.empty() || conn.inputClosed;
+            });
+            if (conn.responses.empty()) {
+                break;
+            }
+            req = conn.responses.front();
+        }
+
+        if (!writeResponse(conn, *req)) {
+            // Includes this request, whose worker may be waiting for room.
+            cancelResponses(conn);
+            shutdown(conn.socket, SHUT_RDWR);
+            return;
+        }
+
+        {
+            std::lock_guard lock(conn.mutex);
+            conn.responses.pop_front();
+        }
+    }
+
+    // Lets the client read until the end of the stream.
+    shutdown(conn.socket, SHUT_WR);
+}
+
+bool render_server::writeResponse(connection& conn, request& req) {
+    bool sentHeader = false;
+
+    while (true) {
+        std::vector<int16_t> block;
+        std::string error;
+        bool finished;
+        {
+            std::unique_lock lock(req.mutex);
+            req.changed.wait(
+                lock, [&] { return !req.blocks.empty() || req.finished; });
+
+            finished = req.blocks.empty();
+            if (finished) {
+                error = req.error;
+            } else {
+                block = std::move(req.blocks.front());
+                req.blocks.pop_front();
+            }
+        }
+        // Lets the worker render the next block.
+        req.changed.notify_all();
+
+        if (!error.empty()) {
+            {
+                std::lock_guard lock(m_statsMutex);
+                ++m_failed;
+            }
+            if (m_options.verbose) {
+                std::clog << "request failed: " << error << std::endl;
+            }
+            return sendLine(conn.socket, "ERR " + error);
+        }
+
+        if (!sentHeader) {
+            if (!sendLine(conn.socket,
+                          "OK " + std::to_string(m_options.sampleRate))) {
+                return false;
+            }
+            sentHeader = true;
+        }
+
+        if (finished) {
+            break;
+        }
+
+        const size_t bytes = block.size() * sizeof(int16_t);
+        if (!sendLine(conn.socket, "DATA " + std::to_string(bytes)) ||
+            !sendAll(conn.socket, block.data(), bytes)) {
+            return false;
+        }
+    }
+
+    // The request is finished, so nothing else writes to it anymore.
+    const auto end = clock_type::now();
+    const double queueTime = milliseconds(req.startTime - req.received);
+    const double firstTime = milliseconds(
+        (req.samples > 0 ? req.firstBlock : end) - req.received);
+    const double totalTime = milliseconds(end - req.received);
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3) << "END " << req.samples << " "
+         << queueTime << " " << firstTime << " " << totalTime;
+
+    {
+        std::lock_guard lock(m_statsMutex);
+        m_firstBlockLatencies.add(firstTime);
+        m_totalLatencies.add(totalTime);
+        m_samples += req.samples;
+
+        if (m_options.verbose) {
+            std::clog << "request: " << req.samples << " samples, queued "
+                      << queueTime << " ms, first block " << firstTime
+                      << " ms, total " << totalTime << " ms" << std::endl;
+        }
+    }
+
+    return sendLine(conn.socket, line.str());
+}
+
+bool render_server::enqueue(std::shared_ptr<request> req) {
+    {
+        std::unique_lock lock(m_queueMutex);
+        m_queueChanged.wait(lock, [&] {
+            return m_stopping || m_queue.size() < m_options.queueSize;
+        });
+        if (m_stopping) {
+            return false;
+        }
+        m_queue.push_back(std::move(req));
+    }
+    m_queueChanged.notify_all();
+    return true;
+}
+
+std::shared_ptr<render_server::request> render_server::dequeue() {
+    std::shared_ptr<request> req;
+    {
+        std::unique_lock lock(m_queueMutex);
+        m_queueChanged.wait(lock,
+                            [&] { return m_stopping || !m_queue.empty(); });
+        if (m_stopping) {
+            return nullptr;
+        }
+        req = std::move(m_queue.front());
+        m_queue.pop_front();
+    }
+    m_queueChanged.notify_all();
+    return req;
+}
+
+void render_server::cancelResponses(connection& conn) {
+    std::lock_guard lock(conn.mutex);
+    conn.failed = true;
+
+    for (const auto& req : conn.responses) {
+        {
+            std::lock_guard reqLock(req->mutex);
+            req->cancelled = true;
+            // The requests being rendered are finished by their worker.
+            if (!req->started && !req->finished) {
+                req->error = "cancelled";
+                req->finished = true;
+            }
+        }
+        req->changed.notify_all();
+    }
+}
+
+void render_server::reapConnections(const bool all) {
+    for (auto it = m_connections.begin(); it != m_connections.end();) {
+        auto& conn = **it;
+        if (all || conn.threadsDone == 2) {
+            conn.reader.join();
+            conn.writer.join();
+            close(conn.socket);
+            it = m_connections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+const dictionary::compiled_dictionary* render_server::loadDictionary(
+    const std::string& path) {
+    std::lock_guard lock(m_dictionariesMutex);
+
+    auto& dictionary = m_dictionaries[path];
+    if (!dictionary) {
+        try {
+            dictionary =
+                std::make_unique<dictionary::compiled_dictionary>(path);
+        } catch (...) {
+            m_dictionaries.erase(path);
+            throw;
+        }
+    }
+    return dictionary.get();
+}
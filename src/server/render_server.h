@@ -0,0 +1,167 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BABBLESYNTH_SERVER_RENDER_SERVER_H
+#define BABBLESYNTH_SERVER_RENDER_SERVER_H
+
+#include <babblesynth.h>
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace babblesynth {
+namespace server {
+
+struct server_options {
+    int sampleRate = 48'000;
+
+    // 0 uses one worker per hardware thread.
+    int numWorkers = 0;
+
+    // Requests waiting for a worker, 0 for four per worker. Connections stop
+    // being read from while the queue is full.
+    int queueSize = 0;
+
+    // Samples per DATA message.
+    int blockSize = 4096;
+
+    // Blocks of a request which are rendered ahead of the client. The worker
+    // waits for the client to read them before rendering more.
+    int maxBufferedBlocks = 16;
+
+    // For the requests with text and no "dictionary" field.
+    const dictionary::compiled_dictionary* dictionary = nullptr;
+
+    // Logs every request to std::clog.
+    bool verbose = false;
+};
+
+// Uniform random sample of at most `capacity` of the values added to it, so
+// that percentiles over the whole life of a server take bounded memory. The
+// maximum is kept exactly.
+class latency_reservoir {
+   public:
+    explicit latency_reservoir(int capacity = 4096);
+
+    void add(double value);
+
+    long long count() const;
+    double percentile(double p) const;
+    double max() const;
+
+   private:
+    int m_capacity;
+    std::vector<double> m_values;
+    long long m_count;
+    double m_max;
+    std::minstd_rand m_rng;
+};
+
+// Renders requests from the clients of a stream socket on a fixed set of
+// workers, each of which keeps its own render_voice for its whole life.
+//
+// A client sends jobs as JSON lines, in the format of the CLI manifests but
+// without the "output" field, and with an optional "dictionary" field that
+// names a compiled dictionary, which stays loaded once it was first used.
+// Requests can be pipelined, the responses come back in the same order. Only
+// one request of a connection is rendered at a time, so that a client which
+// doesn't read its responses holds one worker at most:
+//
+//   OK <sample rate>\n
+//   DATA <bytes>\n <bytes of signed 16-bit mono PCM, in native byte order>
+//   ...
+//   END <samples> <queue ms> <first block ms> <total ms>\n
+//
+// where the times are measured from when the request was read: until a
+// worker took it, until its first block was ready, and until its last block
+// was sent. A request which fails gets "ERR <message>\n" instead of "OK", or
+// instead of "END" if it fails while streaming.
+class render_server {
+   public:
+    explicit render_server(const server_options& options);
+    ~render_server();
+
+    render_server(const render_server&) = delete;
+    render_server& operator=(const render_server&) = delete;
+
+    // Accepts connections on the listening socket until stop() is called,
+    // then cancels the pending requests and waits for every thread.
+    void serve(int listenSocket);
+
+    // Safe to call from any thread, but not from a signal handler.
+    void stop();
+
+    // Request counts and latency percentiles so far.
+    void printStats(std::ostream& out) const;
+
+   private:
+    struct request;
+    struct connection;
+
+    void workerLoop();
+    void readLoop(connection& conn);
+    void writeLoop(connection& conn);
+    bool writeResponse(connection& conn, request& req);
+
+    bool enqueue(std::shared_ptr<request> req);
+    std::shared_ptr<request> dequeue();
+
+    void cancelResponses(connection& conn);
+    void reapConnections(bool all);
+
+    const dictionary::compiled_dictionary* loadDictionary(
+        const std::string& path);
+
+    server_options m_options;
+
+    std::vector<std::thread> m_workers;
+
+    mutable std::mutex m_queueMutex;
+    std::condition_variable m_queueChanged;
+    std::deque<std::shared_ptr<request>> m_queue;
+    bool m_stopping;
+
+    // Written to by stop() to wake up serve().
+    int m_wakePipe[2];
+
+    std::list<std::unique_ptr<connection>> m_connections;
+
+    std::mutex m_dictionariesMutex;
+    std::map<std::string, std::unique_ptr<dictionary::compiled_dictionary>>
+        m_dictionaries;
+
+    mutable std::mutex m_statsMutex;
+    latency_reservoir m_firstBlockLatencies;  // ms
+    latency_reservoir m_totalLatencies;       // ms
+    int m_failed;
+    long long m_samples;
+};
+
+}  // namespace server
+}  // namespace babblesynth
+
+#endif  // BABBLESYNTH_SERVER_RENDER_SERVER_H
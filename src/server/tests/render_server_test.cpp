@@ -0,0 +1,302 @@
+﻿/*
+ * BabbleSynth
+ * Copyright (C) 2022  Clo Yun-Hee Dufour
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <babblesynth.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <QTemporaryDir>
+#include <QtTest>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "render_server.h"
+
+using namespace babblesynth;
+using namespace babblesynth::server;
+
+// A server listening on a socket of a temporary directory, which serves
+// from its own thread until it is destroyed.
+class running_server {
+   public:
+    explicit running_server(const server_options &options)
+        : m_server(options),
+          m_path(m_dir.filePath("server.sock").toStdString()) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        std::strcpy(address.sun_path, m_path.c_str());
+
+        m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (bind(m_socket, reinterpret_cast<sockaddr *>(&address),
+                 sizeof(address)) != 0 ||
+            listen(m_socket, SOMAXCONN) != 0) {
+            throw std::runtime_error("can't listen on " + m_path);
+        }
+
+        m_thread = std::thread([this] { m_server.serve(m_socket); });
+    }
+
+    ~running_server() { stop(); }
+
+    void stop() {
+        if (m_thread.joinable()) {
+            m_server.stop();
+            m_thread.join();
+            close(m_socket);
+        }
+    }
+
+    const std::string &path() const { return m_path; }
+
+   private:
+    QTemporaryDir m_dir;
+    render_server m_server;
+    std::string m_path;
+    int m_socket;
+    std::thread m_thread;
+};
+
+// One response of the server, see render_server.
+struct response {
+    bool complete = false;  // false if the stream ended or timed out first
+    std::string error;
+    int sampleRate = 0;
+    long long samples = 0;     // in the DATA messages
+    long long endSamples = 0;  // as counted by END
+};
+
+class client {
+   public:
+    explicit client(const std::string &path) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        std::strcpy(address.sun_path, path.c_str());
+
+        m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (::connect(m_socket, reinterpret_cast<sockaddr *>(&address),
+                      sizeof(address)) != 0) {
+            throw std::runtime_error("can't connect to " + path);
+        }
+    }
+
+    ~client() { close(m_socket); }
+
+    void send(const std::string &lines) {
+        ::send(m_socket, lines.data(), lines.size(), MSG_NOSIGNAL);
+    }
+
+    // No more requests.
+    void finish() { shutdown(m_socket, SHUT_WR); }
+
+    response read() {
+        response r;
+        std::string line;
+
+        if (!readLine(line)) {
+            return r;
+        }
+        if (line.rfind("ERR ", 0) == 0) {
+            r.error = line.substr(4);
+            r.complete = true;
+            return r;
+        }
+        if (line.rfind("OK ", 0) != 0) {
+            return r;
+        }
+        r.sampleRate = std::stoi(line.substr(3));
+
+        while (readLine(line)) {
+            if (line.rfind("DATA ", 0) == 0) {
+                const size_t bytes = std::stoul(line.substr(5));
+                if (!skip(bytes)) {
+                    break;
+                }
+                r.samples += bytes / sizeof(int16_t);
+            } else if (line.rfind("END ", 0) == 0) {
+                r.endSamples = std::stoll(line.substr(4));
+                r.complete = true;
+                break;
+            } else {
+                r.error = line.substr(line.find(' ') + 1);
+                r.complete = line.rfind("ERR ", 0) == 0;
+                break;
+            }
+        }
+        return r;
+    }
+
+    // Whether the server closed the stream once all responses were read.
+    bool atEnd() { return !fill(); }
+
+   private:
+    // Waits up to 10 s for more data, false at the end of the stream.
+    bool fill() {
+        pollfd fd = {m_socket, POLLIN, 0};
+        if (poll(&fd, 1, 10'000) <= 0) {
+            return false;
+        }
+        char chunk[65536];
+        const ssize_t count = recv(m_socket, chunk, sizeof(chunk), 0);
+        if (count <= 0) {
+            return false;
+        }
+        m_buffer.append(chunk, count);
+        return true;
+    }
+
+    bool readLine(std::string &line) {
+        size_t end;
+        while ((end = m_buffer.find('\n')) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        line = m_buffer.substr(0, end);
+        m_buffer.erase(0, end + 1);
+        return true;
+    }
+
+    bool skip(const size_t bytes) {
+        while (m_buffer.size() < bytes) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        m_buffer.erase(0, bytes);
+        return true;
+    }
+
+    int m_socket;
+    std::string m_buffer;
+};
+
+class RenderServerTest : public QObject {
+    Q_OBJECT
+
+   private slots:
+    void answersPipelinedRequestsInOrder();
+    void servesOthersWhileAClientDoesNotRead();
+    void closesConnectionsWhenStopped();
+
+   private:
+    // A constant pitch of 220 Hz for `duration` seconds, with a fixed noise
+    // seed so that its length doesn't vary.
+    static std::string request(double duration);
+
+    // Samples of the rendered request.
+    static long long renderedSamples(double duration);
+
+    static constexpr int sampleRate = 48000;
+};
+
+std::string RenderServerTest::request(const double duration) {
+    return "{\"pitch\": [[0, 220], [" + std::to_string(duration) +
+           ", 220]], \"generator.Noise seed\": 1}\n";
+}
+
+long long RenderServerTest::renderedSamples(const double duration) {
+    render_job job;
+    job.pitchPlan = variable_plan(false, 220);
+    job.pitchPlan.linearToValueAtTime(220, duration);
+    job.generatorParameters["Noise seed"] = 1;
+
+    long long samples = 0;
+    render_voice(sampleRate).stream(
+        job, 4096, [&](const double *, const int count) { samples += count; });
+    return samples;
+}
+
+void RenderServerTest::answersPipelinedRequestsInOrder() {
+    server_options options;
+    options.sampleRate = sampleRate;
+    options.numWorkers = 2;
+    running_server server(options);
+
+    client c(server.path());
+    c.send(request(0.5) + "{\"bogus\": 1}\n\n" + request(0.25));
+    c.finish();
+
+    const response first = c.read();
+    QVERIFY(first.complete);
+    QVERIFY(first.error.empty());
+    QCOMPARE(first.sampleRate, sampleRate);
+    QCOMPARE(first.samples, renderedSamples(0.5));
+    QCOMPARE(first.endSamples, first.samples);
+
+    const response invalid = c.read();
+    QVERIFY(invalid.complete);
+    QCOMPARE(invalid.error, std::string("unknown field \"bogus\""));
+
+    const response second = c.read();
+    QVERIFY(second.complete);
+    QCOMPARE(second.samples, renderedSamples(0.25));
+    QCOMPARE(second.endSamples, second.samples);
+
+    QVERIFY(c.atEnd());
+}
+
+void RenderServerTest::servesOthersWhileAClientDoesNotRead() {
+    server_options options;
+    options.sampleRate = sampleRate;
+    options.numWorkers = 2;
+    options.maxBufferedBlocks = 2;
+    running_server server(options);
+
+    // More than the socket buffers hold, so their workers would wait.
+    client stalled(server.path());
+    for (int i = 0; i < 4; ++i) {
+        stalled.send(request(5));
+    }
+
+    // Lets the server read them all.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    client other(server.path());
+    other.send(request(0.25));
+    other.finish();
+
+    const response r = other.read();
+    QVERIFY(r.complete);
+    QCOMPARE(r.samples, renderedSamples(0.25));
+}
+
+void RenderServerTest::closesConnectionsWhenStopped() {
+    server_options options;
+    options.sampleRate = sampleRate;
+    options.numWorkers = 1;
+    options.maxBufferedBlocks = 2;
+    running_server server(options);
+
+    client c(server.path());
+    c.send(request(5) + request(5));
+
+    server.stop();
+
+    // The stream ends without the rest of the response.
+    const response r = c.read();
+    QVERIFY(!r.complete);
+    QVERIFY(c.atEnd());
+}
+
+QTEST_GUILESS_MAIN(RenderServerTest)
+
+#include "render_server_test.moc"